@@ -22,6 +22,9 @@
 #ifndef PICOQUIC_SP_TEST_H
 #define PICOQUIC_SP_TEST_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -33,7 +36,94 @@ void debug_printf_suspend();
 int dtn_basic_test();
 int dtn_data_test();
 int dtn_silence_test();
+int dtn_silence_hour_test();
+int dtn_silence_day_test();
+int dtn_silence_capped_test();
 int dtn_twenty_test();
+int dtn_cc_test();
+int dtn_resume_test();
+int dtn_warm_test();
+int dtn_object_test();
+int dtn_object_resume_test();
+int dtn_priority_test();
+int dtn_multipath_test();
+int dtn_multipath_failover_test();
+int dtn_relay_test();
+int dtn_event_test();
+int dtn_replay_test();
+int dtn_queue_test();
+int dtn_mtu_test();
+int dtn_cipher_test();
+int dtn_scenario_test();
+int dtn_metrics_test();
+int dtn_contact_test();
+int dtn_asym_10_test();
+int dtn_asym_100_test();
+int dtn_asym_1000_test();
+int dtn_asym_1000_noaf_test();
+int dtn_asym_1000_thin_test();
+int dtn_loss_bernoulli_test();
+int dtn_loss_burst_test();
+int dtn_loss_ber_test();
+int dtn_loss_blackout_test();
+int dtn_fec_bernoulli_test();
+int dtn_fec_burst_test();
+
+/* Execution of independent jobs on a pool of threads, 0 threads for all cores */
+typedef int (*dtn_job_fn)(void* job_ctx, size_t job_index);
+int dtn_get_nb_cores();
+int dtn_run_parallel(size_t nb_jobs, int nb_threads, dtn_job_fn job_fn, void* job_ctx);
+
+/* Parameter sweep of the DTN simulation, results in CSV file */
+int dtn_sweep(char const* sweep_spec, char const* csv_file_name, int nb_threads);
+
+/* Benchmark of the DTN tests, results in CSV file, or JSON if the name ends in ".json" */
+int dtn_benchmark(char const* file_name, int nb_threads);
+
+/* Benchmark of large object downloads from memory mapped files, 100 MB to 10 GB, results in CSV file */
+int dtn_object_benchmark(char const* file_name);
+
+/* Benchmark of downloads over one or several relay paths, with and without failure, results in CSV file */
+int dtn_multipath_benchmark(char const* file_name);
+
+/* Benchmark of store and forward through a relay against direct delivery, results in CSV file */
+int dtn_relay_benchmark(char const* file_name);
+/* Benchmark of wall time against latency, with and without the event driven rounds, results in CSV file */
+int dtn_latency_benchmark(char const* file_name);
+/* Benchmark of queue occupancy, bursts and pacing through a bottleneck buffer, for each congestion control, results in CSV file */
+int dtn_queue_benchmark(char const* file_name);
+/* Benchmark of goodput and packets per MB with path MTU discovery and with known link MTUs, results in CSV file */
+int dtn_mtu_benchmark(char const* file_name);
+/* Benchmark of the CPU cost per packet of the crypto for each cipher suite and packet size,
+ * and of the send and receive path, results in CSV file, in cycles if the CPU MHz is known */
+#define DTN_CPU_DEFAULT_ITERATIONS 20000
+int dtn_cpu_benchmark(char const* file_name, int nb_iterations, double cpu_mhz);
+/* Performance budgets of the DTN tests: load the baseline checked by the
+ * tests, or write a new one from the results of the current tree. A
+ * required baseline fails to load if it holds no budget. */
+#define DTN_BASELINE_DEFAULT_FILE "test/dtn_baseline.txt"
+int dtn_baseline_load(char const* file_name, int is_required);
+int dtn_baseline_write(char const* file_name, int nb_threads);
+/* Live metrics of the DTN simulations, one JSON line per snapshot in file,
+ * every interval of simulated time, in microseconds */
+#define DTN_METRICS_DEFAULT_INTERVAL 10000000
+int dtn_metrics_open(char const* file_name, uint64_t interval);
+void dtn_metrics_close(void);
+/* Run of the test cases described in a scenario file, results in CSV file */
+int dtn_scenario_run(char const* scenario_file, char const* csv_file, int nb_threads);
+/* Replay of a binary log: timeline in CSV file, summary and stalls on stdout */
+int dtn_replay(char const* binlog_file, char const* csv_file);
+
+/* Profile of the simulation loop for the DTN tests, summary table on stdout */
+int dtn_profile(int nb_threads);
+
+/* Stress or fuzz of randomized DTN configurations for the specified number of minutes */
+int dtn_stress(int minutes, int is_fuzz, int nb_threads);
+/* Run again one of the randomized configurations, from its run number */
+int dtn_stress_rerun(uint64_t run_number, int is_fuzz);
+
+/* Scaling of one server with up to nb_connections long latency clients */
+int dtn_scaling(int minutes, int nb_connections);
 
 #ifdef __cplusplus
 }
@@ -57,11 +57,51 @@ static const picoquic_test_def_t test_table[] = {
     { "dtn_basic", dtn_basic_test },
     { "dtn_data", dtn_data_test },
     { "dtn_silence", dtn_silence_test },
-    { "dtn_twenty", dtn_twenty_test }
+    { "dtn_silence_hour", dtn_silence_hour_test },
+    { "dtn_silence_day", dtn_silence_day_test },
+    { "dtn_silence_capped", dtn_silence_capped_test },
+    { "dtn_twenty", dtn_twenty_test },
+    { "dtn_cc", dtn_cc_test },
+    { "dtn_resume", dtn_resume_test },
+    { "dtn_warm", dtn_warm_test },
+    { "dtn_object", dtn_object_test },
+    { "dtn_object_resume", dtn_object_resume_test },
+    { "dtn_priority", dtn_priority_test },
+    { "dtn_multipath", dtn_multipath_test },
+    { "dtn_multipath_failover", dtn_multipath_failover_test },
+    { "dtn_relay", dtn_relay_test },
+    { "dtn_event", dtn_event_test },
+    { "dtn_replay", dtn_replay_test },
+    { "dtn_queue", dtn_queue_test },
+    { "dtn_mtu", dtn_mtu_test },
+    { "dtn_cipher", dtn_cipher_test },
+    { "dtn_scenario", dtn_scenario_test },
+    { "dtn_metrics", dtn_metrics_test },
+    { "dtn_contact", dtn_contact_test },
+    { "dtn_asym_10", dtn_asym_10_test },
+    { "dtn_asym_100", dtn_asym_100_test },
+    { "dtn_asym_1000", dtn_asym_1000_test },
+    { "dtn_asym_1000_noaf", dtn_asym_1000_noaf_test },
+    { "dtn_asym_1000_thin", dtn_asym_1000_thin_test },
+    { "dtn_loss_bernoulli", dtn_loss_bernoulli_test },
+    { "dtn_loss_burst", dtn_loss_burst_test },
+    { "dtn_loss_ber", dtn_loss_ber_test },
+    { "dtn_loss_blackout", dtn_loss_blackout_test },
+    { "dtn_fec_bernoulli", dtn_fec_bernoulli_test },
+    { "dtn_fec_burst", dtn_fec_burst_test }
 };
 
 static size_t const nb_tests = sizeof(test_table) / sizeof(picoquic_test_def_t);
 
+static void report_one_test(size_t i, int ret, FILE* F)
+{
+    if (ret == 0) {
+        fprintf(F, "    Success.\n");
+    } else {
+        fprintf(F, "    Fails, error: %d.\n", ret);
+    }
+}
+
 static int do_one_test(size_t i, FILE* F)
 {
     int ret = 0;
@@ -75,11 +115,7 @@ static int do_one_test(size_t i, FILE* F)
         fflush(F);
 
         ret = test_table[i].test_fn();
-        if (ret == 0) {
-            fprintf(F, "    Success.\n");
-        } else {
-            fprintf(F, "    Fails, error: %d.\n", ret);
-        }
+        report_one_test(i, ret, F);
     }
 
     fflush(F);
@@ -87,6 +123,45 @@ static int do_one_test(size_t i, FILE* F)
     return ret;
 }
 
+/* Parallel execution of the test table.
+ * The worker threads run the selected tests and store the results,
+ * which are then reported in table order by the main thread.
+ */
+typedef struct st_test_pool_ctx_t {
+    size_t first_test;
+    size_t last_test;
+    test_status_t const* test_status;
+    int* test_ret;
+    uint64_t* test_wall_time;
+} test_pool_ctx_t;
+
+static int test_pool_job(void* v_ctx, size_t i)
+{
+    test_pool_ctx_t* ctx = (test_pool_ctx_t*)v_ctx;
+
+    if (ctx->test_status[i] == test_not_run && i >= ctx->first_test && i <= ctx->last_test) {
+        uint64_t start_time = picoquic_current_time();
+        ctx->test_ret[i] = test_table[i].test_fn();
+        ctx->test_wall_time[i] = picoquic_current_time() - start_time;
+    }
+
+    return 0;
+}
+
+static int run_tests_in_parallel(test_status_t const* test_status, size_t first_test, size_t last_test,
+    int nb_threads, int* test_ret, uint64_t* test_wall_time)
+{
+    test_pool_ctx_t ctx;
+
+    ctx.first_test = first_test;
+    ctx.last_test = last_test;
+    ctx.test_status = test_status;
+    ctx.test_ret = test_ret;
+    ctx.test_wall_time = test_wall_time;
+
+    return dtn_run_parallel(nb_tests, nb_threads, test_pool_job, &ctx);
+}
+
 int usage(char const * argv0)
 {
     fprintf(stderr, "PicoQUIC test execution\n");
@@ -105,14 +180,35 @@ int usage(char const * argv0)
     fprintf(stderr, "Options: \n");
     fprintf(stderr, "  -x test           Do not run the specified test.\n");
     fprintf(stderr, "  -o n1 n2          Only run test numbers in range [n1,n2]");
-    fprintf(stderr, "  -s nnn            Run stress for nnn minutes.\n");
-    fprintf(stderr, "  -f nnn            Run fuzz for nnn minutes.\n");
-    fprintf(stderr, "  -c nnn ccc        Run connection stress for nnn minutes, ccc connections.\n");
+    fprintf(stderr, "  -s nnn            Run stress of random DTN configurations for nnn minutes.\n");
+    fprintf(stderr, "  -f nnn            Run fuzz of adversarial DTN configurations for nnn minutes.\n");
+    fprintf(stderr, "  -u run            With -s 0 or -f 0, run again the stress or fuzz run number run.\n");
+    fprintf(stderr, "  -c nnn ccc        Run DTN scaling for nnn minutes, up to ccc connections to one server.\n");
     fprintf(stderr, "  -d ppp uuu dir    Run connection ddoss for ppp packets, uuu usec intervals,\n");
     fprintf(stderr, "  -F nnn            Run the corrupt file fuzzer nnn times,\n");
     fprintf(stderr, "                    logs in dir. No logs if dir=\"-\"");
     fprintf(stderr, "  -n                Disable debug prints.\n");
     fprintf(stderr, "  -r                Retry failed tests with debug print enabled.\n");
+    fprintf(stderr, "  -j nnn            Run tests in parallel on nnn threads, 0 for all cores.\n");
+    fprintf(stderr, "  -b file           Run the DTN benchmark, results in CSV file, JSON if file is *.json.\n");
+    fprintf(stderr, "  -l file           Run the DTN large object benchmark, 100 MB to 10 GB, results in CSV file.\n");
+    fprintf(stderr, "  -m file           Run the DTN multipath benchmark over relay paths, results in CSV file.\n");
+    fprintf(stderr, "  -R file           Run the DTN relay benchmark, store and forward against direct, results in CSV file.\n");
+    fprintf(stderr, "  -t file           Run the DTN latency benchmark, event driven against test rounds, results in CSV file.\n");
+    fprintf(stderr, "  -q file           Run the DTN queue benchmark, bursts and pacing through a modem buffer, results in CSV file.\n");
+    fprintf(stderr, "  -M file           Run the DTN MTU benchmark, discovery against known link MTUs, results in CSV file.\n");
+    fprintf(stderr, "  -e file file.csv  Run the DTN test cases described in the scenario file, results in CSV file.\n");
+    fprintf(stderr, "  -g file           Check the performance budgets of the DTN tests in file,\n");
+    fprintf(stderr, "                    default " DTN_BASELINE_DEFAULT_FILE " if present.\n");
+    fprintf(stderr, "  -G file           Write the performance budgets of the DTN tests in file.\n");
+    fprintf(stderr, "  -y log file.csv   Replay the binary log of a DTN test, timeline in CSV file.\n");
+    fprintf(stderr, "  -L file           Stream live metrics of the DTN simulations to file, one JSON line per snapshot.\n");
+    fprintf(stderr, "  -I sec            Interval of the live metrics snapshots, in simulated seconds, default %d.\n",
+        DTN_METRICS_DEFAULT_INTERVAL / 1000000);
+    fprintf(stderr, "  -p                Profile the simulation loop of the DTN tests.\n");
+    fprintf(stderr, "  -w spec file.csv  Run the DTN parameter sweep described by spec,\n");
+    fprintf(stderr, "                    e.g. \"latency=1:2400:x2;down=0.01:1000:x10;cc=all\",\n");
+    fprintf(stderr, "                    dimensions latency (s), up, down (Mbps), credit, cc, size, loss.\n");
     fprintf(stderr, "  -h                Print this help message\n");
     fprintf(stderr, "  -S solution_dir   Set the path to the source files to find the default files\n");
 
@@ -138,6 +234,7 @@ int main(int argc, char** argv)
     int nb_test_tried = 0;
     int nb_test_failed = 0;
     int stress_minutes = 0;
+    int stress_run = -1;
     int auto_bypass = 0;
     int cf_rounds = 0;
     test_status_t * test_status = (test_status_t *) calloc(nb_tests, sizeof(test_status_t));
@@ -153,6 +250,35 @@ int main(int argc, char** argv)
     int cnx_stress_nb_cnx = 0;
     size_t first_test = 0;
     size_t last_test = 10000;
+    int nb_threads = 0;
+    int do_sweep = 0;
+    int do_bench = 0;
+    int do_object_bench = 0;
+    int do_multipath_bench = 0;
+    int do_relay_bench = 0;
+    int do_latency_bench = 0;
+    int do_replay = 0;
+    int do_queue_bench = 0;
+    int do_mtu_bench = 0;
+    int do_scenario = 0;
+    double metrics_interval = 0;
+    int do_baseline_write = 0;
+    int do_profile = 0;
+    char const* bench_file = NULL;
+    char const* object_bench_file = NULL;
+    char const* multipath_bench_file = NULL;
+    char const* relay_bench_file = NULL;
+    char const* latency_bench_file = NULL;
+    char const* replay_log = NULL;
+    char const* queue_bench_file = NULL;
+    char const* mtu_bench_file = NULL;
+    char const* scenario_file = NULL;
+    char const* scenario_csv = NULL;
+    char const* metrics_file = NULL;
+    char const* baseline_file = NULL;
+    char const* replay_csv = NULL;
+    char const* sweep_spec = NULL;
+    char const* sweep_csv = NULL;
 
     debug_printf_push_stream(stderr);
 
@@ -167,7 +293,7 @@ int main(int argc, char** argv)
     {
         memset(test_status, 0, nb_tests * sizeof(test_status_t));
 
-        while (ret == 0 && (opt = getopt(argc, argv, "c:f:F:s:S:x:o:nrh")) != -1) {
+        while (ret == 0 && (opt = getopt(argc, argv, "b:c:e:f:F:g:G:I:j:l:L:m:M:q:R:s:S:t:u:w:x:y:o:nprh")) != -1) {
             switch (opt) {
             case 'x': {
                 optind--;
@@ -212,7 +338,7 @@ int main(int argc, char** argv)
             case 'f':
                 do_fuzz = 1;
                 stress_minutes = atoi(optarg);
-                if (stress_minutes <= 0) {
+                if (stress_minutes < 0) {
                     fprintf(stderr, "Incorrect stress minutes: %s\n", optarg);
                     ret = usage(argv[0]);
                 }
@@ -228,15 +354,23 @@ int main(int argc, char** argv)
             case 's':
                 do_stress = 1;
                 stress_minutes = atoi(optarg);
-                if (stress_minutes <= 0) {
+                if (stress_minutes < 0) {
                     fprintf(stderr, "Incorrect stress minutes: %s\n", optarg);
                     ret = usage(argv[0]);
                 }
                 break;
+            case 'u':
+                stress_run = atoi(optarg);
+                if (stress_run < 0) {
+                    fprintf(stderr, "Incorrect stress run: %s\n", optarg);
+                    ret = usage(argv[0]);
+                }
+                break;
             case 'c':
                 if (optind + 1 > argc) {
                     fprintf(stderr, "option requires more arguments -- c\n");
                     ret = usage(argv[0]);
+                    break;
                 }
                 do_cnx_stress = 1;
                 cnx_stress_minutes = atoi(optarg);
@@ -245,17 +379,108 @@ int main(int argc, char** argv)
                     fprintf(stderr, "Incorrect cnx stress minutes: %s\n", optarg);
                     ret = usage(argv[0]);
                 }
-                else if (cnx_stress_nb_cnx < 0) {
+                else if (cnx_stress_nb_cnx <= 0) {
                     fprintf(stderr, "Incorrect cnx stress number of connections: %s\n", argv[optind - 1]);
                     ret = usage(argv[0]);
                 }
                 break;
+            case 'j':
+                nb_threads = atoi(optarg);
+                if (nb_threads < 0) {
+                    fprintf(stderr, "Incorrect number of threads: %s\n", optarg);
+                    ret = usage(argv[0]);
+                }
+                else if (nb_threads == 0) {
+                    nb_threads = dtn_get_nb_cores();
+                }
+                break;
+            case 'b':
+                do_bench = 1;
+                bench_file = optarg;
+                break;
+            case 'l':
+                do_object_bench = 1;
+                object_bench_file = optarg;
+                break;
+            case 'm':
+                do_multipath_bench = 1;
+                multipath_bench_file = optarg;
+                break;
+            case 'R':
+                do_relay_bench = 1;
+                relay_bench_file = optarg;
+                break;
+            case 'M':
+                do_mtu_bench = 1;
+                mtu_bench_file = optarg;
+                break;
+            case 'L':
+                metrics_file = optarg;
+                break;
+            case 'I':
+                metrics_interval = atof(optarg);
+                if (metrics_interval <= 0) {
+                    fprintf(stderr, "Incorrect metrics interval: %s\n", optarg);
+                    ret = usage(argv[0]);
+                }
+                break;
+            case 'e':
+                if (optind + 1 > argc) {
+                    fprintf(stderr, "option requires more arguments -- e\n");
+                    ret = usage(argv[0]);
+                }
+                else {
+                    do_scenario = 1;
+                    scenario_file = optarg;
+                    scenario_csv = argv[optind++];
+                }
+                break;
+            case 'q':
+                do_queue_bench = 1;
+                queue_bench_file = optarg;
+                break;
+            case 't':
+                do_latency_bench = 1;
+                latency_bench_file = optarg;
+                break;
+            case 'w':
+                if (optind + 1 > argc) {
+                    fprintf(stderr, "option requires more arguments -- w\n");
+                    ret = usage(argv[0]);
+                }
+                else {
+                    do_sweep = 1;
+                    sweep_spec = optarg;
+                    sweep_csv = argv[optind++];
+                }
+                break;
+            case 'g':
+                baseline_file = optarg;
+                break;
+            case 'G':
+                do_baseline_write = 1;
+                baseline_file = optarg;
+                break;
+            case 'y':
+                if (optind + 1 > argc) {
+                    fprintf(stderr, "option requires more arguments -- y\n");
+                    ret = usage(argv[0]);
+                }
+                else {
+                    do_replay = 1;
+                    replay_log = optarg;
+                    replay_csv = argv[optind++];
+                }
+                break;
             case 'S':
                 picoquic_set_solution_dir(optarg);
                 break;
             case 'n':
                 disable_debug = 1;
                 break;
+            case 'p':
+                do_profile = 1;
+                break;
             case 'r':
                 retry_failed_test = 1;
                 break;
@@ -268,8 +493,15 @@ int main(int argc, char** argv)
                 break;
             }
         }
+        if (ret == 0 && (do_stress || do_fuzz) && (stress_minutes == 0) != (stress_run >= 0)) {
+            fprintf(stderr, "Select one stress run with -u and 0 minutes, or a positive number of minutes\n");
+            ret = usage(argv[0]);
+        }
         /* If one of the stressers was specified, do not run any other test by default */
-        if (do_stress || do_fuzz || do_cnx_stress || do_cnx_ddos || do_cf_fuzz) {
+        int do_tools = do_stress || do_fuzz || do_cnx_stress || do_cnx_ddos || do_cf_fuzz || do_sweep || do_bench ||
+            do_object_bench || do_multipath_bench || do_relay_bench || do_latency_bench || do_queue_bench || do_mtu_bench || do_scenario || do_replay || do_baseline_write || do_profile;
+
+        if (do_tools) {
             auto_bypass = 1;
             for (size_t i = 0; i < nb_tests; i++) {
                 test_status[i] = test_excluded;
@@ -296,6 +528,29 @@ int main(int argc, char** argv)
             }
         }
 
+        if (ret == 0 && metrics_file != NULL) {
+            ret = dtn_metrics_open(metrics_file, (uint64_t)(metrics_interval * 1000000.0));
+        }
+
+        /* The performance budgets apply to the tests, not to the tools */
+        if (ret == 0 && !do_tools) {
+            FILE* F_default = NULL;
+
+            if (baseline_file != NULL) {
+                if (dtn_baseline_load(baseline_file, 1) != 0) {
+                    fprintf(stderr, "Cannot load the performance budgets from %s\n", baseline_file);
+                    ret = -1;
+                }
+            }
+            else if ((F_default = picoquic_file_open(DTN_BASELINE_DEFAULT_FILE, "r")) != NULL) {
+                (void)picoquic_file_close(F_default);
+                if (dtn_baseline_load(DTN_BASELINE_DEFAULT_FILE, 0) != 0) {
+                    fprintf(stderr, "Cannot load the performance budgets from %s\n", DTN_BASELINE_DEFAULT_FILE);
+                    ret = -1;
+                }
+            }
+        }
+
         if (disable_debug) {
             debug_printf_suspend();
         }
@@ -304,7 +559,51 @@ int main(int argc, char** argv)
         }
 
         /* Execute now all the tests that were not excluded */
-        if (ret == 0) {
+        if (ret == 0 && nb_threads > 1) {
+            int* test_ret = (int*)calloc(nb_tests, sizeof(int));
+            uint64_t* test_wall_time = (uint64_t*)calloc(nb_tests, sizeof(uint64_t));
+
+            if (test_ret == NULL || test_wall_time == NULL) {
+                fprintf(stderr, "Could not allocate memory.\n");
+                ret = -1;
+            }
+            else {
+                ret = run_tests_in_parallel(test_status, first_test, last_test, nb_threads, test_ret, test_wall_time);
+            }
+
+            for (size_t i = 0; ret == 0 && i < nb_tests; i++) {
+                if (test_status[i] == test_not_run) {
+                    nb_test_tried++;
+                    if (i >= first_test && i <= last_test) {
+                        fprintf(stdout, "Test number %" PRIst ", %s, ran in %" PRIu64 " ms\n",
+                            i, test_table[i].test_name, test_wall_time[i] / 1000);
+                        report_one_test(i, test_ret[i], stdout);
+                    }
+                    if (i >= first_test && i <= last_test && test_ret[i] != 0) {
+                        test_status[i] = test_failed;
+                        nb_test_failed++;
+                    }
+                    else {
+                        test_status[i] = test_success;
+                    }
+                }
+                else if (!auto_bypass && test_status[i] == test_excluded) {
+                    fprintf(stdout, "Test number %d (%s) is bypassed.\n", (int)i, test_table[i].test_name);
+                }
+            }
+            if (nb_test_failed > 0) {
+                ret = -1;
+            }
+            fflush(stdout);
+
+            if (test_ret != NULL) {
+                free(test_ret);
+            }
+            if (test_wall_time != NULL) {
+                free(test_wall_time);
+            }
+        }
+        else if (ret == 0) {
             for (size_t i = 0; i < nb_tests; i++) {
                 if (test_status[i] == test_not_run) {
                     nb_test_tried++;
@@ -323,6 +622,67 @@ int main(int argc, char** argv)
             }
         }
 
+        if (ret == 0 && (do_stress || do_fuzz)) {
+            if (stress_run >= 0) {
+                ret = dtn_stress_rerun((uint64_t)stress_run, do_fuzz);
+            }
+            else {
+                ret = dtn_stress(stress_minutes, do_fuzz, nb_threads);
+            }
+        }
+
+        if (ret == 0 && do_cnx_stress) {
+            ret = dtn_scaling(cnx_stress_minutes, cnx_stress_nb_cnx);
+        }
+
+        if (ret == 0 && do_sweep) {
+            ret = dtn_sweep(sweep_spec, sweep_csv, nb_threads);
+        }
+
+        if (ret == 0 && do_bench) {
+            ret = dtn_benchmark(bench_file, nb_threads);
+        }
+
+        if (ret == 0 && do_object_bench) {
+            ret = dtn_object_benchmark(object_bench_file);
+        }
+
+        if (ret == 0 && do_multipath_bench) {
+            ret = dtn_multipath_benchmark(multipath_bench_file);
+        }
+
+        if (ret == 0 && do_relay_bench) {
+            ret = dtn_relay_benchmark(relay_bench_file);
+        }
+
+        if (ret == 0 && do_latency_bench) {
+            ret = dtn_latency_benchmark(latency_bench_file);
+        }
+
+        if (ret == 0 && do_queue_bench) {
+            ret = dtn_queue_benchmark(queue_bench_file);
+        }
+
+        if (ret == 0 && do_mtu_bench) {
+            ret = dtn_mtu_benchmark(mtu_bench_file);
+        }
+
+        if (ret == 0 && do_scenario) {
+            ret = dtn_scenario_run(scenario_file, scenario_csv, nb_threads);
+        }
+
+        if (ret == 0 && do_baseline_write) {
+            ret = dtn_baseline_write(baseline_file, nb_threads);
+        }
+
+        if (ret == 0 && do_replay) {
+            ret = dtn_replay(replay_log, replay_csv);
+        }
+
+        if (ret == 0 && do_profile) {
+            ret = dtn_profile(nb_threads);
+        }
+
         /* Report status, and if specified retry 
         */
 
@@ -383,6 +743,7 @@ int main(int argc, char** argv)
             }
         }
 
+        dtn_metrics_close();
         free(test_status);
         // picoquic_tls_api_unload();
     }
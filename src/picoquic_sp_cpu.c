@@ -0,0 +1,120 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* CPU cost benchmark, separate from the test program so that it can be
+ * built and run alone on the flight computer or on its emulator.
+ */
+
+#ifdef _WINDOWS
+#include "getopt.h"
+#endif
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include <picoquic_sp_test.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef _WINDOWS
+#ifdef _WINDOWS64
+#define DEFAULT_PICOQUIC_DIR "..\\..\\..\\..\\picoquic"
+#else
+#define DEFAULT_PICOQUIC_DIR "..\\..\\..\\picoquic"
+#endif
+#else
+#define DEFAULT_PICOQUIC_DIR "../picoquic"
+#endif
+
+#define DEFAULT_CPU_BENCH_FILE "dtn_cpu.csv"
+
+int usage(char const * argv0)
+{
+    fprintf(stderr, "PicoQUIC in space CPU cost benchmark\n");
+    fprintf(stderr, "\nUsage: %s [-o file] [-f mhz] [-i nnn]\n\n", argv0);
+    fprintf(stderr, "Options: \n");
+    fprintf(stderr, "  -o file           Results in CSV file, default " DEFAULT_CPU_BENCH_FILE ".\n");
+    fprintf(stderr, "  -f mhz            CPU frequency in MHz, to report cycles per packet.\n");
+    fprintf(stderr, "  -i nnn            Number of packets for each crypto measurement, default %d.\n",
+        DTN_CPU_DEFAULT_ITERATIONS);
+    fprintf(stderr, "  -n                Disable debug prints.\n");
+    fprintf(stderr, "  -h                Print this help message\n");
+    fprintf(stderr, "  -S solution_dir   Set the path to the source files to find the default files\n");
+
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    int opt;
+    int disable_debug = 0;
+    int nb_iterations = DTN_CPU_DEFAULT_ITERATIONS;
+    double cpu_mhz = 0;
+    char const* bench_file = DEFAULT_CPU_BENCH_FILE;
+
+    debug_printf_push_stream(stderr);
+
+    picoquic_set_solution_dir(DEFAULT_PICOQUIC_DIR);
+
+    while (ret == 0 && (opt = getopt(argc, argv, "o:f:i:S:nh")) != -1) {
+        switch (opt) {
+        case 'o':
+            bench_file = optarg;
+            break;
+        case 'f':
+            cpu_mhz = atof(optarg);
+            if (cpu_mhz <= 0) {
+                fprintf(stderr, "Incorrect CPU frequency: %s\n", optarg);
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'i':
+            nb_iterations = atoi(optarg);
+            if (nb_iterations <= 0) {
+                fprintf(stderr, "Incorrect number of packets: %s\n", optarg);
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'S':
+            picoquic_set_solution_dir(optarg);
+            break;
+        case 'n':
+            disable_debug = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+            break;
+        default:
+            ret = usage(argv[0]);
+            break;
+        }
+    }
+
+    if (ret == 0) {
+        if (disable_debug) {
+            debug_printf_suspend();
+        }
+        ret = dtn_cpu_benchmark(bench_file, nb_iterations, cpu_mhz);
+    }
+
+    return (ret);
+}
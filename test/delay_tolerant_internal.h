@@ -0,0 +1,900 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DELAY_TOLERANT_INTERNAL_H
+#define DELAY_TOLERANT_INTERNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+
+/* Definitions shared between the delay tolerant tests, the sweeps and
+ * the other tools that run the DTN simulations.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Logging of the simulated connections.
+ * - off: no logs.
+ * - summary: binary log and qlog of the first packets of each connection.
+ * - full: binary log and qlog of all packets.
+ * When logs are on, the binary logs are written in batches by a background thread.
+ */
+typedef enum {
+    dtn_log_off = 0,
+    dtn_log_summary,
+    dtn_log_full
+} dtn_log_level_t;
+
+/* Contact plan: time ordered list of the windows in which the link is up,
+ * with the rate and latency of each window. The times are counted from
+ * the start of the simulation. Outside of the windows, the link is down
+ * and the packets sent are lost. See dtn_contact.c.
+ */
+#define DTN_MAX_CONTACTS 16
+
+typedef struct st_dtn_contact_t {
+    uint64_t start_time;
+    uint64_t end_time;
+    double mbps_up;
+    double mbps_down;
+    uint64_t latency;
+} dtn_contact_t;
+
+/* Loss models, see dtn_loss.c. The blackouts apply in addition to the
+ * selected model. Runs with the same seed lose the same packets.
+ */
+typedef enum {
+    dtn_loss_none = 0,
+    dtn_loss_bernoulli,
+    dtn_loss_gilbert_elliott,
+    dtn_loss_ber
+} dtn_loss_type_t;
+
+typedef struct st_dtn_blackout_t {
+    uint64_t start_time;
+    uint64_t end_time;
+} dtn_blackout_t;
+
+typedef struct st_dtn_loss_model_t {
+    dtn_loss_type_t type;
+    double loss_rate; /* Bernoulli: probability of losing a packet */
+    double p_good_to_bad; /* Gilbert-Elliott: transitions per packet */
+    double p_bad_to_good;
+    double loss_good; /* Gilbert-Elliott: loss probability in each state */
+    double loss_bad;
+    double ber; /* Bit error rate, a packet is lost if any bit is in error */
+    dtn_blackout_t const* blackouts;
+    size_t nb_blackouts;
+    uint64_t seed;
+} dtn_loss_model_t;
+
+/* Erasure coding of the links, see dtn_loss.c. Each block of block_size
+ * packets is followed by ceil(redundancy * block_size) repair packets.
+ */
+#define DTN_FEC_MAX_BLOCK 256
+#define DTN_FEC_DEFAULT_BLOCK 32
+
+typedef struct st_dtn_fec_t {
+    double redundancy;
+    size_t block_size;
+} dtn_fec_t;
+
+/* Path state saved at the end of a connection and used to seed the next
+ * one, see dtn_path_cache.c. Entry 0 is the client, entry 1 the server.
+ */
+typedef struct st_dtn_path_state_t {
+    int is_valid;
+    uint64_t rtt_min;
+    uint64_t smoothed_rtt;
+    uint64_t cwin;
+    uint64_t pacing_rate;
+} dtn_path_state_t;
+
+typedef struct st_dtn_path_cache_t {
+    dtn_path_state_t state[2];
+} dtn_path_cache_t;
+
+void dtn_path_state_save(picoquic_cnx_t* cnx, dtn_path_state_t* state);
+int dtn_path_state_seed(picoquic_cnx_t* cnx, dtn_path_state_t const* state, struct sockaddr_in const* peer_addr);
+int dtn_path_cache_write(dtn_path_cache_t const* cache, char const* file_name);
+int dtn_path_cache_read(dtn_path_cache_t* cache, char const* file_name);
+
+/* Scheduling of the streams sent by the server, see dtn_priority.c */
+typedef enum {
+    dtn_priority_none = 0,
+    dtn_priority_fifo,
+    dtn_priority_round_robin,
+    dtn_priority_urgent_first
+} dtn_priority_mode_t;
+
+/* Destination of the live metrics, see dtn_metrics.c */
+typedef struct st_dtn_metrics_sink_t {
+    picoquic_mutex_t lock;
+    FILE* F;
+    uint64_t interval;
+} dtn_metrics_sink_t;
+
+/* Drop policy of the bottleneck buffer, see dtn_queue.c */
+typedef enum {
+    dtn_queue_tail_drop = 0,
+    dtn_queue_red
+} dtn_queue_policy_t;
+
+typedef struct st_dtn_test_spec_t {
+    uint64_t latency;
+    uint64_t max_completion_time;
+    picoquic_congestion_algorithm_t const* ccalgo;
+    test_api_stream_desc_t* scenario;
+    size_t sizeof_scenario;
+    double mbps_up;
+    double mbps_down;
+    uint64_t initial_flow_control_credit;
+    int auto_flow_control;
+    double target_utilization;
+    int zero_rtt_resume;
+    dtn_contact_t const* contact_plan;
+    size_t nb_contacts;
+    dtn_loss_model_t loss_model;
+    dtn_fec_t fec;
+    dtn_path_cache_t* path_cache;
+    int low_chatter;
+    uint64_t silence_duration;
+    test_api_stream_desc_t* silence_scenario;
+    size_t sizeof_silence_scenario;
+    uint64_t max_idle_timeout;
+    double max_silence_packets_per_hour;
+    uint64_t object_size;
+    char const* object_file;
+    char const* journal_file;
+    uint64_t journal_interval;
+    int journal_sync;
+    uint64_t restart_offset;
+    dtn_priority_mode_t priority_mode;
+    size_t urgent_max_size;
+    int event_loop;
+    uint64_t bottleneck_buffer;
+    dtn_queue_policy_t queue_policy;
+    size_t link_mtu;
+    int cipher_suite_id;
+    dtn_metrics_sink_t* metrics_sink;
+    int disable_ack_frequency;
+    uint64_t min_ack_gap;
+    uint64_t min_ack_delay;
+    uint64_t max_number_of_packets;
+    int has_loss;
+    dtn_log_level_t log_level;
+} dtn_test_spec_t;
+
+/* Profile of the simulation loop. The rounds are the calls to
+ * tls_api_one_sim_round during the data transfer phase, the jumps are
+ * the rounds that advance the simulated time. The wall times are in
+ * microseconds. The resident memory of the process is sampled every
+ * DTN_PROCESS_MEMORY_INTERVAL jumps; it is only meaningful if the
+ * test runs alone in the process.
+ */
+#define DTN_PROCESS_MEMORY_INTERVAL 256
+
+typedef struct st_dtn_sim_profile_t {
+    uint64_t nb_rounds;
+    uint64_t nb_active_rounds;
+    uint64_t nb_time_jumps;
+    uint64_t nb_small_jumps;
+    uint64_t max_time_jump;
+    uint64_t handshake_wall_time;
+    uint64_t transfer_wall_time;
+    size_t process_memory_start;
+    size_t process_memory_peak;
+} dtn_sim_profile_t;
+
+/* With auto_flow_control, the credit is computed from the bandwidth delay
+ * product, see dtn_flow_control_credit(). The target utilization is the
+ * fraction of the link rate that the credit should allow, 1.0 if not set.
+ * The credit is doubled because the updates of MAX_DATA take an RTT to
+ * reach the peer.
+ */
+#define DTN_FLOW_CONTROL_MARGIN 2.0
+
+/* Memory used by a connection, in bytes, see dtn_memory.c */
+typedef struct st_dtn_memory_sample_t {
+    size_t cnx_bytes;
+    size_t stream_bytes;
+    size_t retransmit_bytes;
+    size_t ack_range_bytes;
+    size_t total_bytes;
+} dtn_memory_sample_t;
+
+typedef struct st_dtn_memory_stats_t {
+    uint64_t nb_samples;
+    uint64_t last_sample_time;
+    size_t last_total_bytes;
+    double weighted_total;
+    uint64_t sampled_duration;
+    uint64_t peak_time;
+    dtn_memory_sample_t peak;
+} dtn_memory_stats_t;
+
+/* Use of each contact window, up to the end of the transfer */
+typedef struct st_dtn_contact_usage_t {
+    uint64_t duration;
+    uint64_t bytes_up;
+    uint64_t bytes_down;
+    double usage_up;
+    double usage_down;
+} dtn_contact_usage_t;
+
+/* Jumps of less than 1ms are counted as small, a sign that the simulation polls */
+#define DTN_SMALL_TIME_JUMP 1000
+
+/* Latency of one stream, from the request to the first and last byte of
+ * the response, in microseconds, and time of the request since the start
+ * of the transfer. Streams chained after another one are requested when
+ * the previous response ends. During the transfer, the times are
+ * recorded as absolute simulated times. */
+typedef struct st_dtn_stream_latency_t {
+    uint64_t stream_id;
+    int is_urgent;
+    uint64_t request_time;
+    uint64_t first_byte_time;
+    uint64_t last_byte_time;
+} dtn_stream_latency_t;
+
+/* Results of a single simulation, collected before the test context is deleted.
+ * Times are in microseconds of simulated time, except for the wall time.
+ * The goodput ratio compares the goodput during the transfer phase to the
+ * downlink rate. The overhead ratio is the number of bytes sent on the wire
+ * in excess of the application data, per byte of application data.
+ */
+typedef struct st_dtn_test_result_t {
+    int ret;
+    uint64_t completion_time;
+    uint64_t handshake_time;
+    uint64_t transfer_time;
+    uint64_t nb_packets_sent;
+    uint64_t nb_packets_received;
+    uint64_t nb_retransmissions;
+    uint64_t data_bytes;
+    uint64_t wire_bytes;
+    double goodput_mbps;
+    double goodput_ratio;
+    double overhead_ratio;
+    uint64_t flow_control_credit;
+    double credit_limit_mbps;
+    double credit_shortfall;
+    uint64_t first_completion_time;
+    uint64_t completion_time_saved;
+    uint64_t nb_zero_rtt_sent;
+    uint64_t nb_zero_rtt_acked;
+    uint64_t loss_model_packets;
+    uint64_t loss_model_losses;
+    uint64_t downlink_packets_dropped;
+    uint64_t fec_blocks;
+    uint64_t fec_recovered;
+    uint64_t fec_repair_bytes;
+    uint64_t server_cwin_max;
+    uint64_t server_smoothed_rtt_max;
+    int path_state_seeded;
+    uint64_t idle_timeout;
+    uint64_t keep_alive_interval;
+    uint64_t silence_packets;
+    double silence_packets_per_hour;
+    uint64_t object_bytes_received;
+    int object_verified;
+    uint64_t resume_offset;
+    uint64_t resume_latency;
+    uint64_t bytes_resent;
+    uint64_t journal_records;
+    uint64_t journal_bytes;
+    uint64_t journal_write_time;
+    uint64_t queue_peak_bytes;
+    double queue_average_bytes;
+    uint64_t queue_drops;
+    uint64_t burst_max;
+    double burst_average;
+    double burst_packet_ratio;
+    double pacing_error;
+    size_t link_mtu;
+    size_t send_mtu;
+    uint64_t mtu_convergence_time;
+    double packets_per_mb;
+    size_t nb_stream_latencies;
+    dtn_stream_latency_t stream_latency[PICOQUIC_MAX_TEST_STREAMS];
+    uint64_t urgent_first_byte_max;
+    uint64_t urgent_last_byte_max;
+    uint64_t bulk_last_byte_max;
+    uint64_t ack_packets;
+    uint64_t ack_bytes;
+    double ack_rate;
+    double uplink_usage;
+    double acks_per_data_packet;
+    size_t nb_contacts_used;
+    double contact_usage_down;
+    dtn_contact_usage_t contact_usage[DTN_MAX_CONTACTS];
+    uint64_t wall_time;
+    double wall_time_per_sim_sec;
+    dtn_sim_profile_t profile;
+    dtn_memory_stats_t client_memory;
+    dtn_memory_stats_t server_memory;
+} dtn_test_result_t;
+
+/* Fixed test cases, by name */
+typedef struct st_dtn_test_case_t {
+    char const* test_name;
+    uint8_t test_id;
+    void (*set_spec)(dtn_test_spec_t* spec);
+} dtn_test_case_t;
+
+extern const dtn_test_case_t dtn_test_cases[];
+extern const size_t dtn_nb_test_cases;
+
+void dtn_set_basic_test_spec(dtn_test_spec_t* spec);
+void dtn_set_object_test_spec(dtn_test_spec_t* spec, uint64_t object_size);
+void dtn_set_mtu_test_spec(dtn_test_spec_t* spec, size_t link_mtu);
+void dtn_set_cpu_test_spec(dtn_test_spec_t* spec, int cipher_suite_id, size_t link_mtu);
+void dtn_set_queue_test_spec(dtn_test_spec_t* spec, picoquic_congestion_algorithm_t const* ccalgo,
+    uint64_t bottleneck_buffer, dtn_queue_policy_t queue_policy);
+uint64_t dtn_flow_control_credit(dtn_test_spec_t const* spec, double mbps);
+int dtn_test_one_ex(uint8_t test_id, uint16_t test_seq, dtn_test_spec_t* spec, dtn_test_result_t* result);
+
+/* Batched writing of the binary log of a connection on a background thread */
+int dtn_async_log_attach(picoquic_cnx_t* cnx);
+
+/* Rate based congestion control for scheduled links, see dtn_cc.c */
+extern picoquic_congestion_algorithm_t const* dtn_cc_algorithm;
+picoquic_congestion_algorithm_t const* dtn_get_congestion_algorithm(char const* alg_name);
+int dtn_cc_set_link_rate(picoquic_quic_t* quic, double mbps, double fraction);
+void dtn_cc_clear_link_rate(picoquic_quic_t* quic);
+
+/* Link availability following the contact plan of the spec, see dtn_contact.c */
+typedef struct st_dtn_contact_state_t {
+    dtn_test_spec_t const* spec;
+    uint64_t* loss_mask;
+    uint64_t down_mask;
+    size_t current;
+    int is_up;
+    uint64_t window_start;
+    uint64_t bytes_up_start;
+    uint64_t bytes_down_start;
+    dtn_test_result_t* result;
+} dtn_contact_state_t;
+
+void dtn_contact_start(dtn_contact_state_t* state, dtn_test_spec_t const* spec, uint64_t* loss_mask,
+    dtn_test_result_t* result);
+uint64_t dtn_contact_update(dtn_contact_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+void dtn_contact_finish(dtn_contact_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+int dtn_contact_is_up(dtn_contact_state_t const* state);
+
+/* State of the loss model, see dtn_loss.c. One per direction: 0 for the uplink, 1 for the downlink */
+typedef struct st_dtn_loss_state_t {
+    dtn_loss_model_t const* model;
+    uint64_t random_ctx[2];
+    uint64_t mask[2];
+    uint64_t armed_mask[2];
+    int is_armed[2];
+    int is_bad[2];
+    size_t last_packet_size[2];
+    uint64_t blackout_mask;
+    uint64_t nb_packets;
+    uint64_t nb_losses;
+    dtn_fec_t const* fec;
+    size_t fec_nb_source;
+    size_t fec_nb_repair;
+    size_t fec_index[2];
+    uint8_t fec_fate[2][DTN_FEC_MAX_BLOCK];
+    uint64_t fec_blocks;
+    uint64_t fec_recovered;
+} dtn_loss_state_t;
+
+void dtn_loss_start(dtn_loss_state_t* state, dtn_loss_model_t const* model, dtn_fec_t const* fec);
+uint64_t dtn_loss_update(dtn_loss_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time, int link_is_up);
+
+/* Bottleneck buffer and traffic statistics of the downlink, see dtn_queue.c */
+typedef struct st_dtn_queue_state_t {
+    dtn_test_spec_t const* spec;
+    int is_started;
+    uint64_t drops_start;
+    uint64_t packets_start;
+    uint64_t last_sample_time;
+    uint64_t last_queue_bytes;
+    double weighted_bytes;
+    uint64_t sampled_duration;
+    uint64_t peak_bytes;
+    uint64_t last_packets_sent;
+    int has_sent;
+    uint64_t last_send_time;
+    uint64_t burst_length;
+    uint64_t nb_bursts;
+    uint64_t burst_packets;
+    uint64_t burst_max;
+    double pacing_error_sum;
+    uint64_t nb_paced_gaps;
+} dtn_queue_state_t;
+
+void dtn_queue_start(dtn_queue_state_t* state, dtn_test_spec_t const* spec);
+void dtn_queue_apply(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+void dtn_queue_sample(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+void dtn_queue_finish(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, dtn_test_result_t* result);
+
+/* Known link MTU, and send MTU of the server during the transfer, see dtn_mtu.c */
+typedef struct st_dtn_mtu_state_t {
+    dtn_test_spec_t const* spec;
+    int is_started;
+    uint64_t start_time;
+    uint64_t change_time;
+    size_t send_mtu;
+} dtn_mtu_state_t;
+
+size_t dtn_mtu_effective(size_t link_mtu);
+void dtn_mtu_set_parameters(picoquic_tp_t* tp, dtn_test_spec_t const* spec);
+void dtn_mtu_start(dtn_mtu_state_t* state, dtn_test_spec_t const* spec);
+void dtn_mtu_apply(dtn_mtu_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+void dtn_mtu_sample(dtn_mtu_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time);
+void dtn_mtu_finish(dtn_mtu_state_t* state, dtn_test_result_t* result);
+
+/* Live metrics of the running simulations, see dtn_metrics.c */
+typedef struct st_dtn_metrics_state_t {
+    dtn_metrics_sink_t* sink;
+    uint8_t test_id;
+    uint16_t test_seq;
+    uint64_t next_time;
+    uint64_t wall_time_start;
+} dtn_metrics_state_t;
+
+int dtn_metrics_sink_open(dtn_metrics_sink_t* sink, char const* file_name, uint64_t interval);
+void dtn_metrics_sink_close(dtn_metrics_sink_t* sink);
+void dtn_metrics_start(dtn_metrics_state_t* state, dtn_metrics_sink_t* sink, uint8_t test_id, uint16_t test_seq,
+    uint64_t simulated_time);
+void dtn_metrics_sample(dtn_metrics_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time,
+    dtn_sim_profile_t const* profile);
+void dtn_metrics_finish(dtn_metrics_state_t* state, uint64_t simulated_time, int ret);
+
+double dtn_fec_rate_factor(dtn_fec_t const* fec);
+
+/* CPU cost of the crypto and of the send and receive path, see dtn_cpu.c.
+ * The path is measured over a short link, so that the wall time is spent
+ * processing packets rather than jumping over silences. */
+#define DTN_CPU_TEST_LATENCY 10000
+
+/* Journal of the offset and checksum of the data received on each
+ * stream, see dtn_journal.c. The write time is wall clock time, in
+ * microseconds. */
+#define DTN_JOURNAL_MAX_STREAMS 16
+#define DTN_JOURNAL_DEFAULT_INTERVAL ((uint64_t)1024 * 1024)
+
+typedef struct st_dtn_journal_entry_t {
+    uint64_t stream_id;
+    uint64_t offset;
+    uint64_t checksum;
+} dtn_journal_entry_t;
+
+typedef struct st_dtn_journal_t {
+    FILE* F;
+    char file_name[256];
+    int is_sync;
+    size_t nb_entries;
+    dtn_journal_entry_t entry[DTN_JOURNAL_MAX_STREAMS];
+    uint64_t nb_file_records;
+    uint64_t nb_records;
+    uint64_t bytes_written;
+    uint64_t write_wall_time;
+} dtn_journal_t;
+
+int dtn_journal_open(dtn_journal_t* journal, char const* file_name, int is_sync);
+int dtn_journal_record(dtn_journal_t* journal, uint64_t stream_id, uint64_t offset, uint64_t checksum);
+dtn_journal_entry_t const* dtn_journal_find(dtn_journal_t const* journal, uint64_t stream_id);
+void dtn_journal_close(dtn_journal_t* journal);
+
+/* Large object download from a memory mapped file, see dtn_object.c.
+ * The file is mapped one view at a time. With a journal, the client can
+ * resume the download after a restart from the last journaled offset.
+ * If the spec sets a restart offset, the client process "crashes" once
+ * it has received that many bytes, and restarts from its journal on a
+ * new connection.
+ */
+#define DTN_OBJECT_VIEW_SIZE ((uint64_t)64 * 1024 * 1024)
+
+typedef struct st_dtn_object_file_t {
+#ifdef _WINDOWS
+    HANDLE h_file;
+    HANDLE h_map;
+#else
+    int fd;
+#endif
+    uint64_t size;
+    uint64_t view_offset;
+    size_t view_size;
+    uint8_t* view;
+} dtn_object_file_t;
+
+typedef struct st_dtn_object_ctx_t {
+    picoquic_test_tls_api_ctx_t* test_ctx;
+    dtn_object_file_t file;
+    char file_name[64];
+    int is_temporary;
+    uint64_t sent_offset;
+    uint64_t sent_checksum;
+    uint8_t request_header[8];
+    size_t request_header_length;
+    uint64_t received_offset;
+    uint64_t received_checksum;
+    int is_complete;
+    int error_detected;
+    int has_journal;
+    dtn_journal_t journal;
+    char journal_name[64];
+    int is_journal_temporary;
+    int is_journal_sync;
+    uint64_t journal_interval;
+    uint64_t journaled_offset;
+    uint64_t restart_offset;
+    int is_crashed;
+    uint64_t crash_offset;
+    uint64_t resume_offset;
+    uint64_t restart_time;
+    uint64_t resume_first_byte_time;
+} dtn_object_ctx_t;
+
+int dtn_object_init(dtn_object_ctx_t* object, dtn_test_spec_t const* spec, uint8_t test_id, uint16_t test_seq);
+int dtn_object_attach(dtn_object_ctx_t* object, picoquic_test_tls_api_ctx_t* test_ctx);
+int dtn_object_verify(dtn_object_ctx_t* object, dtn_test_result_t* result);
+int dtn_object_restart(dtn_object_ctx_t* object, uint64_t simulated_time);
+void dtn_object_release(dtn_object_ctx_t* object);
+int dtn_object_seek(FILE* F, uint64_t offset);
+
+typedef struct st_dtn_priority_ctx_t {
+    picoquic_test_tls_api_ctx_t* test_ctx;
+    dtn_test_spec_t const* spec;
+    uint64_t start_time;
+    size_t nb_streams;
+    dtn_stream_latency_t latency[PICOQUIC_MAX_TEST_STREAMS];
+    int is_priority_set[PICOQUIC_MAX_TEST_STREAMS];
+} dtn_priority_ctx_t;
+
+void dtn_priority_attach(dtn_priority_ctx_t* prio, picoquic_test_tls_api_ctx_t* test_ctx,
+    dtn_test_spec_t const* spec, uint64_t start_time);
+void dtn_priority_collect(dtn_priority_ctx_t* prio, dtn_test_result_t* result);
+
+/* Client and server contexts of the tests that run their own simulation
+ * loop, scaling, multipath and relay, see dtn_sim.c */
+typedef struct st_dtn_sim_quic_t {
+    picoquic_quic_t* qclient;
+    picoquic_quic_t* qserver;
+} dtn_sim_quic_t;
+
+int dtn_sim_create_quic(dtn_sim_quic_t* sim, uint32_t max_nb_connections, picoquic_stream_data_cb_fn server_callback,
+    picoquic_stream_data_cb_fn client_callback, void* callback_ctx, uint64_t* simulated_time);
+void dtn_sim_delete_quic(dtn_sim_quic_t* sim);
+void dtn_sim_set_transport(dtn_sim_quic_t* sim, picoquic_congestion_algorithm_t const* ccalgo, uint64_t idle_timeout,
+    uint64_t initial_max_path_id);
+void dtn_sim_link_set(picoquictest_sim_link_t* link, uint64_t latency, double mbps);
+int dtn_sim_prepare(picoquic_quic_t* quic, uint64_t simulated_time, struct sockaddr_storage const* default_from,
+    picoquictest_sim_packet_t** p_packet);
+int dtn_sim_deliver(picoquic_quic_t* quic, picoquictest_sim_link_t* link, uint64_t simulated_time,
+    uint64_t* nb_packets, uint64_t* nb_bytes);
+uint64_t dtn_sim_next_wake_time(picoquic_quic_t* quic, uint64_t next_time);
+int dtn_sim_is_awake(picoquic_quic_t* quic, uint64_t simulated_time);
+
+/* Multipath scenarios, see dtn_multipath.c. Each path goes through its
+ * own relay, with its own latency, rates and contact plan. A path without
+ * a contact plan is always up, with the latency and rates of the relay.
+ */
+#define DTN_MULTIPATH_MAX_PATHS 4
+
+typedef struct st_dtn_relay_path_t {
+    uint64_t latency;
+    double mbps_up;
+    double mbps_down;
+    dtn_contact_t const* contact_plan;
+    size_t nb_contacts;
+} dtn_relay_path_t;
+
+typedef struct st_dtn_multipath_spec_t {
+    uint64_t max_completion_time;
+    picoquic_congestion_algorithm_t const* ccalgo;
+    uint64_t object_size;
+    size_t nb_paths;
+    dtn_relay_path_t path[DTN_MULTIPATH_MAX_PATHS];
+} dtn_multipath_spec_t;
+
+/* The failure time is the first time a path went down during the
+ * transfer, 0 if none did. The failover stall is the longest gap in the
+ * data received by the client after the failure. */
+typedef struct st_dtn_multipath_result_t {
+    int ret;
+    uint64_t completion_time;
+    uint64_t bytes_received;
+    double goodput_mbps;
+    uint64_t path_bytes_down[DTN_MULTIPATH_MAX_PATHS];
+    uint64_t path_packets_lost[DTN_MULTIPATH_MAX_PATHS];
+    uint64_t failure_time;
+    uint64_t failover_stall;
+    uint64_t wall_time;
+} dtn_multipath_result_t;
+
+typedef struct st_dtn_multipath_case_t {
+    char const* test_name;
+    void (*set_spec)(dtn_multipath_spec_t* spec);
+} dtn_multipath_case_t;
+
+extern const dtn_multipath_case_t dtn_multipath_cases[];
+extern const size_t dtn_nb_multipath_cases;
+
+int dtn_multipath_test_one(dtn_multipath_spec_t const* spec, dtn_multipath_result_t* result);
+
+/* Store and forward relay, see dtn_relay.c. Hop 0 goes from the
+ * spacecraft to the relay, hop 1 from the relay to the ground station.
+ * In direct mode, one connection goes from the spacecraft to the ground
+ * over both hops. The usage of each hop is the ratio of the bytes sent
+ * on its downlink to its capacity while it was up.
+ */
+typedef struct st_dtn_relay_spec_t {
+    uint64_t max_completion_time;
+    picoquic_congestion_algorithm_t const* ccalgo;
+    uint64_t object_size;
+    dtn_relay_path_t hop[2];
+    int is_direct;
+} dtn_relay_spec_t;
+
+typedef struct st_dtn_relay_result_t {
+    int ret;
+    uint64_t completion_time;
+    uint64_t first_byte_time;
+    uint64_t bytes_received;
+    uint64_t custody_peak;
+    uint64_t hop_bytes_down[2];
+    double hop_usage_down[2];
+    uint64_t wall_time;
+} dtn_relay_result_t;
+
+typedef struct st_dtn_relay_case_t {
+    char const* test_name;
+    void (*set_spec)(dtn_relay_spec_t* spec);
+} dtn_relay_case_t;
+
+extern const dtn_relay_case_t dtn_relay_cases[];
+extern const size_t dtn_nb_relay_cases;
+
+int dtn_relay_test_one(dtn_relay_spec_t const* spec, dtn_relay_result_t* result);
+
+/* Idle timeout, keep alive interval and initial RTT, in microseconds,
+ * see dtn_idle.c. A null keep alive interval means no keep alive.
+ */
+typedef struct st_dtn_idle_schedule_t {
+    uint64_t idle_timeout;
+    uint64_t keep_alive_interval;
+    uint64_t initial_rtt;
+} dtn_idle_schedule_t;
+
+void dtn_idle_schedule(dtn_test_spec_t const* spec, dtn_idle_schedule_t* schedule);
+void dtn_idle_apply(picoquic_cnx_t* cnx, dtn_idle_schedule_t const* schedule, int is_client);
+
+/* Event driven simulation rounds, see dtn_event.c. The heap holds the
+ * next time of each source of events, UINT64_MAX if it has none. */
+typedef enum {
+    dtn_event_client = 0,
+    dtn_event_server,
+    dtn_event_uplink,
+    dtn_event_downlink,
+    dtn_event_model,
+    dtn_event_nb_sources
+} dtn_event_source_t;
+
+typedef struct st_dtn_event_queue_t {
+    int heap[dtn_event_nb_sources];
+    size_t position[dtn_event_nb_sources];
+    uint64_t time[dtn_event_nb_sources];
+} dtn_event_queue_t;
+
+void dtn_event_queue_init(dtn_event_queue_t* queue);
+void dtn_event_set(dtn_event_queue_t* queue, dtn_event_source_t source, uint64_t event_time);
+uint64_t dtn_event_next_time(dtn_event_queue_t const* queue);
+int dtn_event_sim_round(picoquic_test_tls_api_ctx_t* test_ctx, dtn_event_queue_t* queue,
+    uint64_t* simulated_time, uint64_t next_change, int* was_active);
+
+/* Replay of a binary log, see dtn_replay.c. The timeline has one line per
+ * interval with events, or one line per event if the interval is 0. A stall is a period longer than the stall threshold in
+ * which nothing was sent, while data was in flight, the congestion window
+ * had room for a packet and flow control did not block the sender.
+ */
+#define DTN_REPLAY_DEFAULT_INTERVAL 1000000
+#define DTN_REPLAY_STALL_THRESHOLD 1000000
+
+typedef struct st_dtn_replay_result_t {
+    uint64_t nb_events;
+    uint64_t nb_cc_updates;
+    uint64_t nb_packets_sent;
+    uint64_t nb_packets_received;
+    uint64_t nb_packets_lost;
+    uint64_t last_time;
+    uint64_t cwin_max;
+    uint64_t bytes_in_transit_max;
+    uint64_t smoothed_rtt_max;
+    uint64_t cwin_blocked_time;
+    uint64_t flow_blocked_time;
+    uint64_t nb_stalls;
+    uint64_t stall_time;
+    uint64_t longest_stall;
+    uint64_t longest_stall_start;
+} dtn_replay_result_t;
+
+int dtn_binlog_name(char* name, size_t name_size, uint8_t test_id, uint16_t test_seq, int is_client);
+int dtn_replay_binlog(char const* binlog_file, char const* csv_file, uint64_t interval, dtn_replay_result_t* result);
+
+/* Performance budgets of the fixed test cases, see dtn_baseline.c. The
+ * margins are applied to the current results when writing a baseline. */
+#define DTN_BASELINE_MAX_BUDGETS 128
+#define DTN_BASELINE_COMPLETION_MARGIN 1.05
+#define DTN_BASELINE_GOODPUT_MARGIN 0.95
+#define DTN_BASELINE_WALL_TIME_MARGIN 3.0
+#define DTN_BASELINE_MEMORY_MARGIN 1.25
+
+typedef struct st_dtn_budget_t {
+    char test_name[64];
+    uint8_t test_id;
+    uint64_t max_completion_time;
+    double min_goodput_ratio;
+    uint64_t max_wall_time;
+    uint64_t max_memory;
+} dtn_budget_t;
+
+typedef struct st_dtn_baseline_t {
+    size_t nb_budgets;
+    dtn_budget_t budget[DTN_BASELINE_MAX_BUDGETS];
+} dtn_baseline_t;
+
+void dtn_baseline_unload(void);
+dtn_budget_t const* dtn_baseline_find(uint8_t test_id, uint16_t test_seq);
+int dtn_budget_check(dtn_budget_t const* budget, dtn_test_result_t const* result);
+int dtn_baseline_check(uint8_t test_id, uint16_t test_seq, dtn_test_result_t const* result);
+uint64_t dtn_result_peak_memory(dtn_test_result_t const* result);
+
+/* Test cases described in a scenario file, see dtn_scenario.c. Loading
+ * the file only indexes the cases, each case is parsed when it runs,
+ * into storage that holds the spec and the arrays it points to. */
+#define DTN_SCENARIO_MAX_CASES 65535
+#define DTN_SCENARIO_MAX_BLACKOUTS 16
+#define DTN_SCENARIO_TEST_ID 0x5f
+
+typedef struct st_dtn_scenario_index_t {
+    size_t offset;
+    int line_number;
+    char name[64];
+} dtn_scenario_index_t;
+
+typedef struct st_dtn_scenario_file_t {
+    char* text;
+    size_t text_length;
+    size_t nb_cases;
+    size_t nb_cases_max;
+    dtn_scenario_index_t* cases;
+} dtn_scenario_file_t;
+
+typedef struct st_dtn_scenario_case_t {
+    dtn_test_spec_t spec;
+    size_t nb_streams;
+    test_api_stream_desc_t streams[PICOQUIC_MAX_TEST_STREAMS];
+    dtn_contact_t contacts[DTN_MAX_CONTACTS];
+    dtn_blackout_t blackouts[DTN_SCENARIO_MAX_BLACKOUTS];
+    int has_budget;
+    dtn_budget_t budget;
+} dtn_scenario_case_t;
+
+int dtn_scenario_file_load(dtn_scenario_file_t* file, char const* file_name);
+void dtn_scenario_file_release(dtn_scenario_file_t* file);
+int dtn_scenario_case_parse(dtn_scenario_file_t const* file, size_t case_index, dtn_scenario_case_t* scenario_case);
+
+/* Memory accounting of connections */
+void dtn_memory_sample(picoquic_cnx_t* cnx, dtn_memory_sample_t* sample);
+void dtn_memory_stats_update(dtn_memory_stats_t* stats, picoquic_cnx_t* cnx, uint64_t simulated_time);
+size_t dtn_memory_stats_average(dtn_memory_stats_t const* stats);
+size_t dtn_process_memory();
+
+/* Report of results, shared by the benchmarks and the sweeps. The row
+ * holds the fields of the CSV line, a small fraction of the full result,
+ * so the sweeps can keep one per point. */
+typedef struct st_dtn_result_row_t {
+    int ret;
+    uint64_t completion_time;
+    uint64_t handshake_time;
+    uint64_t transfer_time;
+    uint64_t nb_packets_sent;
+    uint64_t nb_packets_received;
+    uint64_t nb_retransmissions;
+    uint64_t data_bytes;
+    uint64_t wire_bytes;
+    double goodput_mbps;
+    double goodput_ratio;
+    double overhead_ratio;
+    uint64_t wall_time;
+    double wall_time_per_sim_sec;
+    size_t client_memory_peak;
+    size_t client_memory_average;
+    size_t server_memory_peak;
+    size_t server_memory_average;
+    size_t server_memory_stream;
+    size_t server_memory_retransmit;
+    size_t server_memory_ack_ranges;
+    uint64_t flow_control_credit;
+    double credit_limit_mbps;
+    double credit_shortfall;
+    uint64_t first_completion_time;
+    uint64_t completion_time_saved;
+    uint64_t nb_zero_rtt_sent;
+    uint64_t nb_zero_rtt_acked;
+    size_t nb_contacts_used;
+    double contact_usage_down;
+    uint64_t ack_packets;
+    uint64_t ack_bytes;
+    double ack_rate;
+    double uplink_usage;
+    double acks_per_data_packet;
+    uint64_t loss_model_packets;
+    uint64_t loss_model_losses;
+    uint64_t fec_blocks;
+    uint64_t fec_recovered;
+    uint64_t fec_repair_bytes;
+    uint64_t idle_timeout;
+    uint64_t keep_alive_interval;
+    uint64_t silence_packets;
+    double silence_packets_per_hour;
+    uint64_t object_bytes_received;
+    int object_verified;
+    size_t process_memory_start;
+    size_t process_memory_peak;
+    uint64_t urgent_first_byte_max;
+    uint64_t urgent_last_byte_max;
+    uint64_t bulk_last_byte_max;
+    uint64_t resume_offset;
+    uint64_t resume_latency;
+    uint64_t bytes_resent;
+    uint64_t journal_records;
+    uint64_t journal_bytes;
+    uint64_t journal_write_time;
+    uint64_t queue_peak_bytes;
+    double queue_average_bytes;
+    uint64_t queue_drops;
+    uint64_t burst_max;
+    double burst_average;
+    double burst_packet_ratio;
+    double pacing_error;
+    size_t link_mtu;
+    size_t send_mtu;
+    uint64_t mtu_convergence_time;
+    double packets_per_mb;
+} dtn_result_row_t;
+
+void dtn_result_row_set(dtn_result_row_t* row, dtn_test_result_t const* result);
+void dtn_result_row_csv_line(FILE* F, dtn_result_row_t const* result);
+void dtn_result_csv_header(FILE* F);
+void dtn_result_csv_line(FILE* F, dtn_test_result_t const* result);
+void dtn_result_json(FILE* F, dtn_test_result_t const* result);
+void dtn_profile_table_header(FILE* F);
+void dtn_profile_table_line(FILE* F, char const* test_name, dtn_test_result_t const* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DELAY_TOLERANT_INTERNAL_H */
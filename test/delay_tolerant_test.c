@@ -38,6 +38,8 @@
 #include "picoquic_logger.h"
 #include "performance_log.h"
 #include "picoquictest.h"
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
 
 
 /* Delay tolerant networking tests.
@@ -54,56 +56,720 @@
  * help us design the corresponding extension.
  */
 
-typedef struct st_dtn_test_spec_t {
-    uint64_t latency;
-    uint64_t max_completion_time;
-    picoquic_congestion_algorithm_t* ccalgo;
-    test_api_stream_desc_t* scenario;
-    size_t sizeof_scenario;
-    uint64_t mbps_up;
-    uint64_t mbps_down;
-    uint64_t initial_flow_control_credit;
-    uint64_t max_number_of_packets;
-    int has_loss;
-} dtn_test_spec_t;
+/* Models of the simulated links: contact plan, loss model, bottleneck queue
+ * and MTU, plus the live metrics of the test and the largest congestion
+ * window and smoothed RTT of the server during the transfer */
+typedef struct st_dtn_link_state_t {
+    dtn_contact_state_t contact;
+    dtn_loss_state_t loss;
+    dtn_queue_state_t queue;
+    dtn_mtu_state_t mtu;
+    dtn_metrics_state_t* metrics;
+    uint64_t server_cwin_max;
+    uint64_t server_smoothed_rtt_max;
+} dtn_link_state_t;
 
-static int dtn_test_one(uint8_t test_id, dtn_test_spec_t * spec)
+static int dtn_link_has_model(dtn_test_spec_t const* spec)
+{
+    return spec->nb_contacts > 0 || spec->loss_model.type != dtn_loss_none || spec->loss_model.nb_blackouts > 0;
+}
+
+/* Apply the models before a simulation round, and return the time at which
+ * the round should stop for the next change, or 0 if there is none. */
+static uint64_t dtn_link_update(dtn_link_state_t* links, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    uint64_t next_change = dtn_contact_update(&links->contact, test_ctx, simulated_time);
+    uint64_t next_loss_change = dtn_loss_update(&links->loss, test_ctx, simulated_time, dtn_contact_is_up(&links->contact));
+
+    if (next_change == 0 || (next_loss_change != 0 && next_loss_change < next_change)) {
+        next_change = next_loss_change;
+    }
+
+    return next_change;
+}
+
+/* Thinning of the ACKs sent by the client on the slow uplink. The server
+ * sets the ACK gap and delay of the client with ACK_FREQUENCY frames when
+ * the extension is negotiated. The spec can impose a floor on these
+ * values, which the harness applies before each round, so that frames
+ * received from the server cannot lower them.
+ */
+static void dtn_apply_ack_floor(picoquic_cnx_t* cnx, dtn_test_spec_t const* spec)
+{
+    if (cnx != NULL && (spec->min_ack_gap > 0 || spec->min_ack_delay > 0)) {
+        if (cnx->ack_gap_remote < spec->min_ack_gap) {
+            cnx->ack_gap_remote = spec->min_ack_gap;
+        }
+        if (cnx->ack_delay_remote < spec->min_ack_delay) {
+            cnx->ack_delay_remote = spec->min_ack_delay;
+        }
+    }
+}
+
+/* Data transfer loop. This follows the logic of tls_api_data_sending_loop,
+ * with instrumentation of the simulation rounds to show how the simulator
+ * advances the simulated time. With event_loop, the rounds are those of
+ * the event driven simulation, see dtn_event.c.
+ */
+static int dtn_data_sending_loop(picoquic_test_tls_api_ctx_t* test_ctx, dtn_test_spec_t const* spec,
+    uint64_t* loss_mask, uint64_t* simulated_time, dtn_sim_profile_t* profile,
+    dtn_memory_stats_t* client_memory, dtn_memory_stats_t* server_memory, dtn_link_state_t* links)
+{
+    int ret = 0;
+    int nb_inactive = 0;
+    dtn_event_queue_t queue;
+
+    dtn_event_queue_init(&queue);
+    test_ctx->c_to_s_link->loss_mask = loss_mask;
+    test_ctx->s_to_c_link->loss_mask = loss_mask;
+
+    while (ret == 0 && nb_inactive < 256 && TEST_CLIENT_READY && TEST_SERVER_READY) {
+        int was_active = 0;
+        uint64_t previous_time = *simulated_time;
+        uint64_t next_change = dtn_link_update(links, test_ctx, *simulated_time);
+
+        dtn_apply_ack_floor(test_ctx->cnx_client, spec);
+        if (spec->event_loop) {
+            ret = dtn_event_sim_round(test_ctx, &queue, simulated_time, next_change, &was_active);
+        }
+        else {
+            ret = tls_api_one_sim_round(test_ctx, simulated_time, next_change, &was_active);
+        }
+        dtn_queue_sample(&links->queue, test_ctx, *simulated_time);
+        dtn_mtu_sample(&links->mtu, test_ctx, *simulated_time);
+        profile->nb_rounds++;
+        dtn_metrics_sample(links->metrics, test_ctx, *simulated_time, profile);
+        if (test_ctx->cnx_server->path[0]->cwin > links->server_cwin_max) {
+            links->server_cwin_max = test_ctx->cnx_server->path[0]->cwin;
+        }
+        if (test_ctx->cnx_server->path[0]->smoothed_rtt > links->server_smoothed_rtt_max) {
+            links->server_smoothed_rtt_max = test_ctx->cnx_server->path[0]->smoothed_rtt;
+        }
+        if (*simulated_time > previous_time) {
+            uint64_t jump = *simulated_time - previous_time;
+            profile->nb_time_jumps++;
+            if (jump < DTN_SMALL_TIME_JUMP) {
+                profile->nb_small_jumps++;
+            }
+            if (jump > profile->max_time_jump) {
+                profile->max_time_jump = jump;
+            }
+            if (profile->nb_time_jumps % DTN_PROCESS_MEMORY_INTERVAL == 1) {
+                size_t process_memory = dtn_process_memory();
+
+                if (process_memory > profile->process_memory_peak) {
+                    profile->process_memory_peak = process_memory;
+                }
+            }
+            /* Memory only changes when packets are sent or received, sampling
+             * once per time jump is enough. */
+            dtn_memory_stats_update(client_memory, test_ctx->cnx_client, *simulated_time);
+            dtn_memory_stats_update(server_memory, test_ctx->cnx_server, *simulated_time);
+        }
+
+        if (ret < 0) {
+            break;
+        }
+
+        if (was_active) {
+            profile->nb_active_rounds++;
+        }
+
+        if (test_ctx->test_finished) {
+            if (test_ctx->immediate_exit ||
+                (picoquic_is_cnx_backlog_empty(test_ctx->cnx_client) && picoquic_is_cnx_backlog_empty(test_ctx->cnx_server))) {
+                break;
+            }
+        }
+        else if (was_active) {
+            nb_inactive = 0;
+        }
+        else {
+            nb_inactive++;
+        }
+    }
+
+    return ret;
+}
+
+/* ACK traffic on the uplink during the transfer. After the handshake,
+ * the client only sends the requests, which are small, and ACKs, so
+ * the bytes and packets sent by the client measure the ACK load.
+ */
+static void dtn_collect_ack_metrics(picoquic_test_tls_api_ctx_t* test_ctx, dtn_test_spec_t const* spec,
+    picoquic_path_quality_t const* uplink_start, uint64_t uplink_packets_start, uint64_t transfer_time,
+    dtn_test_result_t* result)
+{
+    picoquic_path_quality_t uplink_quality;
+    uint64_t request_bytes = 0;
+    uint64_t downlink_packets = (test_ctx->cnx_server == NULL) ? 0 : test_ctx->cnx_server->nb_packets_sent;
+
+    for (size_t i = 0; i < spec->sizeof_scenario / sizeof(test_api_stream_desc_t); i++) {
+        request_bytes += spec->scenario[i].q_len;
+    }
+    picoquic_get_default_path_quality(test_ctx->cnx_client, &uplink_quality);
+    result->ack_packets = test_ctx->cnx_client->nb_packets_sent - uplink_packets_start;
+    result->ack_bytes = uplink_quality.bytes_sent - uplink_start->bytes_sent;
+    result->ack_bytes = (result->ack_bytes > request_bytes) ? result->ack_bytes - request_bytes : 0;
+    if (transfer_time > 0) {
+        result->ack_rate = ((double)result->ack_packets) * 1000000.0 / (double)transfer_time;
+        result->uplink_usage = ((double)result->ack_bytes * 8.0) / (spec->mbps_up * (double)transfer_time);
+    }
+    if (downlink_packets > 0) {
+        result->acks_per_data_packet = ((double)result->ack_packets) / (double)downlink_packets;
+    }
+}
+
+/* Connection loop used when the links follow a contact plan or a loss
+ * model, since these also apply to the handshake, or when the server
+ * connection has to be set up as soon as it is created, before the first
+ * RTT sample: seeding from the path cache, and low chatter schedule.
+ */
+static int dtn_connection_loop(picoquic_test_tls_api_ctx_t* test_ctx, uint64_t* simulated_time,
+    dtn_test_spec_t const* spec, dtn_link_state_t* links, dtn_test_result_t* result)
+{
+    int ret = 0;
+    int nb_trials = 0;
+    int server_seeded = (spec->path_cache == NULL && !spec->low_chatter);
+    dtn_idle_schedule_t schedule;
+
+    dtn_idle_schedule(spec, &schedule);
+
+    while (ret == 0 && nb_trials < 100000 && !(TEST_CLIENT_READY && TEST_SERVER_READY)) {
+        int was_active = 0;
+        uint64_t next_change = dtn_link_update(links, test_ctx, *simulated_time);
+
+        if (!server_seeded && test_ctx->cnx_server != NULL) {
+            server_seeded = 1;
+            dtn_idle_apply(test_ctx->cnx_server, &schedule, 0);
+            if (spec->path_cache != NULL &&
+                dtn_path_state_seed(test_ctx->cnx_server, &spec->path_cache->state[1], &test_ctx->client_addr) &&
+                result != NULL) {
+                result->path_state_seeded = 1;
+            }
+        }
+        nb_trials++;
+        ret = tls_api_one_sim_round(test_ctx, simulated_time, next_change, &was_active);
+        if (test_ctx->cnx_client->cnx_state == picoquic_state_disconnected ||
+            (test_ctx->cnx_server != NULL && test_ctx->cnx_server->cnx_state == picoquic_state_disconnected)) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && !(TEST_CLIENT_READY && TEST_SERVER_READY)) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Free the test streams of the previous contact, so the same stream
+ * identifiers can be used again by the next connection.
+ */
+static void dtn_reset_test_streams(picoquic_test_tls_api_ctx_t* test_ctx)
+{
+    for (size_t i = 0; i < PICOQUIC_MAX_TEST_STREAMS; i++) {
+        test_api_stream_t* test_stream = &test_ctx->test_stream[i];
+
+        if (test_stream->q_src != NULL) {
+            free(test_stream->q_src);
+        }
+        if (test_stream->q_rcv != NULL) {
+            free(test_stream->q_rcv);
+        }
+        if (test_stream->r_src != NULL) {
+            free(test_stream->r_src);
+        }
+        if (test_stream->r_rcv != NULL) {
+            free(test_stream->r_rcv);
+        }
+    }
+    memset(test_ctx->test_stream, 0, sizeof(test_ctx->test_stream));
+    test_ctx->nb_test_streams = 0;
+    test_ctx->test_finished = 0;
+    test_ctx->streams_finished = 0;
+    test_ctx->reset_received = 0;
+    test_ctx->sum_data_received_at_server = 0;
+    test_ctx->sum_data_received_at_client = 0;
+}
+
+/* Silence after the transactions. The connections stay open without data
+ * to send, and the harness counts the packets sent by both sides until
+ * the end of the silence. In the low chatter mode, the count must stay
+ * within the budget of the spec. The transactions of the silence scenario
+ * then check that the connection survived. The data received before the
+ * silence is verified first, since the streams are reset for these
+ * transactions.
+ */
+static int dtn_silence_phase(picoquic_test_tls_api_ctx_t* test_ctx, uint64_t* simulated_time,
+    dtn_test_spec_t const* spec, uint64_t* loss_mask, dtn_test_result_t* result)
+{
+    uint64_t silence_end = *simulated_time + spec->silence_duration;
+    uint64_t packets_start = test_ctx->cnx_client->nb_packets_sent + test_ctx->cnx_server->nb_packets_sent;
+    uint64_t silence_packets = 0;
+    double packets_per_hour = 0;
+    int nb_trials = 0;
+    int ret = tls_api_one_scenario_verify(test_ctx);
+
+    while (ret == 0 && nb_trials < 100000 && *simulated_time < silence_end && TEST_CLIENT_READY && TEST_SERVER_READY) {
+        int was_active = 0;
+
+        nb_trials++;
+        ret = tls_api_one_sim_round(test_ctx, simulated_time, silence_end, &was_active);
+    }
+
+    if (ret == 0 && (*simulated_time < silence_end || !(TEST_CLIENT_READY && TEST_SERVER_READY))) {
+        DBG_PRINTF("Connection did not survive %" PRIu64 " us of silence", spec->silence_duration);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        silence_packets = test_ctx->cnx_client->nb_packets_sent + test_ctx->cnx_server->nb_packets_sent - packets_start;
+        packets_per_hour = ((double)silence_packets) * 3600000000.0 / (double)spec->silence_duration;
+        if (result != NULL) {
+            result->silence_packets = silence_packets;
+            result->silence_packets_per_hour = packets_per_hour;
+        }
+        if (spec->low_chatter && packets_per_hour > spec->max_silence_packets_per_hour) {
+            DBG_PRINTF("%" PRIu64 " packets during the silence, %.3f per hour, budget is %.3f",
+                silence_packets, packets_per_hour, spec->max_silence_packets_per_hour);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && spec->silence_scenario != NULL) {
+        dtn_reset_test_streams(test_ctx);
+        ret = test_api_init_send_recv_scenario(test_ctx, spec->silence_scenario, spec->sizeof_silence_scenario);
+        if (ret == 0) {
+            ret = tls_api_data_sending_loop(test_ctx, loss_mask, simulated_time, 100000);
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Transactions after the silence return %d", ret);
+        }
+    }
+
+    return ret;
+}
+
+/* Run the scenario in the simulated environment. This follows the
+ * same steps as tls_api_one_scenario_body, but keeps track of the
+ * end of the handshake so the handshake and the transfer times can
+ * be reported separately, and profiles the simulation loop.
+ *
+ * For a resumed connection, the data is queued before the client
+ * starts, so that the requests are sent as 0-RTT data. The times are
+ * counted from the start of the connection. If an object context is
+ * provided, the object transfer replaces the scenario. If the client
+ * crashes during the object transfer, the body ends without closing the
+ * connection.
+ */
+static int dtn_scenario_body(picoquic_test_tls_api_ctx_t* test_ctx, uint64_t* simulated_time,
+    dtn_test_spec_t* spec, int is_resumed, dtn_object_ctx_t* object, dtn_metrics_state_t* metrics,
+    dtn_test_result_t* result)
+{
+    uint64_t start_time = *simulated_time;
+    uint64_t loss_mask = (spec->has_loss) ? 0x10000000 : 0;
+    dtn_sim_profile_t local_profile;
+    dtn_sim_profile_t* profile = (result == NULL) ? &local_profile : &result->profile;
+    dtn_memory_stats_t local_memory[2];
+    dtn_memory_stats_t* client_memory = (result == NULL) ? &local_memory[0] : &result->client_memory;
+    dtn_memory_stats_t* server_memory = (result == NULL) ? &local_memory[1] : &result->server_memory;
+    uint64_t wall_time = picoquic_current_time();
+    dtn_link_state_t links;
+    picoquic_path_quality_t uplink_quality;
+    uint64_t uplink_packets = 0;
+    dtn_priority_ctx_t prio;
+    int has_prio = 0;
+    int ret = 0;
+
+    memset(&uplink_quality, 0, sizeof(picoquic_path_quality_t));
+    dtn_contact_start(&links.contact, spec, &loss_mask, result);
+    dtn_loss_start(&links.loss, &spec->loss_model, &spec->fec);
+    dtn_queue_start(&links.queue, spec);
+    dtn_mtu_start(&links.mtu, spec);
+    links.metrics = metrics;
+    links.server_cwin_max = 0;
+    links.server_smoothed_rtt_max = 0;
+    memset(profile, 0, sizeof(dtn_sim_profile_t));
+    memset(client_memory, 0, sizeof(dtn_memory_stats_t));
+    memset(server_memory, 0, sizeof(dtn_memory_stats_t));
+    profile->process_memory_start = dtn_process_memory();
+    profile->process_memory_peak = profile->process_memory_start;
+    if (is_resumed) {
+        if (object == NULL) {
+            ret = test_api_init_send_recv_scenario(test_ctx, spec->scenario, spec->sizeof_scenario);
+        }
+        if (ret == 0) {
+            ret = picoquic_start_client_cnx(test_ctx->cnx_client);
+        }
+    }
+    if (ret == 0) {
+        if (dtn_link_has_model(spec) || spec->path_cache != NULL || spec->low_chatter) {
+            ret = dtn_connection_loop(test_ctx, simulated_time, spec, &links, result);
+        }
+        else {
+            ret = tls_api_one_scenario_body_connect(test_ctx, simulated_time, 0, 0, 2 * spec->latency);
+        }
+    }
+    profile->handshake_wall_time = picoquic_current_time() - wall_time;
+    if (ret == 0 && spec->log_level != dtn_log_off) {
+        /* The server connection and its log are created during the handshake */
+        ret = dtn_async_log_attach(test_ctx->cnx_server);
+    }
+    if (result != NULL) {
+        result->handshake_time = *simulated_time - start_time;
+    }
+    if (ret == 0) {
+        picoquic_get_default_path_quality(test_ctx->cnx_client, &uplink_quality);
+        uplink_packets = test_ctx->cnx_client->nb_packets_sent;
+    }
+
+    if (ret == 0 && object != NULL) {
+        ret = dtn_object_attach(object, test_ctx);
+    }
+    else if (ret == 0 && !is_resumed) {
+        if (spec->priority_mode != dtn_priority_none) {
+            has_prio = 1;
+            dtn_priority_attach(&prio, test_ctx, spec, *simulated_time);
+        }
+        ret = test_api_init_send_recv_scenario(test_ctx, spec->scenario, spec->sizeof_scenario);
+        if (ret != 0) {
+            DBG_PRINTF("Init send receive scenario returns %d", ret);
+        }
+    }
+
+    if (ret == 0) {
+        dtn_queue_apply(&links.queue, test_ctx, *simulated_time);
+        dtn_mtu_apply(&links.mtu, test_ctx, *simulated_time);
+        wall_time = picoquic_current_time();
+        ret = dtn_data_sending_loop(test_ctx, spec, &loss_mask, simulated_time, profile,
+            client_memory, server_memory, &links);
+        profile->transfer_wall_time = picoquic_current_time() - wall_time;
+        dtn_contact_finish(&links.contact, test_ctx, *simulated_time);
+        /* The connections are closed without the loss model */
+        test_ctx->c_to_s_link->loss_mask = &loss_mask;
+        test_ctx->s_to_c_link->loss_mask = &loss_mask;
+        if (ret == 0 && spec->path_cache != NULL) {
+            /* Save the state at the end of the transfer, for the next connection */
+            dtn_path_state_save(test_ctx->cnx_client, &spec->path_cache->state[0]);
+            dtn_path_state_save(test_ctx->cnx_server, &spec->path_cache->state[1]);
+        }
+        if (result != NULL) {
+            result->loss_model_packets = links.loss.nb_packets;
+            result->loss_model_losses = links.loss.nb_losses;
+            result->downlink_packets_dropped = test_ctx->s_to_c_link->packets_dropped;
+            result->fec_blocks = links.loss.fec_blocks;
+            result->fec_recovered = links.loss.fec_recovered;
+            result->server_cwin_max = links.server_cwin_max;
+            result->server_smoothed_rtt_max = links.server_smoothed_rtt_max;
+        }
+        dtn_queue_finish(&links.queue, test_ctx, result);
+        dtn_mtu_finish(&links.mtu, result);
+        if (ret != 0) {
+            DBG_PRINTF("Data sending loop returns %d", ret);
+        }
+        else if (result != NULL) {
+            dtn_collect_ack_metrics(test_ctx, spec, &uplink_quality, uplink_packets,
+                *simulated_time - start_time - result->handshake_time, result);
+            if (has_prio) {
+                dtn_priority_collect(&prio, result);
+            }
+        }
+    }
+
+    if (object != NULL && object->is_crashed) {
+        /* The client process is down, the caller restarts it */
+        return ret;
+    }
+
+    if (ret == 0 && object != NULL) {
+        ret = dtn_object_verify(object, result);
+    }
+
+    if (ret == 0 && spec->silence_duration > 0) {
+        ret = dtn_silence_phase(test_ctx, simulated_time, spec, &loss_mask, result);
+    }
+
+    if (ret == 0) {
+        ret = tls_api_one_scenario_body_verify(test_ctx, simulated_time, start_time + spec->max_completion_time);
+    }
+
+    return ret;
+}
+
+/* Credit needed to keep the link busy at the target utilization: the bytes
+ * sent during one round trip, with a margin for the delay of the updates.
+ */
+uint64_t dtn_flow_control_credit(dtn_test_spec_t const* spec, double mbps)
+{
+    double utilization = (spec->target_utilization > 0) ? spec->target_utilization : 1.0;
+    double rtt = 2.0 * (double)spec->latency;
+    /* Mbps times microseconds gives bits */
+    double credit = DTN_FLOW_CONTROL_MARGIN * utilization * mbps * rtt / 8.0;
+
+    if (credit > (double)((uint64_t)1 << 61)) {
+        /* Stay well within the range of QUIC varints */
+        credit = (double)((uint64_t)1 << 61);
+    }
+
+    return (uint64_t)credit;
+}
+
+static void dtn_set_flow_control_credit(picoquic_tp_t* tp, uint64_t credit)
+{
+    if (credit > tp->initial_max_data) {
+        tp->initial_max_data = credit;
+    }
+    if (credit > tp->initial_max_stream_data_bidi_local) {
+        tp->initial_max_stream_data_bidi_local = credit;
+    }
+    if (credit > tp->initial_max_stream_data_bidi_remote) {
+        tp->initial_max_stream_data_bidi_remote = credit;
+    }
+}
+
+/* Collect the metrics of the run before the test context is deleted. */
+static void dtn_collect_result(picoquic_test_tls_api_ctx_t* test_ctx, dtn_test_spec_t* spec,
+    uint64_t start_time, uint64_t simulated_time, int ret, dtn_test_result_t* result)
+{
+    picoquic_cnx_t* cnx[2];
+
+    cnx[0] = test_ctx->cnx_client;
+    cnx[1] = test_ctx->cnx_server;
+
+    result->completion_time = simulated_time - start_time;
+    if (result->handshake_time <= result->completion_time) {
+        result->transfer_time = result->completion_time - result->handshake_time;
+    }
+    if (test_ctx->cnx_client != NULL) {
+        result->nb_packets_sent = test_ctx->cnx_client->nb_packets_sent;
+        result->nb_packets_received = test_ctx->cnx_client->nb_packets_received;
+        result->nb_zero_rtt_sent = test_ctx->cnx_client->nb_zero_rtt_sent;
+        result->nb_zero_rtt_acked = test_ctx->cnx_client->nb_zero_rtt_acked;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (cnx[i] != NULL) {
+            picoquic_path_quality_t quality;
+
+            picoquic_get_default_path_quality(cnx[i], &quality);
+            result->nb_retransmissions += cnx[i]->nb_retransmission_total;
+            result->wire_bytes += quality.bytes_sent;
+        }
+    }
+    if (ret == 0) {
+        size_t nb_streams = spec->sizeof_scenario / sizeof(test_api_stream_desc_t);
+        if (spec->object_size > 0) {
+            result->data_bytes = spec->object_size;
+        }
+        else {
+            for (size_t i = 0; i < nb_streams; i++) {
+                result->data_bytes += spec->scenario[i].q_len + spec->scenario[i].r_len;
+            }
+        }
+        if (result->completion_time > 0) {
+            result->goodput_mbps = ((double)result->data_bytes * 8.0) / (double)result->completion_time;
+        }
+        if (result->transfer_time > 0) {
+            /* Ratio between the goodput during the transfer and the downlink rate */
+            result->goodput_ratio = (((double)result->data_bytes * 8.0) / (double)result->transfer_time) / spec->mbps_down;
+        }
+        /* The repair packets are sent by the link, not by QUIC */
+        result->fec_repair_bytes = (uint64_t)((double)result->wire_bytes * (dtn_fec_rate_factor(&spec->fec) - 1.0));
+        if (result->data_bytes > 0 && test_ctx->cnx_server != NULL) {
+            result->packets_per_mb = ((double)test_ctx->cnx_server->nb_packets_sent) * 1000000.0 / (double)result->data_bytes;
+        }
+        if (result->data_bytes > 0 && result->wire_bytes + result->fec_repair_bytes > result->data_bytes) {
+            result->overhead_ratio = ((double)(result->wire_bytes + result->fec_repair_bytes - result->data_bytes)) / (double)result->data_bytes;
+        }
+    }
+    if (spec->latency > 0) {
+        /* At most one credit worth of data per round trip, bytes per microsecond
+         * times 8 gives Mbps. Report how far below the link rate that falls. */
+        result->credit_limit_mbps = ((double)result->flow_control_credit * 8.0) / (2.0 * (double)spec->latency);
+        if (result->credit_limit_mbps < spec->mbps_down) {
+            result->credit_shortfall = 1.0 - result->credit_limit_mbps / spec->mbps_down;
+            if (result->flow_control_credit < result->data_bytes) {
+                DBG_PRINTF("Flow control credit %" PRIu64 " limits the rate to %.3f Mbps, %.1f%% below the link rate",
+                    result->flow_control_credit, result->credit_limit_mbps, 100.0 * result->credit_shortfall);
+            }
+        }
+    }
+}
+
+/* Prepare the next contact with the same spacecraft. The connections of
+ * the first contact are closed and deleted, but the client context keeps
+ * the session ticket and the transport parameters remembered from the
+ * server, and the server context keeps the ticket encryption key. The new
+ * client connection can thus send its requests as 0-RTT data. It is not
+ * started yet, so the caller can queue the data first.
+ */
+static int dtn_resume_connection(picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time,
+    dtn_test_spec_t* spec, picoquic_tp_t const* client_parameters, picoquic_connection_id_t initial_cid)
+{
+    dtn_idle_schedule_t schedule;
+    int ret = 0;
+
+    dtn_idle_schedule(spec, &schedule);
+
+    picoquic_delete_cnx(test_ctx->cnx_client);
+    test_ctx->cnx_client = NULL;
+    if (test_ctx->cnx_server != NULL) {
+        picoquic_delete_cnx(test_ctx->cnx_server);
+        test_ctx->cnx_server = NULL;
+    }
+    dtn_reset_test_streams(test_ctx);
+
+    /* Mark the CID of the second contact so the logs do not collide */
+    initial_cid.id[5] = 1;
+    test_ctx->cnx_client = picoquic_create_cnx(test_ctx->qclient, initial_cid, picoquic_null_connection_id,
+        (struct sockaddr*)&test_ctx->server_addr, simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1,
+        PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+    if (test_ctx->cnx_client == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = picoquic_set_transport_parameters(test_ctx->cnx_client, client_parameters);
+        picoquic_set_callback(test_ctx->cnx_client, test_api_callback, (void*)&test_ctx->client_callback);
+        picoquic_set_congestion_algorithm(test_ctx->cnx_client, spec->ccalgo);
+        if (spec->link_mtu == 0) {
+            picoquic_cnx_set_pmtud_required(test_ctx->cnx_client, 1);
+        }
+        dtn_idle_apply(test_ctx->cnx_client, &schedule, 1);
+        if (spec->path_cache != NULL) {
+            (void)dtn_path_state_seed(test_ctx->cnx_client, &spec->path_cache->state[0], &test_ctx->server_addr);
+        }
+        if (ret == 0 && spec->log_level != dtn_log_off) {
+            ret = dtn_async_log_attach(test_ctx->cnx_client);
+        }
+    }
+
+    return ret;
+}
+
+/* The initial CID identifies the test, and names its log files */
+static void dtn_set_initial_cid(picoquic_connection_id_t* initial_cid, uint8_t test_id, uint16_t test_seq)
+{
+    memset(initial_cid, 0, sizeof(picoquic_connection_id_t));
+    initial_cid->id[0] = 0xde;
+    initial_cid->id[1] = 0x40;
+    initial_cid->id[2] = test_id;
+    initial_cid->id[3] = (uint8_t)(test_seq >> 8);
+    initial_cid->id[4] = (uint8_t)(test_seq & 0xff);
+    initial_cid->id_len = 8;
+}
+
+/* Name of the binary log of the first connection of a test, as set by
+ * picoquic in the log directory "." */
+int dtn_binlog_name(char* name, size_t name_size, uint8_t test_id, uint16_t test_seq, int is_client)
+{
+    int ret = 0;
+    picoquic_connection_id_t initial_cid;
+    char cid_name[2 * PICOQUIC_CONNECTION_ID_MAX_SIZE + 1];
+
+    dtn_set_initial_cid(&initial_cid, test_id, test_seq);
+    if (picoquic_print_connection_id_hexa(cid_name, sizeof(cid_name), &initial_cid) != 0 ||
+        picoquic_sprintf(name, name_size, NULL, ".%s%s.%s.log", PICOQUIC_FILE_SEPARATOR, cid_name,
+            (is_client) ? "client" : "server") != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int dtn_test_one_ex(uint8_t test_id, uint16_t test_seq, dtn_test_spec_t * spec, dtn_test_result_t * result)
 {
     uint64_t simulated_time = 0;
-    uint64_t picoseq_per_byte_up = (1000000ull * 8) / spec->mbps_up;
-    uint64_t picoseq_per_byte_down = (1000000ull * 8) / spec->mbps_down;
+    uint64_t start_time = 0;
+    double fec_factor = dtn_fec_rate_factor(&spec->fec);
+    uint64_t picoseq_per_byte_up = (uint64_t)((1000000.0 * 8 * fec_factor) / spec->mbps_up);
+    uint64_t picoseq_per_byte_down = (uint64_t)((1000000.0 * 8 * fec_factor) / spec->mbps_down);
+    uint64_t wall_time_start = picoquic_current_time();
     picoquic_tp_t client_parameters;
     picoquic_tp_t server_parameters;
-    picoquic_connection_id_t initial_cid = { {0xde, 0x40, 0, 0, 0, 0, 0, 0}, 8 };
+    picoquic_connection_id_t initial_cid;
     picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    dtn_idle_schedule_t schedule;
+    dtn_object_ctx_t object;
+    dtn_test_result_t budget_result;
+    dtn_metrics_state_t metrics;
+    int has_object = 0;
     int ret = 0;
 
-    initial_cid.id[2] = test_id;
+    if (result == NULL && dtn_baseline_find(test_id, test_seq) != NULL) {
+        /* The result is needed to check the performance budget */
+        result = &budget_result;
+    }
+    if (result != NULL) {
+        memset(result, 0, sizeof(dtn_test_result_t));
+    }
+    dtn_idle_schedule(spec, &schedule);
+    dtn_metrics_start(&metrics, spec->metrics_sink, test_id, test_seq, simulated_time);
+    if (spec->nb_contacts > DTN_MAX_CONTACTS) {
+        DBG_PRINTF("Contact plan has %" PRIst " windows, max is %d", spec->nb_contacts, DTN_MAX_CONTACTS);
+        ret = -1;
+    }
+    if (ret == 0 && spec->object_size > 0) {
+        /* Only the first contact transfers the object */
+        has_object = 1;
+        ret = dtn_object_init(&object, spec, test_id, test_seq);
+    }
+
+    dtn_set_initial_cid(&initial_cid, test_id, test_seq);
 
     memset(&client_parameters, 0, sizeof(picoquic_tp_t));
     picoquic_init_transport_parameters(&client_parameters, 1);
     client_parameters.enable_time_stamp = 3;
-    client_parameters.idle_timeout = (uint32_t)((spec->latency * 5)/1000);
-    if (spec->initial_flow_control_credit > client_parameters.initial_max_data) {
-        client_parameters.initial_max_data = spec->initial_flow_control_credit;
-    }
-    if (spec->initial_flow_control_credit > client_parameters.initial_max_stream_data_bidi_local ) {
-        client_parameters.initial_max_stream_data_bidi_local = spec->initial_flow_control_credit;
-    }
-    if (spec->initial_flow_control_credit > client_parameters.initial_max_stream_data_bidi_remote ) {
-        client_parameters.initial_max_stream_data_bidi_remote = spec->initial_flow_control_credit;
-    }
+    client_parameters.idle_timeout = (uint32_t)(schedule.idle_timeout / 1000);
     memset(&server_parameters, 0, sizeof(picoquic_tp_t));
     picoquic_init_transport_parameters(&server_parameters, 0);
     server_parameters.enable_time_stamp = 3;
     server_parameters.idle_timeout = client_parameters.idle_timeout;
+    dtn_mtu_set_parameters(&client_parameters, spec);
+    dtn_mtu_set_parameters(&server_parameters, spec);
+    if (spec->disable_ack_frequency) {
+        /* Not negotiated if the client does not announce a min ack delay */
+        client_parameters.min_ack_delay = 0;
+    }
+    /* The client parameters limit the data sent by the server on the
+     * downlink, the server parameters the data sent on the uplink. */
+    if (spec->auto_flow_control) {
+        dtn_set_flow_control_credit(&client_parameters, dtn_flow_control_credit(spec, spec->mbps_down));
+        dtn_set_flow_control_credit(&server_parameters, dtn_flow_control_credit(spec, spec->mbps_up));
+    }
+    else {
+        dtn_set_flow_control_credit(&client_parameters, spec->initial_flow_control_credit);
+        dtn_set_flow_control_credit(&server_parameters, spec->initial_flow_control_credit);
+    }
+    if (result != NULL) {
+        result->idle_timeout = schedule.idle_timeout;
+        result->keep_alive_interval = schedule.keep_alive_interval;
+        result->flow_control_credit = client_parameters.initial_max_stream_data_bidi_local;
+        if (client_parameters.initial_max_data < result->flow_control_credit) {
+            result->flow_control_credit = client_parameters.initial_max_data;
+        }
+    }
 
-    ret = tls_api_one_scenario_init_ex(&test_ctx, &simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1, &client_parameters, &server_parameters, &initial_cid, 0);
+    if (ret == 0) {
+        ret = tls_api_one_scenario_init_ex(&test_ctx, &simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1, &client_parameters, &server_parameters, &initial_cid, 0);
+    }
 
     if (ret == 0 && test_ctx == NULL) {
         ret = -1;
     }
 
+    if (ret == 0 && spec->ccalgo == dtn_cc_algorithm) {
+        /* The server sends on the downlink, the client on the uplink */
+        ret = dtn_cc_set_link_rate(test_ctx->qserver, spec->mbps_down / fec_factor, spec->target_utilization);
+        if (ret == 0) {
+            ret = dtn_cc_set_link_rate(test_ctx->qclient, spec->mbps_up / fec_factor, spec->target_utilization);
+        }
+    }
+
+    if (ret == 0 && spec->cipher_suite_id != 0) {
+        /* The client offers all the suites, the server picks this one */
+        ret = picoquic_set_cipher_suite(test_ctx->qserver, spec->cipher_suite_id);
+    }
+
     if (ret == 0) {
         picoquic_set_default_congestion_algorithm(test_ctx->qserver, spec->ccalgo);
         picoquic_set_congestion_algorithm(test_ctx->cnx_client, spec->ccalgo);
@@ -115,21 +781,66 @@ static int dtn_test_one(uint8_t test_id, dtn_test_spec_t * spec)
         test_ctx->stream0_flow_release = 1;
         test_ctx->immediate_exit = 1;
 
-        picoquic_cnx_set_pmtud_required(test_ctx->cnx_client, 1);
+        if (spec->link_mtu == 0) {
+            /* With a known link MTU, there is nothing to discover */
+            picoquic_cnx_set_pmtud_required(test_ctx->cnx_client, 1);
+        }
+        dtn_idle_apply(test_ctx->cnx_client, &schedule, 1);
+        if (spec->path_cache != NULL) {
+            (void)dtn_path_state_seed(test_ctx->cnx_client, &spec->path_cache->state[0], &test_ctx->server_addr);
+        }
+
+        if (spec->log_level != dtn_log_off) {
+            int use_long_log = (spec->log_level == dtn_log_full);
 
-        /* Set the binary log on the server side */
-        picoquic_set_qlog(test_ctx->qserver, ".");
-        test_ctx->qserver->use_long_log = 1;
+            /* Set the binary log on the server side */
+            picoquic_set_qlog(test_ctx->qserver, ".");
+            test_ctx->qserver->use_long_log = use_long_log;
 
-        /* set the binary log on the client side */
-        picoquic_set_qlog(test_ctx->qclient, ".");
-        test_ctx->qclient->use_long_log = 1;
-        /* Since the client connection was created before the binlog was set, force log of connection header */
-        binlog_new_connection(test_ctx->cnx_client);
+            /* set the binary log on the client side */
+            picoquic_set_qlog(test_ctx->qclient, ".");
+            test_ctx->qclient->use_long_log = use_long_log;
+            /* Since the client connection was created before the binlog was set, force log of connection header */
+            binlog_new_connection(test_ctx->cnx_client);
+            ret = dtn_async_log_attach(test_ctx->cnx_client);
+        }
 
         if (ret == 0) {
-            ret = tls_api_one_scenario_body(test_ctx, &simulated_time,
-                spec->scenario, spec->sizeof_scenario, 0, (spec->has_loss) ? 0x10000000 : 0, 0, 2 * spec->latency, spec->max_completion_time);
+            ret = dtn_scenario_body(test_ctx, &simulated_time, spec, 0, (has_object) ? &object : NULL, &metrics, result);
+        }
+
+        if (ret == 0 && has_object && object.is_crashed) {
+            /* The client restarts, and resumes the download from its journal on a new connection */
+            ret = dtn_object_restart(&object, simulated_time);
+            if (ret == 0) {
+                ret = dtn_resume_connection(test_ctx, simulated_time, spec, &client_parameters, initial_cid);
+            }
+            if (ret == 0) {
+                ret = dtn_scenario_body(test_ctx, &simulated_time, spec, 1, &object, &metrics, result);
+            }
+            if (result != NULL) {
+                result->resume_offset = object.resume_offset;
+                result->bytes_resent = object.crash_offset - object.resume_offset;
+                if (object.resume_first_byte_time > object.restart_time) {
+                    result->resume_latency = object.resume_first_byte_time - object.restart_time;
+                }
+            }
+        }
+
+        if (ret == 0 && spec->zero_rtt_resume) {
+            uint64_t first_completion_time = simulated_time;
+
+            start_time = simulated_time;
+            ret = dtn_resume_connection(test_ctx, simulated_time, spec, &client_parameters, initial_cid);
+            if (ret == 0) {
+                ret = dtn_scenario_body(test_ctx, &simulated_time, spec, 1, NULL, &metrics, result);
+            }
+            if (result != NULL) {
+                result->first_completion_time = first_completion_time;
+                if (simulated_time - start_time < first_completion_time) {
+                    result->completion_time_saved = first_completion_time - (simulated_time - start_time);
+                }
+            }
         }
     }
 
@@ -137,6 +848,9 @@ static int dtn_test_one(uint8_t test_id, dtn_test_spec_t * spec)
      */
 
     if (test_ctx != NULL) {
+        if (result != NULL) {
+            dtn_collect_result(test_ctx, spec, start_time, simulated_time, ret, result);
+        }
         if (spec->max_number_of_packets != 0 && ret == 0) {
             if (test_ctx->cnx_client != NULL) {
                 uint64_t number_of_packets = test_ctx->cnx_client->nb_packets_sent + test_ctx->cnx_client->nb_packets_received;
@@ -152,14 +866,39 @@ static int dtn_test_one(uint8_t test_id, dtn_test_spec_t * spec)
                 ret = -1;
             }
         }
+        if (spec->ccalgo == dtn_cc_algorithm) {
+            dtn_cc_clear_link_rate(test_ctx->qserver);
+            dtn_cc_clear_link_rate(test_ctx->qclient);
+        }
         tls_api_delete_ctx(test_ctx);
         test_ctx = NULL;
     }
+    if (has_object) {
+        dtn_object_release(&object);
+    }
 
-    return ret;
-}
-
-/* Basic test. Just verify that the handshake completes, and that a small
+    if (result != NULL) {
+        result->ret = ret;
+        result->wall_time = picoquic_current_time() - wall_time_start;
+        if (result->completion_time > 0) {
+            result->wall_time_per_sim_sec = ((double)result->wall_time) / ((double)result->completion_time);
+        }
+        if (ret == 0) {
+            ret = dtn_baseline_check(test_id, test_seq, result);
+            result->ret = ret;
+        }
+    }
+    dtn_metrics_finish(&metrics, simulated_time, ret);
+
+    return ret;
+}
+
+static int dtn_test_one(uint8_t test_id, dtn_test_spec_t * spec)
+{
+    return dtn_test_one_ex(test_id, 0, spec, NULL);
+}
+
+/* Basic test. Just verify that the handshake completes, and that a small
  * document can be downloaded
  */
 
@@ -178,14 +917,20 @@ void dtn_set_basic_test_spec(dtn_test_spec_t* spec)
     spec->mbps_up = 10;
     spec->mbps_down = 10;
     spec->has_loss = 0;
+    spec->log_level = dtn_log_full;
+}
+
+static void dtn_basic_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->max_number_of_packets = 84;
 }
 
 int dtn_basic_test()
 {
     /* Simple test. */
     dtn_test_spec_t spec;
-    dtn_set_basic_test_spec(&spec);
-    spec.max_number_of_packets = 84;
+    dtn_basic_test_spec(&spec);
 
     return dtn_test_one(0xba, &spec);
 }
@@ -194,19 +939,289 @@ static test_api_stream_desc_t dtn_scenario_data[] = {
     { 4, 0, 257, 100000000 }
 };
 
+static void dtn_data_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->scenario = dtn_scenario_data;
+    spec->sizeof_scenario = sizeof(dtn_scenario_data);
+    spec->auto_flow_control = 1; /* Credit matching the bandwidth delay product */
+    spec->max_completion_time = 500000000; /* 8 minutes and 20 sec, including 2 minutes handshae, 2 minutes req/resp, 2 minutes chirp... */
+}
 
 int dtn_data_test()
 {
     /* Simple test. */
     dtn_test_spec_t spec;
-    dtn_set_basic_test_spec(&spec);
-    spec.scenario = dtn_scenario_data;
-    spec.sizeof_scenario = sizeof(dtn_scenario_data);
-    spec.initial_flow_control_credit = 100000000; /* 100 MB, same as data size in scenario */
-    spec.max_completion_time = 500000000; /* 8 minutes and 20 sec, including 2 minutes handshae, 2 minutes req/resp, 2 minutes chirp... */
+    dtn_data_test_spec(&spec);
     return dtn_test_one(0xda, &spec);
 }
 
+/* Download of 10 MB, for the tests of the link options */
+static test_api_stream_desc_t dtn_scenario_ten_mb[] = {
+    { 4, 0, 257, 10000000 }
+};
+
+/* Download of 100 MB over a link of known MTU, see dtn_mtu.c. A null MTU
+ * keeps the path MTU discovery.
+ */
+void dtn_set_mtu_test_spec(dtn_test_spec_t* spec, size_t link_mtu)
+{
+    dtn_data_test_spec(spec);
+    spec->link_mtu = link_mtu;
+}
+
+/* With the link MTU known, the server should use it from the start of
+ * the transfer. */
+#define DTN_MTU_TEST_MTU 1440
+
+int dtn_mtu_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_set_mtu_test_spec(&spec, DTN_MTU_TEST_MTU);
+    spec.scenario = dtn_scenario_ten_mb;
+    spec.sizeof_scenario = sizeof(dtn_scenario_ten_mb);
+    ret = dtn_test_one_ex(0x3a, 0, &spec, &result);
+
+    if (ret == 0 && (result.send_mtu != DTN_MTU_TEST_MTU || result.mtu_convergence_time != 0)) {
+        DBG_PRINTF("Send MTU %" PRIst " after %" PRIu64 " us, link MTU is %d", result.send_mtu,
+            result.mtu_convergence_time, DTN_MTU_TEST_MTU);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Download of 10 MB over a short link with the given cipher suite and
+ * link MTU, for the measurement of the CPU cost of the send and receive
+ * path, see dtn_cpu.c. A null suite keeps the default of picoquic.
+ */
+void dtn_set_cpu_test_spec(dtn_test_spec_t* spec, int cipher_suite_id, size_t link_mtu)
+{
+    dtn_set_mtu_test_spec(spec, link_mtu);
+    spec->latency = DTN_CPU_TEST_LATENCY;
+    spec->max_completion_time = 60000000;
+    spec->scenario = dtn_scenario_ten_mb;
+    spec->sizeof_scenario = sizeof(dtn_scenario_ten_mb);
+    spec->cipher_suite_id = cipher_suite_id;
+}
+
+/* The server picks the suite that the harness sets. Chacha20 is the
+ * suite of CPUs without AES instructions. */
+int dtn_cipher_test()
+{
+    dtn_test_spec_t spec;
+
+    dtn_set_cpu_test_spec(&spec, 20, 0);
+    return dtn_test_one(0xc5, &spec);
+}
+
+/* Live metrics of the 10 MB download, one snapshot per simulated second,
+ * written to a sink of the test. The transfer takes more than 8 seconds
+ * at 10 Mbps, so there should be several snapshots, with growing
+ * delivered bytes, and a final line.
+ */
+#define DTN_METRICS_TEST_FILE "dtn_metrics_test.jsonl"
+#define DTN_METRICS_TEST_ID 0x3e
+
+static int dtn_metrics_test_check(char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "r");
+
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        char line[1024];
+        char test_key[32];
+        char const* acked_key = "\"bytes_acked\": ";
+        uint64_t nb_snapshots = 0;
+        uint64_t nb_done = 0;
+        uint64_t last_acked = 0;
+
+        (void)picoquic_sprintf(test_key, sizeof(test_key), NULL, "\"test_id\": %d,", DTN_METRICS_TEST_ID);
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            char const* acked = strstr(line, acked_key);
+
+            if (strstr(line, test_key) == NULL) {
+                /* Snapshot of another test running in parallel */
+                continue;
+            }
+            if (strstr(line, "\"event\": \"done\"") != NULL) {
+                nb_done++;
+            }
+            else if (acked == NULL) {
+                ret = -1;
+            }
+            else {
+                uint64_t bytes_acked = strtoull(acked + strlen(acked_key), NULL, 10);
+
+                if (bytes_acked < last_acked) {
+                    DBG_PRINTF("Delivered bytes go down from %" PRIu64 " to %" PRIu64, last_acked, bytes_acked);
+                    ret = -1;
+                }
+                last_acked = bytes_acked;
+                nb_snapshots++;
+            }
+        }
+        (void)picoquic_file_close(F);
+        if (ret == 0 && (nb_snapshots < 4 || nb_done != 1 || last_acked == 0)) {
+            DBG_PRINTF("%" PRIu64 " snapshots, %" PRIu64 " final lines, %" PRIu64 " bytes acked",
+                nb_snapshots, nb_done, last_acked);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int dtn_metrics_test()
+{
+    dtn_test_spec_t spec;
+    dtn_metrics_sink_t sink;
+    int ret;
+
+    dtn_set_mtu_test_spec(&spec, 0);
+    spec.scenario = dtn_scenario_ten_mb;
+    spec.sizeof_scenario = sizeof(dtn_scenario_ten_mb);
+    spec.log_level = dtn_log_off;
+    spec.metrics_sink = &sink;
+    if ((ret = dtn_metrics_sink_open(&sink, DTN_METRICS_TEST_FILE, 1000000)) == 0) {
+        ret = dtn_test_one(DTN_METRICS_TEST_ID, &spec);
+        dtn_metrics_sink_close(&sink);
+        if (ret == 0) {
+            ret = dtn_metrics_test_check(DTN_METRICS_TEST_FILE);
+        }
+        (void)remove(DTN_METRICS_TEST_FILE);
+    }
+
+    return ret;
+}
+
+/* Scenario file with a short download, a case with a contact plan, and
+ * a case with an invalid latency. The file loads, the second case parses
+ * into the expected spec, the third does not, and the first one runs
+ * within its budget. */
+#define DTN_SCENARIO_TEST_FILE "dtn_scenario_test.txt"
+
+static char const* dtn_scenario_test_text =
+    "# Scenario file of dtn_scenario_test\n"
+    "case short_download\n"
+    "latency 1\n"
+    "stream 4 0 257 2000\n"
+    "budget 60000000 0 0 0\n"
+    "\n"
+    "case leo_contacts\n"
+    "latency 0.02\n"
+    "cc dtn\n"
+    "contact 0 60 1 10 0.02\n"
+    "contact 600 660 1 10 0.02\n"
+    "loss ber 0.000001\n"
+    "blackout 10 12\n"
+    "stream 4 0 257 10000\n"
+    "stream 8 4 257 20000\n"
+    "case invalid_latency\n"
+    "latency -1\n";
+
+int dtn_scenario_test()
+{
+    dtn_scenario_file_t file;
+    dtn_scenario_case_t scenario_case;
+    dtn_test_result_t result;
+    FILE* F = picoquic_file_open(DTN_SCENARIO_TEST_FILE, "w");
+    int ret = 0;
+
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        fputs(dtn_scenario_test_text, F);
+        (void)picoquic_file_close(F);
+        ret = dtn_scenario_file_load(&file, DTN_SCENARIO_TEST_FILE);
+    }
+
+    if (ret == 0) {
+        if (file.nb_cases != 3 || strcmp(file.cases[1].name, "leo_contacts") != 0) {
+            DBG_PRINTF("Loaded %" PRIst " cases, expected 3", file.nb_cases);
+            ret = -1;
+        }
+        else if (dtn_scenario_case_parse(&file, 1, &scenario_case) != 0) {
+            DBG_PRINTF("%s", "Cannot parse the contact plan case");
+            ret = -1;
+        }
+        else if (scenario_case.spec.latency != 20000 || scenario_case.spec.nb_contacts != 2 ||
+            scenario_case.spec.contact_plan[1].start_time != 600000000 ||
+            scenario_case.spec.loss_model.type != dtn_loss_ber || scenario_case.spec.loss_model.nb_blackouts != 1 ||
+            scenario_case.spec.sizeof_scenario != 2 * sizeof(test_api_stream_desc_t) ||
+            scenario_case.spec.scenario[1].r_len != 20000 || scenario_case.spec.ccalgo != dtn_cc_algorithm) {
+            DBG_PRINTF("%s", "Contact plan case does not match the file");
+            ret = -1;
+        }
+        else if (dtn_scenario_case_parse(&file, 2, &scenario_case) == 0) {
+            DBG_PRINTF("%s", "Invalid case was accepted");
+            ret = -1;
+        }
+        else if (dtn_scenario_case_parse(&file, 0, &scenario_case) != 0 || !scenario_case.has_budget) {
+            DBG_PRINTF("%s", "Cannot parse the short download case");
+            ret = -1;
+        }
+        else if ((ret = dtn_test_one_ex(DTN_SCENARIO_TEST_ID, 0, &scenario_case.spec, &result)) == 0) {
+            ret = dtn_budget_check(&scenario_case.budget, &result);
+        }
+        dtn_scenario_file_release(&file);
+    }
+    (void)remove(DTN_SCENARIO_TEST_FILE);
+
+    return ret;
+}
+
+/* Download of 100 MB with a credit of 100 MB, through the bottleneck
+ * buffer of a radio modem, see dtn_queue.c. Losses take at least one RTT
+ * of 2 minutes to repair, so the completion time is generous.
+ */
+#define DTN_QUEUE_CREDIT 100000000
+
+void dtn_set_queue_test_spec(dtn_test_spec_t* spec, picoquic_congestion_algorithm_t const* ccalgo,
+    uint64_t bottleneck_buffer, dtn_queue_policy_t queue_policy)
+{
+    dtn_data_test_spec(spec);
+    spec->ccalgo = ccalgo;
+    spec->auto_flow_control = 0;
+    spec->initial_flow_control_credit = DTN_QUEUE_CREDIT;
+    spec->bottleneck_buffer = bottleneck_buffer;
+    spec->queue_policy = queue_policy;
+    spec->max_completion_time = 3600000000ull;
+}
+
+/* The DTN congestion control sends at the link rate, so 10 MB should go
+ * through a 1 MB buffer, and the queue should never hold more than the
+ * buffer. */
+#define DTN_QUEUE_TEST_BUFFER 1000000
+
+int dtn_queue_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_set_queue_test_spec(&spec, dtn_cc_algorithm, DTN_QUEUE_TEST_BUFFER, dtn_queue_tail_drop);
+    spec.scenario = dtn_scenario_ten_mb;
+    spec.sizeof_scenario = sizeof(dtn_scenario_ten_mb);
+    spec.max_completion_time = 500000000;
+    ret = dtn_test_one_ex(0x9b, 0, &spec, &result);
+
+    if (ret == 0 && (result.queue_peak_bytes == 0 ||
+        result.queue_peak_bytes > DTN_QUEUE_TEST_BUFFER + PICOQUIC_MAX_PACKET_SIZE)) {
+        DBG_PRINTF("Queue peaks at %" PRIu64 " bytes, buffer is %d", result.queue_peak_bytes, DTN_QUEUE_TEST_BUFFER);
+        ret = -1;
+    }
+
+    return ret;
+}
+
 
 static test_api_stream_desc_t dtn_scenario_silence[] = {
     { 4, 0, 257, 257 },
@@ -214,27 +1229,1059 @@ static test_api_stream_desc_t dtn_scenario_silence[] = {
     { 12, 8, 257, 257 }
 };
 
+static void dtn_silence_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->scenario = dtn_scenario_silence;
+    spec->sizeof_scenario = sizeof(dtn_scenario_silence);
+    spec->max_number_of_packets = 95; /* Check that the number of packets does not increase wildly */
+    spec->max_completion_time = 481000000; /* 8 minutes: 2 for handshake, plus 2 per transaction */
+}
+
 int dtn_silence_test()
 {
     /* Simple test. */
     dtn_test_spec_t spec;
-    dtn_set_basic_test_spec(&spec);
-    spec.scenario = dtn_scenario_silence;
-    spec.sizeof_scenario = sizeof(dtn_scenario_silence);
-    spec.max_number_of_packets = 95; /* Check that the number of packets does not increase wildly */
-    spec.max_completion_time = 481000000; /* 8 minutes: 2 for handshake, plus 2 per transaction */
+    dtn_silence_test_spec(&spec);
     return dtn_test_one(0x51, &spec);
 }
 
+/* Long silences in the low chatter mode. One transaction, then the
+ * connection stays idle, then a second transaction checks that it is
+ * still up. The idle timeout covers the silence, so no packet should be
+ * sent during it, for an hour at the basic latency or for a day at 20
+ * minutes. If the idle timeout is capped at one hour, keep alives are
+ * needed, once per hour, and each costs a PING and its ACK.
+ * The default variant uses the previous schedule, with the picoquic
+ * keep alive, for comparison in the benchmark.
+ */
+static test_api_stream_desc_t dtn_scenario_before_silence[] = {
+    { 4, 0, 257, 257 }
+};
+
+static test_api_stream_desc_t dtn_scenario_after_silence[] = {
+    { 8, 0, 257, 257 }
+};
+
+static void dtn_silence_spec(dtn_test_spec_t* spec, uint64_t latency, uint64_t silence_duration)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->latency = latency;
+    spec->scenario = dtn_scenario_before_silence;
+    spec->sizeof_scenario = sizeof(dtn_scenario_before_silence);
+    spec->silence_scenario = dtn_scenario_after_silence;
+    spec->sizeof_silence_scenario = sizeof(dtn_scenario_after_silence);
+    spec->silence_duration = silence_duration;
+    spec->low_chatter = 1;
+    spec->max_completion_time = silence_duration + 8 * latency;
+}
+
+static void dtn_silence_hour_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_silence_spec(spec, 60000000, 3600000000ull);
+    spec->max_number_of_packets = 95;
+}
+
+static void dtn_silence_hour_default_spec(dtn_test_spec_t* spec)
+{
+    dtn_silence_hour_test_spec(spec);
+    spec->low_chatter = 0;
+    spec->max_number_of_packets = 0;
+}
+
+static void dtn_silence_day_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_silence_spec(spec, 20 * 60000000ull, 24 * 3600000000ull);
+    spec->max_number_of_packets = 95;
+}
+
+static void dtn_silence_capped_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_silence_spec(spec, 60000000, 6 * 3600000000ull);
+    spec->max_idle_timeout = 3600000000ull;
+    spec->max_silence_packets_per_hour = 3.0;
+}
+
+int dtn_silence_hour_test()
+{
+    dtn_test_spec_t spec;
+    dtn_silence_hour_test_spec(&spec);
+    return dtn_test_one(0x52, &spec);
+}
+
+int dtn_silence_day_test()
+{
+    dtn_test_spec_t spec;
+    dtn_silence_day_test_spec(&spec);
+    return dtn_test_one(0x53, &spec);
+}
+
+int dtn_silence_capped_test()
+{
+    dtn_test_spec_t spec;
+    dtn_silence_capped_test_spec(&spec);
+    return dtn_test_one(0x54, &spec);
+}
+
+static void dtn_twenty_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->latency = 20 * 60000000;
+    spec->max_completion_time = 8* spec->latency;
+
+    spec->max_number_of_packets = 96;
+}
+
 int dtn_twenty_test()
 {
     /* Simple test. */
     dtn_test_spec_t spec;
+    dtn_twenty_test_spec(&spec);
+
+    return dtn_test_one(0x20, &spec);
+}
+
+/* Same exchange as the basic test, with the event driven rounds of
+ * dtn_event.c. The number of rounds depends on the events, not on the
+ * latency: with one hour of latency, the test should not take many more
+ * rounds than with one second.
+ */
+static void dtn_event_test_spec(dtn_test_spec_t* spec, uint64_t latency)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->latency = latency;
+    spec->max_completion_time = 8 * spec->latency;
+    spec->event_loop = 1;
+}
+
+static void dtn_twenty_event_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_event_test_spec(spec, 20 * 60000000);
+}
+
+int dtn_event_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result_second;
+    dtn_test_result_t result_hour;
+    int ret;
+
+    dtn_event_test_spec(&spec, 1000000);
+    ret = dtn_test_one_ex(0xe0, 1, &spec, &result_second);
+
+    if (ret == 0) {
+        dtn_event_test_spec(&spec, 3600000000ull);
+        ret = dtn_test_one_ex(0xe0, 2, &spec, &result_hour);
+    }
+
+    if (ret == 0 && result_hour.profile.nb_rounds > 2 * result_second.profile.nb_rounds + 64) {
+        DBG_PRINTF("%" PRIu64 " rounds with 1 hour latency, %" PRIu64 " with 1 second",
+            result_hour.profile.nb_rounds, result_second.profile.nb_rounds);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Replay of the server log of the basic exchange. The timeline should
+ * show the packets sent, and an RTT of at least the one way latency.
+ */
+#define DTN_REPLAY_TEST_FILE "dtn_replay_test.csv"
+
+int dtn_replay_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    dtn_replay_result_t replay;
+    char binlog_file[512];
+    int ret;
+
     dtn_set_basic_test_spec(&spec);
-    spec.latency = 20 * 60000000;
-    spec.max_completion_time = 8* spec.latency;
+    ret = dtn_test_one_ex(0x7e, 0, &spec, &result);
+
+    if (ret == 0) {
+        ret = dtn_binlog_name(binlog_file, sizeof(binlog_file), 0x7e, 0, 0);
+    }
+    if (ret == 0) {
+        ret = dtn_replay_binlog(binlog_file, DTN_REPLAY_TEST_FILE, DTN_REPLAY_DEFAULT_INTERVAL, &replay);
+    }
+    if (ret == 0 && (replay.nb_cc_updates == 0 || replay.nb_packets_sent == 0)) {
+        DBG_PRINTF("Replay of %s finds %" PRIu64 " updates, %" PRIu64 " packets sent", binlog_file,
+            replay.nb_cc_updates, replay.nb_packets_sent);
+        ret = -1;
+    }
+    if (ret == 0 && replay.smoothed_rtt_max < spec.latency) {
+        DBG_PRINTF("Replay of %s finds RTT %" PRIu64 " us", binlog_file, replay.smoothed_rtt_max);
+        ret = -1;
+    }
+    /* The log also covers the handshake, and the live values are sampled
+     * between rounds, so the maxima only match within a factor 2. A field
+     * read from the wrong position would be far off. */
+    if (ret == 0 && (2 * replay.cwin_max < result.server_cwin_max || replay.cwin_max > 2 * result.server_cwin_max ||
+        2 * replay.smoothed_rtt_max < result.server_smoothed_rtt_max ||
+        replay.smoothed_rtt_max > 2 * result.server_smoothed_rtt_max)) {
+        DBG_PRINTF("Replay of %s finds cwin max %" PRIu64 ", srtt max %" PRIu64 ", connection had %" PRIu64 ", %" PRIu64,
+            binlog_file, replay.cwin_max, replay.smoothed_rtt_max, result.server_cwin_max, result.server_smoothed_rtt_max);
+        ret = -1;
+    }
+    (void)remove(DTN_REPLAY_TEST_FILE);
+
+    return ret;
+}
 
-    spec.max_number_of_packets = 96;
+/* Second contact with the same spacecraft, resuming the session of the
+ * first one. The requests are sent as 0-RTT data, which saves the round
+ * trip of the handshake, 2 minutes with the basic latency.
+ */
+static void dtn_resume_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->zero_rtt_resume = 1;
+}
 
-    return dtn_test_one(0x20, &spec);
-}
\ No newline at end of file
+int dtn_resume_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_resume_test_spec(&spec);
+    ret = dtn_test_one_ex(0x0e, 0, &spec, &result);
+
+    if (ret == 0 && result.nb_zero_rtt_acked == 0) {
+        DBG_PRINTF("%s", "No 0-RTT data acknowledged on the resumed contact");
+        ret = -1;
+    }
+    if (ret == 0 && result.completion_time_saved < spec.latency) {
+        DBG_PRINTF("Resumed contact saves only %" PRIu64 " us", result.completion_time_saved);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Same download as the data test, streamed from a memory mapped file
+ * instead of the test application. Nothing should be queued on the
+ * server stream, the data is copied from the file to the packets.
+ */
+#define DTN_OBJECT_MAX_STREAM_MEMORY 65536
+
+void dtn_set_object_test_spec(dtn_test_spec_t* spec, uint64_t object_size)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->auto_flow_control = 1;
+    spec->object_size = object_size;
+    /* Handshake, request, slow start, plus twice the transfer time */
+    spec->max_completion_time = 8 * spec->latency + (uint64_t)(2.0 * ((double)object_size * 8.0) / spec->mbps_down);
+}
+
+static void dtn_object_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_object_test_spec(spec, 100000000);
+}
+
+/* Restart of the ground process during a download. The client crashes
+ * after receiving 60% of the object, and the new connection resumes from
+ * the last journaled offset, so at most one journal interval is sent
+ * again. The sync variant forces each record to the disk, with a finer
+ * interval, which the benchmark uses to measure the write overhead.
+ */
+static void dtn_object_resume_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_set_object_test_spec(spec, 20000000);
+    spec->restart_offset = 12000000;
+    /* The new connection needs a handshake and a request */
+    spec->max_completion_time += 4 * spec->latency;
+}
+
+static void dtn_object_resume_sync_spec(dtn_test_spec_t* spec)
+{
+    dtn_object_resume_test_spec(spec);
+    spec->journal_sync = 1;
+    spec->journal_interval = 65536;
+}
+
+int dtn_object_resume_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_object_resume_test_spec(&spec);
+    ret = dtn_test_one_ex(0x0c, 0, &spec, &result);
+
+    if (ret == 0 && (result.resume_offset == 0 || result.bytes_resent > DTN_JOURNAL_DEFAULT_INTERVAL)) {
+        DBG_PRINTF("Resumed at %" PRIu64 ", %" PRIu64 " bytes sent again", result.resume_offset, result.bytes_resent);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int dtn_object_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_object_test_spec(&spec);
+    ret = dtn_test_one_ex(0x0b, 0, &spec, &result);
+
+    if (ret == 0 && result.server_memory.peak.stream_bytes > DTN_OBJECT_MAX_STREAM_MEMORY) {
+        DBG_PRINTF("Server stream memory peaks at %" PRIst " bytes", result.server_memory.peak.stream_bytes);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Telemetry and commands sent alongside bulk data. Two bulk downloads of
+ * 25 MB share the connection with a telemetry report and a chain of
+ * three commands, each sent when the previous answer arrives, so that
+ * they compete with the bulk transfer. The benchmark compares the
+ * scheduling modes. The test checks that serving the urgent streams first
+ * reduces the latency of the commands compared to FIFO.
+ */
+static test_api_stream_desc_t dtn_scenario_mixed[] = {
+    { 4, 0, 257, 25000000 },
+    { 8, 0, 257, 25000000 },
+    { 12, 0, 128, 1000 },
+    { 16, 0, 64, 200 },
+    { 20, 16, 64, 200 },
+    { 24, 20, 64, 200 }
+};
+
+static void dtn_mixed_spec(dtn_test_spec_t* spec, dtn_priority_mode_t priority_mode)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->scenario = dtn_scenario_mixed;
+    spec->sizeof_scenario = sizeof(dtn_scenario_mixed);
+    spec->auto_flow_control = 1;
+    spec->priority_mode = priority_mode;
+    spec->urgent_max_size = 16384;
+    spec->max_completion_time = 1200000000;
+}
+
+static void dtn_mixed_fifo_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_mixed_spec(spec, dtn_priority_fifo);
+}
+
+static void dtn_mixed_round_robin_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_mixed_spec(spec, dtn_priority_round_robin);
+}
+
+static void dtn_mixed_urgent_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_mixed_spec(spec, dtn_priority_urgent_first);
+}
+
+int dtn_priority_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t fifo;
+    dtn_test_result_t urgent;
+    int ret;
+
+    dtn_mixed_fifo_test_spec(&spec);
+    ret = dtn_test_one_ex(0x9f, 0, &spec, &fifo);
+    if (ret == 0) {
+        dtn_mixed_urgent_test_spec(&spec);
+        ret = dtn_test_one_ex(0x9d, 0, &spec, &urgent);
+    }
+    if (ret == 0) {
+        DBG_PRINTF("Command latency %" PRIu64 " us with FIFO, %" PRIu64 " us urgent first",
+            fifo.urgent_last_byte_max, urgent.urgent_last_byte_max);
+        if (urgent.urgent_last_byte_max >= fifo.urgent_last_byte_max) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Multipath download through an orbiter relay and a direct to Earth
+ * link. The relay has the higher rate, the direct link the longer
+ * latency. The benchmark compares each link alone to the combination,
+ * and projects the daily volume from the goodput. In the failover
+ * case, the relay goes down during the transfer, which completes on the
+ * direct link.
+ */
+static const dtn_contact_t dtn_multipath_relay_failure[] = {
+    { 0, 400000000, 1.0, 10.0, 60000000 }
+};
+
+static void dtn_multipath_relay_path(dtn_relay_path_t* path)
+{
+    path->latency = 60000000;
+    path->mbps_up = 1.0;
+    path->mbps_down = 10.0;
+}
+
+static void dtn_multipath_direct_path(dtn_relay_path_t* path)
+{
+    path->latency = 70000000;
+    path->mbps_up = 0.5;
+    path->mbps_down = 5.0;
+}
+
+static void dtn_multipath_base_spec(dtn_multipath_spec_t* spec)
+{
+    memset(spec, 0, sizeof(dtn_multipath_spec_t));
+    spec->max_completion_time = 1200000000;
+    spec->ccalgo = picoquic_newreno_algorithm;
+    spec->object_size = 20000000;
+}
+
+static void dtn_multipath_relay_only_spec(dtn_multipath_spec_t* spec)
+{
+    dtn_multipath_base_spec(spec);
+    spec->nb_paths = 1;
+    dtn_multipath_relay_path(&spec->path[0]);
+}
+
+static void dtn_multipath_direct_only_spec(dtn_multipath_spec_t* spec)
+{
+    dtn_multipath_base_spec(spec);
+    spec->nb_paths = 1;
+    dtn_multipath_direct_path(&spec->path[0]);
+}
+
+static void dtn_multipath_test_spec(dtn_multipath_spec_t* spec)
+{
+    dtn_multipath_base_spec(spec);
+    spec->nb_paths = 2;
+    dtn_multipath_relay_path(&spec->path[0]);
+    dtn_multipath_direct_path(&spec->path[1]);
+}
+
+static void dtn_multipath_failover_test_spec(dtn_multipath_spec_t* spec)
+{
+    dtn_multipath_test_spec(spec);
+    spec->path[0].contact_plan = dtn_multipath_relay_failure;
+    spec->path[0].nb_contacts = sizeof(dtn_multipath_relay_failure) / sizeof(dtn_contact_t);
+}
+
+const dtn_multipath_case_t dtn_multipath_cases[] = {
+    { "dtn_multipath_relay_only", dtn_multipath_relay_only_spec },
+    { "dtn_multipath_direct_only", dtn_multipath_direct_only_spec },
+    { "dtn_multipath", dtn_multipath_test_spec },
+    { "dtn_multipath_failover", dtn_multipath_failover_test_spec }
+};
+
+const size_t dtn_nb_multipath_cases = sizeof(dtn_multipath_cases) / sizeof(dtn_multipath_case_t);
+
+int dtn_multipath_test()
+{
+    dtn_multipath_spec_t spec;
+    dtn_multipath_result_t result;
+    int ret;
+
+    dtn_multipath_test_spec(&spec);
+    ret = dtn_multipath_test_one(&spec, &result);
+    for (size_t i = 0; ret == 0 && i < spec.nb_paths; i++) {
+        /* Each path should carry a fair share of the object */
+        if (result.path_bytes_down[i] < spec.object_size / 10) {
+            DBG_PRINTF("Path %" PRIst " carried %" PRIu64 " bytes", i, result.path_bytes_down[i]);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* After the relay fails, the data lost on it is retransmitted on the
+ * direct path once the loss is detected, which takes a few RTT of the
+ * direct path. */
+#define DTN_MULTIPATH_MAX_STALL_RTT 4
+
+int dtn_multipath_failover_test()
+{
+    dtn_multipath_spec_t spec;
+    dtn_multipath_result_t result;
+    uint64_t max_stall;
+    int ret;
+
+    dtn_multipath_failover_test_spec(&spec);
+    max_stall = DTN_MULTIPATH_MAX_STALL_RTT * 2 * spec.path[1].latency;
+    ret = dtn_multipath_test_one(&spec, &result);
+    if (ret == 0 && result.failure_time == 0) {
+        DBG_PRINTF("%s", "The relay did not fail during the transfer");
+        ret = -1;
+    }
+    if (ret == 0) {
+        DBG_PRINTF("Relay failed at %" PRIu64 " us, failover stall %" PRIu64 " us",
+            result.failure_time, result.failover_stall);
+        if (result.bytes_received != spec.object_size || result.completion_time <= result.failure_time) {
+            DBG_PRINTF("Received %" PRIu64 " bytes at %" PRIu64 " us", result.bytes_received, result.completion_time);
+            ret = -1;
+        }
+        else if (result.failover_stall > max_stall) {
+            DBG_PRINTF("Failover stall above %" PRIu64 " us", max_stall);
+            ret = -1;
+        }
+    }
+    for (size_t i = 0; ret == 0 && i < spec.nb_paths; i++) {
+        if (result.path_bytes_down[i] == 0) {
+            DBG_PRINTF("No data on path %" PRIst, i);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Store and forward through a relay orbiter. The lander sees the orbiter
+ * for two short passes, the orbiter sees the Earth for a long window
+ * that only overlaps the second pass. The relay takes custody of the
+ * object during the first pass and forwards it when the Earth window
+ * opens. The direct connection only has the overlap of the two windows,
+ * too short for the handshake and the transfer at this latency. In the
+ * overlap case both hops are always up, which shows the cost of the
+ * relay when it is not needed.
+ */
+static const dtn_contact_t dtn_relay_lander_passes[] = {
+    { 0, 300000000, 1.0, 10.0, 20000 },
+    { 1800000000, 2100000000, 1.0, 10.0, 20000 }
+};
+
+static const dtn_contact_t dtn_relay_earth_window[] = {
+    { 600000000, 3600000000ull, 1.0, 10.0, 60000000 }
+};
+
+static void dtn_relay_base_spec(dtn_relay_spec_t* spec)
+{
+    memset(spec, 0, sizeof(dtn_relay_spec_t));
+    spec->max_completion_time = 4000000000ull;
+    spec->ccalgo = picoquic_newreno_algorithm;
+    spec->object_size = 20000000;
+    spec->hop[0].latency = 20000;
+    spec->hop[0].mbps_up = 1.0;
+    spec->hop[0].mbps_down = 10.0;
+    spec->hop[1].latency = 60000000;
+    spec->hop[1].mbps_up = 1.0;
+    spec->hop[1].mbps_down = 10.0;
+}
+
+static void dtn_relay_test_spec(dtn_relay_spec_t* spec)
+{
+    dtn_relay_base_spec(spec);
+    spec->hop[0].contact_plan = dtn_relay_lander_passes;
+    spec->hop[0].nb_contacts = sizeof(dtn_relay_lander_passes) / sizeof(dtn_contact_t);
+    spec->hop[1].contact_plan = dtn_relay_earth_window;
+    spec->hop[1].nb_contacts = sizeof(dtn_relay_earth_window) / sizeof(dtn_contact_t);
+}
+
+static void dtn_relay_direct_spec(dtn_relay_spec_t* spec)
+{
+    dtn_relay_test_spec(spec);
+    spec->is_direct = 1;
+}
+
+static void dtn_relay_overlap_spec(dtn_relay_spec_t* spec)
+{
+    dtn_relay_base_spec(spec);
+}
+
+static void dtn_relay_overlap_direct_spec(dtn_relay_spec_t* spec)
+{
+    dtn_relay_base_spec(spec);
+    spec->is_direct = 1;
+}
+
+const dtn_relay_case_t dtn_relay_cases[] = {
+    { "dtn_relay", dtn_relay_test_spec },
+    { "dtn_relay_direct", dtn_relay_direct_spec },
+    { "dtn_relay_overlap", dtn_relay_overlap_spec },
+    { "dtn_relay_overlap_direct", dtn_relay_overlap_direct_spec }
+};
+
+const size_t dtn_nb_relay_cases = sizeof(dtn_relay_cases) / sizeof(dtn_relay_case_t);
+
+int dtn_relay_test()
+{
+    dtn_relay_spec_t spec;
+    dtn_relay_result_t relay;
+    dtn_relay_result_t direct;
+    int ret;
+
+    dtn_relay_test_spec(&spec);
+    ret = dtn_relay_test_one(&spec, &relay);
+    if (ret == 0 && relay.custody_peak == 0) {
+        DBG_PRINTF("%s", "Nothing was held in custody by the relay");
+        ret = -1;
+    }
+    if (ret == 0) {
+        /* The direct connection is expected to fail, or at least to be slower */
+        dtn_relay_direct_spec(&spec);
+        if (dtn_relay_test_one(&spec, &direct) == 0 && direct.completion_time <= relay.completion_time) {
+            DBG_PRINTF("Direct delivery in %" PRIu64 " us, relay in %" PRIu64 " us",
+                direct.completion_time, relay.completion_time);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Two runs of the data transfer. The first one starts cold and saves the
+ * path state in the cache, which is written to a file and read back. The
+ * second run is seeded from the cache and skips most of the slow start,
+ * so its transfer should be shorter.
+ */
+#define DTN_WARM_CACHE_FILE "dtn_warm_path_cache.txt"
+
+int dtn_warm_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t cold;
+    dtn_test_result_t warm;
+    dtn_path_cache_t cache;
+    int ret;
+
+    memset(&cache, 0, sizeof(dtn_path_cache_t));
+    dtn_data_test_spec(&spec);
+    spec.path_cache = &cache;
+    ret = dtn_test_one_ex(0xca, 0, &spec, &cold);
+
+    if (ret == 0 && (!cache.state[0].is_valid || !cache.state[1].is_valid)) {
+        DBG_PRINTF("%s", "Path state not saved after the first run");
+        ret = -1;
+    }
+    if (ret == 0) {
+        ret = dtn_path_cache_write(&cache, DTN_WARM_CACHE_FILE);
+    }
+    if (ret == 0) {
+        ret = dtn_path_cache_read(&cache, DTN_WARM_CACHE_FILE);
+    }
+    if (ret == 0) {
+        ret = dtn_test_one_ex(0xca, 1, &spec, &warm);
+    }
+    if (ret == 0 && !warm.path_state_seeded) {
+        DBG_PRINTF("%s", "Second run was not seeded");
+        ret = -1;
+    }
+    if (ret == 0) {
+        if (warm.transfer_time >= cold.transfer_time) {
+            DBG_PRINTF("Seeded transfer takes %" PRIu64 " us, cold one %" PRIu64 " us",
+                warm.transfer_time, cold.transfer_time);
+            ret = -1;
+        }
+        else {
+            DBG_PRINTF("Seeding from the path cache saves %" PRIu64 " us of ramp up",
+                cold.transfer_time - warm.transfer_time);
+        }
+    }
+    (void)remove(DTN_WARM_CACHE_FILE);
+
+    return ret;
+}
+
+/* Transfer across two contact windows, separated by a 2 minutes
+ * occultation. The transfer starts after the handshake and the request,
+ * about 4 minutes into the first window, which closes before it ends.
+ * The latency is a bit longer in the second window, as the spacecraft
+ * moves away.
+ */
+static const dtn_contact_t dtn_contact_plan_two_windows[] = {
+    { 0, 300000000, 10, 10, 60000000 },
+    { 420000000, 1500000000, 10, 10, 65000000 }
+};
+
+static void dtn_contact_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_data_test_spec(spec);
+    spec->contact_plan = dtn_contact_plan_two_windows;
+    spec->nb_contacts = sizeof(dtn_contact_plan_two_windows) / sizeof(dtn_contact_t);
+    spec->max_completion_time = 1500000000;
+}
+
+int dtn_contact_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    int ret;
+
+    dtn_contact_test_spec(&spec);
+    ret = dtn_test_one_ex(0xc0, 0, &spec, &result);
+
+    if (ret == 0 && (result.nb_contacts_used != spec.nb_contacts ||
+        result.contact_usage[0].bytes_down == 0 || result.contact_usage[1].bytes_down == 0)) {
+        DBG_PRINTF("Expected data in %" PRIst " windows, got %" PRIst, spec.nb_contacts, result.nb_contacts_used);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Asymmetric links. The return link is often much slower than the
+ * forward link, and the ACKs sent by the client on the narrow uplink
+ * can limit the downlink throughput. The tests use a 10 MB download at
+ * 10 Mbps, with uplinks of 1 Mbps down to 10 kbps. The "thin" variant
+ * imposes an ACK gap of 32 packets and an ACK delay of 100 ms on the
+ * client, and the "noaf" variant does not negotiate the ACK frequency
+ * extension, so the client ACKs at the default rate.
+ */
+static test_api_stream_desc_t dtn_scenario_asym[] = {
+    { 4, 0, 257, 10000000 }
+};
+
+static void dtn_asym_spec(dtn_test_spec_t* spec, double ratio)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->scenario = dtn_scenario_asym;
+    spec->sizeof_scenario = sizeof(dtn_scenario_asym);
+    spec->mbps_up = spec->mbps_down / ratio;
+    spec->auto_flow_control = 1;
+    spec->max_completion_time = 1200000000;
+}
+
+static void dtn_asym_10_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_asym_spec(spec, 10.0);
+}
+
+static void dtn_asym_100_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_asym_spec(spec, 100.0);
+}
+
+static void dtn_asym_1000_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_asym_spec(spec, 1000.0);
+}
+
+static void dtn_asym_1000_noaf_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_asym_spec(spec, 1000.0);
+    spec->disable_ack_frequency = 1;
+}
+
+static void dtn_asym_1000_thin_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_asym_spec(spec, 1000.0);
+    spec->min_ack_gap = 32;
+    spec->min_ack_delay = 100000;
+}
+
+int dtn_asym_10_test()
+{
+    dtn_test_spec_t spec;
+    dtn_asym_10_test_spec(&spec);
+    return dtn_test_one(0xa1, &spec);
+}
+
+int dtn_asym_100_test()
+{
+    dtn_test_spec_t spec;
+    dtn_asym_100_test_spec(&spec);
+    return dtn_test_one(0xa2, &spec);
+}
+
+int dtn_asym_1000_test()
+{
+    dtn_test_spec_t spec;
+    dtn_asym_1000_test_spec(&spec);
+    return dtn_test_one(0xa3, &spec);
+}
+
+/* The variants of the 1000:1 test are compared to the default ACK
+ * policy, run as sequence 1. Thinning the ACKs should cost fewer
+ * packets and bytes on the uplink without losing goodput, and not
+ * negotiating the ACK frequency should cost more ACKs.
+ */
+#define DTN_ASYM_GOODPUT_TOLERANCE 0.95
+
+static int dtn_asym_1000_compare(uint8_t test_id, dtn_test_spec_t* spec, dtn_test_result_t* result,
+    dtn_test_result_t* reference)
+{
+    dtn_test_spec_t reference_spec;
+    int ret = dtn_test_one_ex(test_id, 0, spec, result);
+
+    if (ret == 0) {
+        dtn_asym_1000_test_spec(&reference_spec);
+        ret = dtn_test_one_ex(test_id, 1, &reference_spec, reference);
+    }
+    if (ret == 0) {
+        DBG_PRINTF("%" PRIu64 " ACKs, %" PRIu64 " bytes, %.6f Mbps; default %" PRIu64 " ACKs, %" PRIu64 " bytes, %.6f Mbps",
+            result->ack_packets, result->ack_bytes, result->goodput_mbps,
+            reference->ack_packets, reference->ack_bytes, reference->goodput_mbps);
+    }
+
+    return ret;
+}
+
+int dtn_asym_1000_noaf_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    dtn_test_result_t reference;
+    int ret;
+
+    dtn_asym_1000_noaf_test_spec(&spec);
+    ret = dtn_asym_1000_compare(0xa4, &spec, &result, &reference);
+    if (ret == 0 && result.ack_packets <= reference.ack_packets) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int dtn_asym_1000_thin_test()
+{
+    dtn_test_spec_t spec;
+    dtn_test_result_t result;
+    dtn_test_result_t reference;
+    int ret;
+
+    dtn_asym_1000_thin_test_spec(&spec);
+    ret = dtn_asym_1000_compare(0xa5, &spec, &result, &reference);
+    if (ret == 0 && (result.ack_packets >= reference.ack_packets || result.ack_bytes >= reference.ack_bytes ||
+        result.goodput_mbps < DTN_ASYM_GOODPUT_TOLERANCE * reference.goodput_mbps)) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Loss models. The tests download 10 MB at 10 Mbps with each of the
+ * loss models, so the benchmark shows how each model degrades the
+ * goodput and the completion time:
+ *  - bernoulli: 1% of packets lost,
+ *  - burst: Gilbert-Elliott model with bursts of about 10 packets,
+ *    half of them lost, about 0.5% loss on average,
+ *  - ber: bit error rate of 1e-6, about 1% loss for full size packets,
+ *  - blackout: all packets lost for 40 seconds while the server sends.
+ * The random models must lose some packets for the test to pass.
+ */
+static test_api_stream_desc_t dtn_scenario_loss[] = {
+    { 4, 0, 257, 10000000 }
+};
+
+static const dtn_blackout_t dtn_loss_blackouts[] = {
+    { 190000000, 230000000 }
+};
+
+static void dtn_loss_spec(dtn_test_spec_t* spec, dtn_loss_type_t type)
+{
+    dtn_set_basic_test_spec(spec);
+    spec->scenario = dtn_scenario_loss;
+    spec->sizeof_scenario = sizeof(dtn_scenario_loss);
+    spec->auto_flow_control = 1;
+    spec->max_completion_time = 1800000000;
+    spec->loss_model.type = type;
+    spec->loss_model.seed = 0xd7010550;
+}
+
+static void dtn_loss_bernoulli_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_spec(spec, dtn_loss_bernoulli);
+    spec->loss_model.loss_rate = 0.01;
+}
+
+static void dtn_loss_burst_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_spec(spec, dtn_loss_gilbert_elliott);
+    spec->loss_model.p_good_to_bad = 0.001;
+    spec->loss_model.p_bad_to_good = 0.1;
+    spec->loss_model.loss_good = 0;
+    spec->loss_model.loss_bad = 0.5;
+}
+
+static void dtn_loss_ber_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_spec(spec, dtn_loss_ber);
+    spec->loss_model.ber = 0.000001;
+}
+
+static void dtn_loss_blackout_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_spec(spec, dtn_loss_none);
+    spec->loss_model.blackouts = dtn_loss_blackouts;
+    spec->loss_model.nb_blackouts = sizeof(dtn_loss_blackouts) / sizeof(dtn_blackout_t);
+}
+
+/* The models lose about 1% of the packets. The drops are counted by the
+ * downlink itself, so that a link dropping packets that the model did not
+ * choose shows up as too many drops, and as a collapse of the goodput
+ * compared to the same transfer without losses, run as sequence 1.
+ */
+#define DTN_LOSS_MAX_DROP_RATIO 0.1
+#define DTN_LOSS_MIN_GOODPUT_SHARE 0.1
+
+static int dtn_loss_check(uint8_t test_id, dtn_test_spec_t* spec, int expect_drops, dtn_test_result_t const* result)
+{
+    dtn_test_spec_t lossless = *spec;
+    dtn_test_result_t reference;
+    uint64_t dropped = result->downlink_packets_dropped;
+    uint64_t nb_downlink = dropped + result->nb_packets_received;
+    int ret = 0;
+
+    if (expect_drops && dropped == 0) {
+        DBG_PRINTF("No loss in %" PRIu64 " packets", nb_downlink);
+        ret = -1;
+    }
+    else if (spec->loss_model.type != dtn_loss_none && (double)dropped > DTN_LOSS_MAX_DROP_RATIO * (double)nb_downlink) {
+        DBG_PRINTF("%" PRIu64 " packets dropped out of %" PRIu64, dropped, nb_downlink);
+        ret = -1;
+    }
+    else {
+        memset(&lossless.loss_model, 0, sizeof(dtn_loss_model_t));
+        memset(&lossless.fec, 0, sizeof(dtn_fec_t));
+        if ((ret = dtn_test_one_ex(test_id, 1, &lossless, &reference)) == 0 &&
+            result->goodput_mbps < DTN_LOSS_MIN_GOODPUT_SHARE * reference.goodput_mbps) {
+            DBG_PRINTF("Goodput %.6f Mbps with losses, %.6f Mbps without", result->goodput_mbps, reference.goodput_mbps);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_loss_test_one(uint8_t test_id, dtn_test_spec_t* spec)
+{
+    dtn_test_result_t result;
+    int ret = dtn_test_one_ex(test_id, 0, spec, &result);
+
+    if (ret == 0) {
+        ret = dtn_loss_check(test_id, spec, 1, &result);
+    }
+
+    return ret;
+}
+
+int dtn_loss_bernoulli_test()
+{
+    dtn_test_spec_t spec;
+    dtn_loss_bernoulli_test_spec(&spec);
+    return dtn_loss_test_one(0x1b, &spec);
+}
+
+int dtn_loss_burst_test()
+{
+    dtn_test_spec_t spec;
+    dtn_loss_burst_test_spec(&spec);
+    return dtn_loss_test_one(0x1c, &spec);
+}
+
+int dtn_loss_ber_test()
+{
+    dtn_test_spec_t spec;
+    dtn_loss_ber_test_spec(&spec);
+    return dtn_loss_test_one(0x1d, &spec);
+}
+
+int dtn_loss_blackout_test()
+{
+    dtn_test_spec_t spec;
+    dtn_loss_blackout_test_spec(&spec);
+    return dtn_loss_test_one(0x1e, &spec);
+}
+
+/* Forward error correction tests. Same transfers as the Bernoulli and burst
+ * loss tests, with 4 repair packets per block of 32 on the links. The
+ * decoder must recover some of the losses. The bench compares these runs
+ * with the loss tests, which only use retransmissions.
+ */
+static void dtn_fec_bernoulli_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_bernoulli_test_spec(spec);
+    spec->fec.redundancy = 0.125;
+    spec->fec.block_size = 32;
+}
+
+static void dtn_fec_burst_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_loss_burst_test_spec(spec);
+    spec->fec.redundancy = 0.125;
+    spec->fec.block_size = 32;
+}
+
+static int dtn_fec_test_one(uint8_t test_id, dtn_test_spec_t* spec)
+{
+    dtn_test_result_t result;
+    int ret = dtn_test_one_ex(test_id, 0, spec, &result);
+
+    if (ret == 0 && result.fec_recovered == 0) {
+        DBG_PRINTF("No loss recovered in %" PRIu64 " blocks", result.fec_blocks);
+        ret = -1;
+    }
+    if (ret == 0) {
+        /* The recovered packets are not dropped, the others are */
+        ret = dtn_loss_check(test_id, spec, 0, &result);
+    }
+
+    return ret;
+}
+
+int dtn_fec_bernoulli_test()
+{
+    dtn_test_spec_t spec;
+    dtn_fec_bernoulli_test_spec(&spec);
+    return dtn_fec_test_one(0xfb, &spec);
+}
+
+int dtn_fec_burst_test()
+{
+    dtn_test_spec_t spec;
+    dtn_fec_burst_test_spec(&spec);
+    return dtn_fec_test_one(0xfc, &spec);
+}
+
+/* Same transfer as the data test, with the rate based congestion control.
+ * Starting at the link rate removes the slow start, so the transfer
+ * should end about 80 seconds after the first response bytes arrive:
+ * 2 minutes of handshake, 2 minutes for request and response, plus
+ * the transfer time.
+ */
+static void dtn_cc_test_spec(dtn_test_spec_t* spec)
+{
+    dtn_data_test_spec(spec);
+    spec->ccalgo = dtn_cc_algorithm;
+    spec->max_completion_time = 360000000;
+}
+
+int dtn_cc_test()
+{
+    dtn_test_spec_t spec;
+    dtn_cc_test_spec(&spec);
+    return dtn_test_one(0xdc, &spec);
+}
+
+/* Table of the fixed test cases, used by the benchmark and other tools
+ * that need the specification of the tests rather than just the verdict.
+ */
+const dtn_test_case_t dtn_test_cases[] = {
+    { "dtn_basic", 0xba, dtn_basic_test_spec },
+    { "dtn_data", 0xda, dtn_data_test_spec },
+    { "dtn_object", 0x0b, dtn_object_test_spec },
+    { "dtn_object_resume", 0x0c, dtn_object_resume_test_spec },
+    { "dtn_object_resume_sync", 0x0d, dtn_object_resume_sync_spec },
+    { "dtn_mixed_fifo", 0x9f, dtn_mixed_fifo_test_spec },
+    { "dtn_mixed_round_robin", 0x9e, dtn_mixed_round_robin_test_spec },
+    { "dtn_mixed_urgent", 0x9d, dtn_mixed_urgent_test_spec },
+    { "dtn_silence", 0x51, dtn_silence_test_spec },
+    { "dtn_silence_hour", 0x52, dtn_silence_hour_test_spec },
+    { "dtn_silence_hour_default", 0x56, dtn_silence_hour_default_spec },
+    { "dtn_silence_day", 0x53, dtn_silence_day_test_spec },
+    { "dtn_silence_capped", 0x54, dtn_silence_capped_test_spec },
+    { "dtn_twenty", 0x20, dtn_twenty_test_spec },
+    { "dtn_twenty_event", 0x21, dtn_twenty_event_test_spec },
+    { "dtn_cc", 0xdc, dtn_cc_test_spec },
+    { "dtn_resume", 0x0e, dtn_resume_test_spec },
+    { "dtn_contact", 0xc0, dtn_contact_test_spec },
+    { "dtn_asym_10", 0xa1, dtn_asym_10_test_spec },
+    { "dtn_asym_100", 0xa2, dtn_asym_100_test_spec },
+    { "dtn_asym_1000", 0xa3, dtn_asym_1000_test_spec },
+    { "dtn_asym_1000_noaf", 0xa4, dtn_asym_1000_noaf_test_spec },
+    { "dtn_asym_1000_thin", 0xa5, dtn_asym_1000_thin_test_spec },
+    { "dtn_loss_bernoulli", 0x1b, dtn_loss_bernoulli_test_spec },
+    { "dtn_loss_burst", 0x1c, dtn_loss_burst_test_spec },
+    { "dtn_loss_ber", 0x1d, dtn_loss_ber_test_spec },
+    { "dtn_loss_blackout", 0x1e, dtn_loss_blackout_test_spec },
+    { "dtn_fec_bernoulli", 0xfb, dtn_fec_bernoulli_test_spec },
+    { "dtn_fec_burst", 0xfc, dtn_fec_burst_test_spec }
+};
+
+const size_t dtn_nb_test_cases = sizeof(dtn_test_cases) / sizeof(dtn_test_case_t);
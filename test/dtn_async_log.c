@@ -0,0 +1,243 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Batched, asynchronous writing of the binary logs.
+ *
+ * The binary log of a connection is written by picoquic to the stdio file
+ * "cnx->f_binlog", with one write per logged event. For long transfers,
+ * these small synchronous writes dominate the wall time of the simulation.
+ * Once the log file is opened, the harness replaces the file by a stream
+ * that copies the records into a large memory buffer. When the buffer is
+ * full, it is handed to a background thread that writes it to the real log
+ * file, while the simulation continues filling the other buffer. Closing
+ * the stream, which picoquic does when the connection is deleted, flushes
+ * the remaining data and closes the real file before returning, so the
+ * log is complete when picoquic converts it to qlog.
+ *
+ * Custom streams require fopencookie, which is only available with glibc.
+ * On other platforms, the logs are written directly by picoquic.
+ */
+
+#if !defined(_WINDOWS) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "delay_tolerant_internal.h"
+
+#if defined(__GLIBC__)
+#include <pthread.h>
+#include <sys/types.h>
+
+#define DTN_ASYNC_LOG_BUFFER_SIZE (1 << 20)
+#define DTN_ASYNC_LOG_STDIO_BUFFER_SIZE (1 << 16)
+
+typedef struct st_dtn_async_log_t {
+    FILE* F;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t* buffer[2];
+    size_t length[2];
+    int fill_index;
+    int flush_index;
+    int flush_pending;
+    int is_closing;
+    int write_error;
+} dtn_async_log_t;
+
+static void* dtn_async_log_thread(void* v_log)
+{
+    dtn_async_log_t* log = (dtn_async_log_t*)v_log;
+
+    pthread_mutex_lock(&log->lock);
+    for (;;) {
+        if (log->flush_pending) {
+            int i = log->flush_index;
+
+            pthread_mutex_unlock(&log->lock);
+            if (fwrite(log->buffer[i], 1, log->length[i], log->F) != log->length[i]) {
+                log->write_error = 1;
+            }
+            pthread_mutex_lock(&log->lock);
+            log->length[i] = 0;
+            log->flush_pending = 0;
+            pthread_cond_broadcast(&log->cond);
+        }
+        else if (log->is_closing) {
+            break;
+        }
+        else {
+            pthread_cond_wait(&log->cond, &log->lock);
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return NULL;
+}
+
+/* Hand the buffer being filled to the writer thread. Must be called with the lock held. */
+static void dtn_async_log_submit(dtn_async_log_t* log)
+{
+    while (log->flush_pending) {
+        pthread_cond_wait(&log->cond, &log->lock);
+    }
+    if (log->length[log->fill_index] > 0) {
+        log->flush_index = log->fill_index;
+        log->fill_index = 1 - log->fill_index;
+        log->flush_pending = 1;
+        pthread_cond_broadcast(&log->cond);
+    }
+}
+
+static ssize_t dtn_async_log_write(void* cookie, const char* buf, size_t size)
+{
+    dtn_async_log_t* log = (dtn_async_log_t*)cookie;
+    size_t written = 0;
+
+    pthread_mutex_lock(&log->lock);
+    while (written < size) {
+        int i = log->fill_index;
+        size_t room = DTN_ASYNC_LOG_BUFFER_SIZE - log->length[i];
+
+        if (room == 0) {
+            dtn_async_log_submit(log);
+        }
+        else {
+            size_t chunk = (size - written < room) ? size - written : room;
+            memcpy(log->buffer[i] + log->length[i], buf + written, chunk);
+            log->length[i] += chunk;
+            written += chunk;
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return (ssize_t)written;
+}
+
+static int dtn_async_log_close(void* cookie)
+{
+    dtn_async_log_t* log = (dtn_async_log_t*)cookie;
+    int ret;
+
+    pthread_mutex_lock(&log->lock);
+    dtn_async_log_submit(log);
+    while (log->flush_pending) {
+        pthread_cond_wait(&log->cond, &log->lock);
+    }
+    log->is_closing = 1;
+    pthread_cond_broadcast(&log->cond);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->thread, NULL);
+
+    ret = (fclose(log->F) == 0 && !log->write_error) ? 0 : EOF;
+    pthread_cond_destroy(&log->cond);
+    pthread_mutex_destroy(&log->lock);
+    free(log->buffer[0]);
+    free(log->buffer[1]);
+    free(log);
+
+    return ret;
+}
+
+static FILE* dtn_async_log_open(FILE* F)
+{
+    FILE* F_async = NULL;
+    dtn_async_log_t* log = (dtn_async_log_t*)calloc(1, sizeof(dtn_async_log_t));
+
+    if (log != NULL) {
+        log->F = F;
+        log->buffer[0] = (uint8_t*)malloc(DTN_ASYNC_LOG_BUFFER_SIZE);
+        log->buffer[1] = (uint8_t*)malloc(DTN_ASYNC_LOG_BUFFER_SIZE);
+        if (log->buffer[0] == NULL || log->buffer[1] == NULL) {
+            free(log->buffer[0]);
+            free(log->buffer[1]);
+            free(log);
+        }
+        else {
+            cookie_io_functions_t io_functions;
+
+            memset(&io_functions, 0, sizeof(io_functions));
+            io_functions.write = dtn_async_log_write;
+            io_functions.close = dtn_async_log_close;
+            pthread_mutex_init(&log->lock, NULL);
+            pthread_cond_init(&log->cond, NULL);
+
+            if (pthread_create(&log->thread, NULL, dtn_async_log_thread, log) != 0) {
+                pthread_cond_destroy(&log->cond);
+                pthread_mutex_destroy(&log->lock);
+                free(log->buffer[0]);
+                free(log->buffer[1]);
+                free(log);
+            }
+            else if ((F_async = fopencookie(log, "w", io_functions)) == NULL) {
+                /* Stop the thread without closing the original file */
+                pthread_mutex_lock(&log->lock);
+                log->is_closing = 1;
+                pthread_cond_broadcast(&log->cond);
+                pthread_mutex_unlock(&log->lock);
+                pthread_join(log->thread, NULL);
+                pthread_cond_destroy(&log->cond);
+                pthread_mutex_destroy(&log->lock);
+                free(log->buffer[0]);
+                free(log->buffer[1]);
+                free(log);
+            }
+            else {
+                (void)setvbuf(F_async, NULL, _IOFBF, DTN_ASYNC_LOG_STDIO_BUFFER_SIZE);
+            }
+        }
+    }
+
+    return F_async;
+}
+
+int dtn_async_log_attach(picoquic_cnx_t* cnx)
+{
+    int ret = 0;
+
+    if (cnx != NULL && cnx->f_binlog != NULL) {
+        FILE* F_async;
+
+        (void)fflush(cnx->f_binlog);
+        if ((F_async = dtn_async_log_open(cnx->f_binlog)) != NULL) {
+            cnx->f_binlog = F_async;
+        }
+        else {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+#else
+int dtn_async_log_attach(picoquic_cnx_t* cnx)
+{
+    /* Not supported on this platform, picoquic writes the log directly */
+    (void)cnx;
+    return 0;
+}
+#endif
@@ -0,0 +1,205 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Performance budgets of the DTN tests.
+ *
+ * The tests check that the transfers complete, but a picoquic update
+ * that makes them slower, or use more memory, would go unnoticed. Each
+ * fixed test case can have a budget in the baseline file: the maximum
+ * simulated completion time, the minimum goodput ratio, the maximum wall
+ * time and the maximum peak memory of either side. Once the baseline is
+ * loaded, dtn_test_one_ex checks the result of the first run of each case
+ * against its budget, and fails the test with a report of the exceeded
+ * limits.
+ *
+ * The baseline file is a text file with one line per test, holding the
+ * test name, then the completion time in microseconds, the goodput ratio,
+ * the wall time in microseconds and the memory in bytes. A value of 0
+ * is not checked. Lines starting with '#' are comments. The budgets are
+ * generated with "-G file", from the results of the current tree plus a
+ * margin, and can then be adjusted by hand.
+ *
+ * A baseline given explicitly with "-g file" must hold budgets, so that
+ * it does not silently check nothing. The default baseline is loaded if
+ * present; until its budgets are generated, it only holds comments and
+ * the budgets are not checked.
+ *
+ * The baseline is loaded before the tests start. It is only read by the
+ * tests, so it can be shared by the test threads.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "delay_tolerant_internal.h"
+
+static dtn_baseline_t dtn_baseline;
+
+static int dtn_baseline_test_id(char const* test_name, uint8_t* test_id)
+{
+    int ret = -1;
+
+    for (size_t i = 0; i < dtn_nb_test_cases; i++) {
+        if (strcmp(test_name, dtn_test_cases[i].test_name) == 0) {
+            *test_id = dtn_test_cases[i].test_id;
+            ret = 0;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+int dtn_baseline_load(char const* file_name, int is_required)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "r");
+
+    memset(&dtn_baseline, 0, sizeof(dtn_baseline_t));
+
+    if (F == NULL) {
+        DBG_PRINTF("Cannot open %s", file_name);
+        ret = -1;
+    }
+    else {
+        char line[256];
+        int line_number = 0;
+
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            dtn_budget_t budget;
+            char first[2];
+
+            line_number++;
+            if (sscanf(line, "%1s", first) != 1 || first[0] == '#') {
+                /* Empty line or comment */
+                continue;
+            }
+            memset(&budget, 0, sizeof(dtn_budget_t));
+            if (sscanf(line, "%63s %" SCNu64 " %lf %" SCNu64 " %" SCNu64, budget.test_name,
+                &budget.max_completion_time, &budget.min_goodput_ratio, &budget.max_wall_time,
+                &budget.max_memory) != 5 ||
+                dtn_baseline_test_id(budget.test_name, &budget.test_id) != 0 ||
+                dtn_baseline.nb_budgets >= DTN_BASELINE_MAX_BUDGETS) {
+                DBG_PRINTF("Invalid baseline line %d in %s", line_number, file_name);
+                ret = -1;
+            }
+            else {
+                dtn_baseline.budget[dtn_baseline.nb_budgets++] = budget;
+            }
+        }
+        (void)picoquic_file_close(F);
+        if (ret == 0 && dtn_baseline.nb_budgets == 0) {
+            if (is_required) {
+                /* An explicit baseline without budgets would silently disable the gate */
+                fprintf(stderr, "No performance budget in %s, generate them with \"-G %s\"\n", file_name, file_name);
+                ret = -1;
+            }
+            else {
+                fprintf(stdout, "No performance budget in %s, the budgets are not checked.\n", file_name);
+            }
+        }
+    }
+
+    if (ret != 0) {
+        dtn_baseline.nb_budgets = 0;
+    }
+
+    return ret;
+}
+
+void dtn_baseline_unload(void)
+{
+    memset(&dtn_baseline, 0, sizeof(dtn_baseline_t));
+}
+
+dtn_budget_t const* dtn_baseline_find(uint8_t test_id, uint16_t test_seq)
+{
+    dtn_budget_t const* budget = NULL;
+
+    /* Other runs of the same case use variants of the spec */
+    if (test_seq == 0) {
+        for (size_t i = 0; i < dtn_baseline.nb_budgets; i++) {
+            if (dtn_baseline.budget[i].test_id == test_id) {
+                budget = &dtn_baseline.budget[i];
+                break;
+            }
+        }
+    }
+
+    return budget;
+}
+
+uint64_t dtn_result_peak_memory(dtn_test_result_t const* result)
+{
+    size_t peak = result->client_memory.peak.total_bytes;
+
+    if (result->server_memory.peak.total_bytes > peak) {
+        peak = result->server_memory.peak.total_bytes;
+    }
+
+    return (uint64_t)peak;
+}
+
+static void dtn_baseline_report(char const* test_name, char const* metric, double value, double limit, char const* unit)
+{
+    double delta = (limit > 0) ? 100.0 * (value - limit) / limit : 0;
+
+    fprintf(stderr, "%s: %s %.3f %s, budget %.3f %s (%+.1f%%)\n", test_name, metric, value, unit, limit, unit, delta);
+}
+
+int dtn_budget_check(dtn_budget_t const* budget, dtn_test_result_t const* result)
+{
+    int ret = 0;
+
+    if (budget != NULL) {
+        uint64_t peak_memory = dtn_result_peak_memory(result);
+
+        if (budget->max_completion_time > 0 && result->completion_time > budget->max_completion_time) {
+            dtn_baseline_report(budget->test_name, "completion time", ((double)result->completion_time) / 1000000.0,
+                ((double)budget->max_completion_time) / 1000000.0, "s");
+            ret = -1;
+        }
+        if (budget->min_goodput_ratio > 0 && result->goodput_ratio < budget->min_goodput_ratio) {
+            dtn_baseline_report(budget->test_name, "goodput ratio", result->goodput_ratio,
+                budget->min_goodput_ratio, "");
+            ret = -1;
+        }
+        if (budget->max_wall_time > 0 && result->wall_time > budget->max_wall_time) {
+            dtn_baseline_report(budget->test_name, "wall time", ((double)result->wall_time) / 1000000.0,
+                ((double)budget->max_wall_time) / 1000000.0, "s");
+            ret = -1;
+        }
+        if (budget->max_memory > 0 && peak_memory > budget->max_memory) {
+            dtn_baseline_report(budget->test_name, "peak memory", (double)peak_memory,
+                (double)budget->max_memory, "bytes");
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int dtn_baseline_check(uint8_t test_id, uint16_t test_seq, dtn_test_result_t const* result)
+{
+    return dtn_budget_check(dtn_baseline_find(test_id, test_seq), result);
+}
@@ -0,0 +1,846 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Benchmark of the delay tolerant tests.
+ *
+ * The tests only report success or failure. The benchmark runs the same
+ * specifications and reports the metrics behind the verdict: completion
+ * time, split between handshake and transfer, goodput as a fraction of
+ * the link rate, retransmissions, overhead, and how much wall clock time
+ * the simulation needs per simulated second. The results are written in
+ * CSV, or in JSON if the file name ends with ".json", so that they can be
+ * compared between versions of picoquic.
+ *
+ * The benchmark also runs the data test with each of the congestion
+ * control algorithms in dtn_bench_cc, so the "dtn" algorithm can be
+ * compared with the classic ones. These runs are not bound by the packet
+ * count and completion time limits of the test, only the metrics matter.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+void dtn_result_csv_header(FILE* F)
+{
+    fprintf(F, "ret, completion_us, handshake_us, transfer_us, packets_sent, packets_received, retransmissions, ");
+    fprintf(F, "data_bytes, wire_bytes, goodput_mbps, goodput_ratio, overhead_ratio, wall_us, wall_per_sim_sec, ");
+    fprintf(F, "client_mem_peak, client_mem_avg, server_mem_peak, server_mem_avg, ");
+    fprintf(F, "server_mem_stream, server_mem_retransmit, server_mem_ack_ranges, ");
+    fprintf(F, "credit, credit_limit_mbps, credit_shortfall, ");
+    fprintf(F, "first_completion_us, completion_saved_us, zero_rtt_sent, zero_rtt_acked, ");
+    fprintf(F, "contacts_used, contact_usage_down, ");
+    fprintf(F, "ack_packets, ack_bytes, ack_rate, uplink_usage, acks_per_data_packet, ");
+    fprintf(F, "model_packets, model_losses, fec_blocks, fec_recovered, fec_repair_bytes, ");
+    fprintf(F, "idle_timeout, keep_alive, silence_packets, silence_packets_per_hour, ");
+    fprintf(F, "object_bytes, object_verified, process_mem_start, process_mem_peak, ");
+    fprintf(F, "urgent_first_byte_us, urgent_last_byte_us, bulk_last_byte_us, ");
+    fprintf(F, "resume_offset, resume_latency_us, bytes_resent, journal_records, journal_bytes, journal_write_us, ");
+    fprintf(F, "queue_peak_bytes, queue_average_bytes, queue_drops, burst_max, burst_average, burst_packet_ratio, pacing_error, ");
+    fprintf(F, "link_mtu, send_mtu, mtu_convergence_us, packets_per_mb");
+}
+
+/* Copy the fields of the CSV line, for the tools that keep many results */
+void dtn_result_row_set(dtn_result_row_t* row, dtn_test_result_t const* result)
+{
+    row->ret = result->ret;
+    row->completion_time = result->completion_time;
+    row->handshake_time = result->handshake_time;
+    row->transfer_time = result->transfer_time;
+    row->nb_packets_sent = result->nb_packets_sent;
+    row->nb_packets_received = result->nb_packets_received;
+    row->nb_retransmissions = result->nb_retransmissions;
+    row->data_bytes = result->data_bytes;
+    row->wire_bytes = result->wire_bytes;
+    row->goodput_mbps = result->goodput_mbps;
+    row->goodput_ratio = result->goodput_ratio;
+    row->overhead_ratio = result->overhead_ratio;
+    row->wall_time = result->wall_time;
+    row->wall_time_per_sim_sec = result->wall_time_per_sim_sec;
+    row->client_memory_peak = result->client_memory.peak.total_bytes;
+    row->client_memory_average = dtn_memory_stats_average(&result->client_memory);
+    row->server_memory_peak = result->server_memory.peak.total_bytes;
+    row->server_memory_average = dtn_memory_stats_average(&result->server_memory);
+    row->server_memory_stream = result->server_memory.peak.stream_bytes;
+    row->server_memory_retransmit = result->server_memory.peak.retransmit_bytes;
+    row->server_memory_ack_ranges = result->server_memory.peak.ack_range_bytes;
+    row->flow_control_credit = result->flow_control_credit;
+    row->credit_limit_mbps = result->credit_limit_mbps;
+    row->credit_shortfall = result->credit_shortfall;
+    row->first_completion_time = result->first_completion_time;
+    row->completion_time_saved = result->completion_time_saved;
+    row->nb_zero_rtt_sent = result->nb_zero_rtt_sent;
+    row->nb_zero_rtt_acked = result->nb_zero_rtt_acked;
+    row->nb_contacts_used = result->nb_contacts_used;
+    row->contact_usage_down = result->contact_usage_down;
+    row->ack_packets = result->ack_packets;
+    row->ack_bytes = result->ack_bytes;
+    row->ack_rate = result->ack_rate;
+    row->uplink_usage = result->uplink_usage;
+    row->acks_per_data_packet = result->acks_per_data_packet;
+    row->loss_model_packets = result->loss_model_packets;
+    row->loss_model_losses = result->loss_model_losses;
+    row->fec_blocks = result->fec_blocks;
+    row->fec_recovered = result->fec_recovered;
+    row->fec_repair_bytes = result->fec_repair_bytes;
+    row->idle_timeout = result->idle_timeout;
+    row->keep_alive_interval = result->keep_alive_interval;
+    row->silence_packets = result->silence_packets;
+    row->silence_packets_per_hour = result->silence_packets_per_hour;
+    row->object_bytes_received = result->object_bytes_received;
+    row->object_verified = result->object_verified;
+    row->process_memory_start = result->profile.process_memory_start;
+    row->process_memory_peak = result->profile.process_memory_peak;
+    row->urgent_first_byte_max = result->urgent_first_byte_max;
+    row->urgent_last_byte_max = result->urgent_last_byte_max;
+    row->bulk_last_byte_max = result->bulk_last_byte_max;
+    row->resume_offset = result->resume_offset;
+    row->resume_latency = result->resume_latency;
+    row->bytes_resent = result->bytes_resent;
+    row->journal_records = result->journal_records;
+    row->journal_bytes = result->journal_bytes;
+    row->journal_write_time = result->journal_write_time;
+    row->queue_peak_bytes = result->queue_peak_bytes;
+    row->queue_average_bytes = result->queue_average_bytes;
+    row->queue_drops = result->queue_drops;
+    row->burst_max = result->burst_max;
+    row->burst_average = result->burst_average;
+    row->burst_packet_ratio = result->burst_packet_ratio;
+    row->pacing_error = result->pacing_error;
+    row->link_mtu = result->link_mtu;
+    row->send_mtu = result->send_mtu;
+    row->mtu_convergence_time = result->mtu_convergence_time;
+    row->packets_per_mb = result->packets_per_mb;
+}
+
+void dtn_result_row_csv_line(FILE* F, dtn_result_row_t const* result)
+{
+    fprintf(F, "%d, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", ",
+        result->ret, result->completion_time, result->handshake_time, result->transfer_time,
+        result->nb_packets_sent, result->nb_packets_received, result->nb_retransmissions);
+    fprintf(F, "%" PRIu64 ", %" PRIu64 ", %.6f, %.6f, %.6f, %" PRIu64 ", %.6f, ",
+        result->data_bytes, result->wire_bytes, result->goodput_mbps, result->goodput_ratio,
+        result->overhead_ratio, result->wall_time, result->wall_time_per_sim_sec);
+    fprintf(F, "%" PRIst ", %" PRIst ", %" PRIst ", %" PRIst ", %" PRIst ", %" PRIst ", %" PRIst,
+        result->client_memory_peak, result->client_memory_average, result->server_memory_peak,
+        result->server_memory_average, result->server_memory_stream, result->server_memory_retransmit,
+        result->server_memory_ack_ranges);
+    fprintf(F, ", %" PRIu64 ", %.6f, %.6f", result->flow_control_credit, result->credit_limit_mbps, result->credit_shortfall);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64, result->first_completion_time,
+        result->completion_time_saved, result->nb_zero_rtt_sent, result->nb_zero_rtt_acked);
+    fprintf(F, ", %" PRIst ", %.6f", result->nb_contacts_used, result->contact_usage_down);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %.3f, %.6f, %.6f", result->ack_packets, result->ack_bytes,
+        result->ack_rate, result->uplink_usage, result->acks_per_data_packet);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64, result->loss_model_packets, result->loss_model_losses);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64, result->fec_blocks, result->fec_recovered, result->fec_repair_bytes);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %.3f", result->idle_timeout, result->keep_alive_interval,
+        result->silence_packets, result->silence_packets_per_hour);
+    fprintf(F, ", %" PRIu64 ", %d, %" PRIst ", %" PRIst, result->object_bytes_received, result->object_verified,
+        result->process_memory_start, result->process_memory_peak);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64, result->urgent_first_byte_max, result->urgent_last_byte_max,
+        result->bulk_last_byte_max);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64, result->resume_offset, result->resume_latency, result->bytes_resent);
+    fprintf(F, ", %" PRIu64 ", %" PRIu64 ", %" PRIu64, result->journal_records, result->journal_bytes,
+        result->journal_write_time);
+    fprintf(F, ", %" PRIu64 ", %.1f, %" PRIu64, result->queue_peak_bytes, result->queue_average_bytes, result->queue_drops);
+    fprintf(F, ", %" PRIu64 ", %.3f, %.6f, %.6f", result->burst_max, result->burst_average, result->burst_packet_ratio,
+        result->pacing_error);
+    fprintf(F, ", %" PRIst ", %" PRIst ", %" PRIu64 ", %.3f", result->link_mtu, result->send_mtu,
+        result->mtu_convergence_time, result->packets_per_mb);
+}
+
+void dtn_result_csv_line(FILE* F, dtn_test_result_t const* result)
+{
+    dtn_result_row_t row;
+
+    dtn_result_row_set(&row, result);
+    dtn_result_row_csv_line(F, &row);
+}
+
+void dtn_result_json(FILE* F, dtn_test_result_t const* result)
+{
+    fprintf(F, "\"ret\": %d, \"completion_us\": %" PRIu64 ", \"handshake_us\": %" PRIu64 ", \"transfer_us\": %" PRIu64 ", ",
+        result->ret, result->completion_time, result->handshake_time, result->transfer_time);
+    fprintf(F, "\"packets_sent\": %" PRIu64 ", \"packets_received\": %" PRIu64 ", \"retransmissions\": %" PRIu64 ", ",
+        result->nb_packets_sent, result->nb_packets_received, result->nb_retransmissions);
+    fprintf(F, "\"data_bytes\": %" PRIu64 ", \"wire_bytes\": %" PRIu64 ", \"goodput_mbps\": %.6f, \"goodput_ratio\": %.6f, ",
+        result->data_bytes, result->wire_bytes, result->goodput_mbps, result->goodput_ratio);
+    fprintf(F, "\"overhead_ratio\": %.6f, \"wall_us\": %" PRIu64 ", \"wall_per_sim_sec\": %.6f, ",
+        result->overhead_ratio, result->wall_time, result->wall_time_per_sim_sec);
+    fprintf(F, "\"client_mem_peak\": %" PRIst ", \"client_mem_avg\": %" PRIst ", ",
+        result->client_memory.peak.total_bytes, dtn_memory_stats_average(&result->client_memory));
+    fprintf(F, "\"server_mem_peak\": %" PRIst ", \"server_mem_avg\": %" PRIst ", ",
+        result->server_memory.peak.total_bytes, dtn_memory_stats_average(&result->server_memory));
+    fprintf(F, "\"server_mem_stream\": %" PRIst ", \"server_mem_retransmit\": %" PRIst ", \"server_mem_ack_ranges\": %" PRIst,
+        result->server_memory.peak.stream_bytes, result->server_memory.peak.retransmit_bytes,
+        result->server_memory.peak.ack_range_bytes);
+    fprintf(F, ", \"credit\": %" PRIu64 ", \"credit_limit_mbps\": %.6f, \"credit_shortfall\": %.6f",
+        result->flow_control_credit, result->credit_limit_mbps, result->credit_shortfall);
+    fprintf(F, ", \"first_completion_us\": %" PRIu64 ", \"completion_saved_us\": %" PRIu64 ", ",
+        result->first_completion_time, result->completion_time_saved);
+    fprintf(F, "\"zero_rtt_sent\": %" PRIu64 ", \"zero_rtt_acked\": %" PRIu64,
+        result->nb_zero_rtt_sent, result->nb_zero_rtt_acked);
+    fprintf(F, ", \"contact_usage_down\": %.6f, \"contacts\": [", result->contact_usage_down);
+    for (size_t i = 0; i < result->nb_contacts_used; i++) {
+        dtn_contact_usage_t const* usage = &result->contact_usage[i];
+        fprintf(F, "%s{ \"duration_us\": %" PRIu64 ", \"bytes_up\": %" PRIu64 ", \"bytes_down\": %" PRIu64,
+            (i == 0) ? "" : ", ", usage->duration, usage->bytes_up, usage->bytes_down);
+        fprintf(F, ", \"usage_up\": %.6f, \"usage_down\": %.6f }", usage->usage_up, usage->usage_down);
+    }
+    fprintf(F, "]");
+    fprintf(F, ", \"ack_packets\": %" PRIu64 ", \"ack_bytes\": %" PRIu64 ", \"ack_rate\": %.3f, ",
+        result->ack_packets, result->ack_bytes, result->ack_rate);
+    fprintf(F, "\"uplink_usage\": %.6f, \"acks_per_data_packet\": %.6f", result->uplink_usage, result->acks_per_data_packet);
+    fprintf(F, ", \"model_packets\": %" PRIu64 ", \"model_losses\": %" PRIu64, result->loss_model_packets, result->loss_model_losses);
+    fprintf(F, ", \"fec_blocks\": %" PRIu64 ", \"fec_recovered\": %" PRIu64 ", \"fec_repair_bytes\": %" PRIu64,
+        result->fec_blocks, result->fec_recovered, result->fec_repair_bytes);
+    fprintf(F, ", \"idle_timeout_us\": %" PRIu64 ", \"keep_alive_us\": %" PRIu64 ", ",
+        result->idle_timeout, result->keep_alive_interval);
+    fprintf(F, "\"silence_packets\": %" PRIu64 ", \"silence_packets_per_hour\": %.3f",
+        result->silence_packets, result->silence_packets_per_hour);
+    fprintf(F, ", \"object_bytes\": %" PRIu64 ", \"object_verified\": %d, ",
+        result->object_bytes_received, result->object_verified);
+    fprintf(F, "\"process_mem_start\": %" PRIst ", \"process_mem_peak\": %" PRIst,
+        result->profile.process_memory_start, result->profile.process_memory_peak);
+    fprintf(F, ", \"urgent_first_byte_us\": %" PRIu64 ", \"urgent_last_byte_us\": %" PRIu64 ", \"bulk_last_byte_us\": %" PRIu64,
+        result->urgent_first_byte_max, result->urgent_last_byte_max, result->bulk_last_byte_max);
+    fprintf(F, ", \"resume_offset\": %" PRIu64 ", \"resume_latency_us\": %" PRIu64 ", \"bytes_resent\": %" PRIu64,
+        result->resume_offset, result->resume_latency, result->bytes_resent);
+    fprintf(F, ", \"journal_records\": %" PRIu64 ", \"journal_bytes\": %" PRIu64 ", \"journal_write_us\": %" PRIu64,
+        result->journal_records, result->journal_bytes, result->journal_write_time);
+    fprintf(F, ", \"queue_peak_bytes\": %" PRIu64 ", \"queue_average_bytes\": %.1f, \"queue_drops\": %" PRIu64,
+        result->queue_peak_bytes, result->queue_average_bytes, result->queue_drops);
+    fprintf(F, ", \"burst_max\": %" PRIu64 ", \"burst_average\": %.3f, \"burst_packet_ratio\": %.6f, \"pacing_error\": %.6f",
+        result->burst_max, result->burst_average, result->burst_packet_ratio, result->pacing_error);
+    fprintf(F, ", \"link_mtu\": %" PRIst ", \"send_mtu\": %" PRIst ", \"mtu_convergence_us\": %" PRIu64 ", \"packets_per_mb\": %.3f",
+        result->link_mtu, result->send_mtu, result->mtu_convergence_time, result->packets_per_mb);
+    fprintf(F, ", \"streams\": [");
+    for (size_t i = 0; i < result->nb_stream_latencies; i++) {
+        dtn_stream_latency_t const* latency = &result->stream_latency[i];
+        fprintf(F, "%s{ \"id\": %" PRIu64 ", \"urgent\": %d, \"request_us\": %" PRIu64, (i == 0) ? "" : ", ",
+            latency->stream_id, latency->is_urgent, latency->request_time);
+        fprintf(F, ", \"first_byte_us\": %" PRIu64 ", \"last_byte_us\": %" PRIu64 " }",
+            latency->first_byte_time, latency->last_byte_time);
+    }
+    fprintf(F, "]");
+}
+
+/* Summary table of the simulation profile. The packet rate counts the
+ * packets sent by both client and server per second of wall clock time.
+ */
+void dtn_profile_table_header(FILE* F)
+{
+    fprintf(F, "%-16s %10s %10s %10s %10s %10s %10s %12s %12s %10s %10s\n",
+        "test", "rounds", "active", "jumps", "small", "max_jmp_s", "avg_jmp_ms",
+        "pkt/wall_s", "sim_s/wall_s", "hs_wall_ms", "tx_wall_ms");
+}
+
+void dtn_profile_table_line(FILE* F, char const* test_name, dtn_test_result_t const* result)
+{
+    dtn_sim_profile_t const* profile = &result->profile;
+    double avg_jump_ms = 0;
+    double packets_per_wall_sec = 0;
+    double sim_per_wall_sec = 0;
+
+    if (profile->nb_time_jumps > 0) {
+        avg_jump_ms = ((double)result->transfer_time) / (1000.0 * (double)profile->nb_time_jumps);
+    }
+    if (result->wall_time > 0) {
+        packets_per_wall_sec = ((double)(result->nb_packets_sent + result->nb_packets_received)) * 1000000.0 / (double)result->wall_time;
+        sim_per_wall_sec = ((double)result->completion_time) / (double)result->wall_time;
+    }
+    fprintf(F, "%-16s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10.3f %10.3f %12.1f %12.1f %10.1f %10.1f\n",
+        test_name, profile->nb_rounds, profile->nb_active_rounds, profile->nb_time_jumps, profile->nb_small_jumps,
+        ((double)profile->max_time_jump) / 1000000.0, avg_jump_ms, packets_per_wall_sec, sim_per_wall_sec,
+        ((double)profile->handshake_wall_time) / 1000.0, ((double)profile->transfer_wall_time) / 1000.0);
+}
+
+static char const* dtn_bench_cc[] = {
+    "newreno", "cubic", "bbr", "dtn"
+};
+
+#define DTN_BENCH_CC_TEST "dtn_data"
+#define DTN_BENCH_NB_CC (sizeof(dtn_bench_cc) / sizeof(char const*))
+#define DTN_BENCH_MAX_ROWS (dtn_nb_test_cases + DTN_BENCH_NB_CC)
+
+typedef struct st_dtn_bench_row_t {
+    char name[64];
+    size_t test_index;
+    uint16_t test_seq;
+    picoquic_congestion_algorithm_t const* ccalgo;
+} dtn_bench_row_t;
+
+typedef struct st_dtn_bench_ctx_t {
+    size_t nb_rows;
+    dtn_bench_row_t* rows;
+    dtn_test_result_t* results;
+} dtn_bench_ctx_t;
+
+/* One row per fixed test, plus the congestion control comparison if required */
+static int dtn_bench_init_ctx(dtn_bench_ctx_t* ctx, int with_cc_comparison)
+{
+    int ret = 0;
+
+    memset(ctx, 0, sizeof(dtn_bench_ctx_t));
+
+    if ((ctx->rows = (dtn_bench_row_t*)calloc(DTN_BENCH_MAX_ROWS, sizeof(dtn_bench_row_t))) == NULL ||
+        (ctx->results = (dtn_test_result_t*)calloc(DTN_BENCH_MAX_ROWS, sizeof(dtn_test_result_t))) == NULL) {
+        ret = -1;
+    }
+    else {
+        for (size_t i = 0; i < dtn_nb_test_cases; i++) {
+            dtn_bench_row_t* row = &ctx->rows[ctx->nb_rows++];
+            (void)picoquic_sprintf(row->name, sizeof(row->name), NULL, "%s", dtn_test_cases[i].test_name);
+            row->test_index = i;
+            if (with_cc_comparison && strcmp(dtn_test_cases[i].test_name, DTN_BENCH_CC_TEST) == 0) {
+                for (size_t j = 0; j < DTN_BENCH_NB_CC; j++) {
+                    picoquic_congestion_algorithm_t const* alg = dtn_get_congestion_algorithm(dtn_bench_cc[j]);
+                    if (alg != NULL) {
+                        dtn_bench_row_t* cc_row = &ctx->rows[ctx->nb_rows++];
+                        (void)picoquic_sprintf(cc_row->name, sizeof(cc_row->name), NULL, "%s/%s",
+                            DTN_BENCH_CC_TEST, dtn_bench_cc[j]);
+                        cc_row->test_index = i;
+                        cc_row->test_seq = (uint16_t)(j + 1);
+                        cc_row->ccalgo = alg;
+                    }
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+static void dtn_bench_release_ctx(dtn_bench_ctx_t* ctx)
+{
+    if (ctx->rows != NULL) {
+        free(ctx->rows);
+    }
+    if (ctx->results != NULL) {
+        free(ctx->results);
+    }
+    memset(ctx, 0, sizeof(dtn_bench_ctx_t));
+}
+
+static int dtn_bench_job(void* v_ctx, size_t i)
+{
+    dtn_bench_ctx_t* ctx = (dtn_bench_ctx_t*)v_ctx;
+    dtn_bench_row_t* row = &ctx->rows[i];
+    dtn_test_spec_t spec;
+
+    dtn_test_cases[row->test_index].set_spec(&spec);
+    if (row->ccalgo != NULL) {
+        spec.ccalgo = row->ccalgo;
+        spec.max_number_of_packets = 0;
+        spec.max_completion_time *= 4;
+    }
+
+    return dtn_test_one_ex(dtn_test_cases[row->test_index].test_id, row->test_seq, &spec, &ctx->results[i]);
+}
+
+static int dtn_bench_is_json(char const* file_name)
+{
+    size_t len = strlen(file_name);
+
+    return len > 5 && strcmp(file_name + len - 5, ".json") == 0;
+}
+
+static void dtn_bench_write(FILE* F, int is_json, dtn_bench_ctx_t const* ctx)
+{
+    if (is_json) {
+        fprintf(F, "{\n");
+#ifdef PICOQUIC_VERSION
+        fprintf(F, "  \"picoquic_version\": \"%s\",\n", PICOQUIC_VERSION);
+#endif
+        fprintf(F, "  \"tests\": [\n");
+        for (size_t i = 0; i < ctx->nb_rows; i++) {
+            fprintf(F, "    { \"test\": \"%s\", ", ctx->rows[i].name);
+            dtn_result_json(F, &ctx->results[i]);
+            fprintf(F, " }%s\n", (i + 1 < ctx->nb_rows) ? "," : "");
+        }
+        fprintf(F, "  ]\n}\n");
+    }
+    else {
+        fprintf(F, "test, ");
+        dtn_result_csv_header(F);
+        fprintf(F, "\n");
+        for (size_t i = 0; i < ctx->nb_rows; i++) {
+            fprintf(F, "%s, ", ctx->rows[i].name);
+            dtn_result_csv_line(F, &ctx->results[i]);
+            fprintf(F, "\n");
+        }
+    }
+}
+
+int dtn_profile(int nb_threads)
+{
+    int ret = 0;
+    dtn_bench_ctx_t ctx;
+
+    if (dtn_bench_init_ctx(&ctx, 0) != 0) {
+        fprintf(stderr, "Cannot allocate profile results\n");
+        ret = -1;
+    }
+    else {
+        ret = dtn_run_parallel(ctx.nb_rows, nb_threads, dtn_bench_job, &ctx);
+        dtn_profile_table_header(stdout);
+        for (size_t i = 0; i < ctx.nb_rows; i++) {
+            dtn_profile_table_line(stdout, ctx.rows[i].name, &ctx.results[i]);
+        }
+    }
+    dtn_bench_release_ctx(&ctx);
+
+    return ret;
+}
+
+/* Baseline of the performance budgets: the results of the fixed cases,
+ * with a margin. Wall times vary with the machine and the load, so their
+ * margin is larger. */
+int dtn_baseline_write(char const* file_name, int nb_threads)
+{
+    int ret = 0;
+    dtn_bench_ctx_t ctx;
+    FILE* F = NULL;
+
+    /* The budgets of a previous baseline do not apply */
+    dtn_baseline_unload();
+
+    if (dtn_bench_init_ctx(&ctx, 0) != 0) {
+        fprintf(stderr, "Cannot allocate baseline results\n");
+        ret = -1;
+    }
+    else if ((F = picoquic_file_open(file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        (void)dtn_run_parallel(ctx.nb_rows, nb_threads, dtn_bench_job, &ctx);
+        fprintf(F, "# Performance budgets of the DTN tests, see dtn_baseline.c\n");
+        fprintf(F, "# test completion_us goodput_ratio wall_us memory_bytes\n");
+        for (size_t i = 0; i < ctx.nb_rows; i++) {
+            dtn_test_result_t const* result = &ctx.results[i];
+
+            if (result->ret != 0) {
+                /* No budget for a failing test */
+                fprintf(stdout, "%s: fail, no budget\n", ctx.rows[i].name);
+                nb_failed++;
+                continue;
+            }
+            fprintf(F, "%s %" PRIu64 " %.4f %" PRIu64 " %" PRIu64 "\n", ctx.rows[i].name,
+                (uint64_t)(DTN_BASELINE_COMPLETION_MARGIN * (double)result->completion_time),
+                DTN_BASELINE_GOODPUT_MARGIN * result->goodput_ratio,
+                (uint64_t)(DTN_BASELINE_WALL_TIME_MARGIN * (double)result->wall_time),
+                (uint64_t)(DTN_BASELINE_MEMORY_MARGIN * (double)dtn_result_peak_memory(result)));
+        }
+        fprintf(stdout, "Baseline done, %d of %" PRIst " tests failed, budgets in %s\n",
+            nb_failed, ctx.nb_rows, file_name);
+        if (ferror(F) || nb_failed > 0) {
+            ret = -1;
+        }
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    dtn_bench_release_ctx(&ctx);
+
+    return ret;
+}
+
+int dtn_benchmark(char const* file_name, int nb_threads)
+{
+    int ret = 0;
+    dtn_bench_ctx_t ctx;
+    FILE* F = NULL;
+
+    if (dtn_bench_init_ctx(&ctx, 1) != 0) {
+        fprintf(stderr, "Cannot allocate benchmark results\n");
+        ret = -1;
+    }
+    else if ((F = picoquic_file_open(file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        ret = dtn_run_parallel(ctx.nb_rows, nb_threads, dtn_bench_job, &ctx);
+        dtn_bench_write(F, dtn_bench_is_json(file_name), &ctx);
+
+        for (size_t i = 0; i < ctx.nb_rows; i++) {
+            fprintf(stdout, "%s: %s, completion %.3f s, goodput %.3f Mbps (%.1f%% of link), wall time %.3f s, server memory peak %" PRIst " bytes\n",
+                ctx.rows[i].name, (ctx.results[i].ret == 0) ? "pass" : "fail",
+                ((double)ctx.results[i].completion_time) / 1000000.0, ctx.results[i].goodput_mbps,
+                100.0 * ctx.results[i].goodput_ratio, ((double)ctx.results[i].wall_time) / 1000000.0,
+                ctx.results[i].server_memory.peak.total_bytes);
+            if (ctx.results[i].ret != 0) {
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "Benchmark done, %d of %" PRIst " tests failed, results in %s\n",
+            nb_failed, ctx.nb_rows, file_name);
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    dtn_bench_release_ctx(&ctx);
+
+    return ret;
+}
+
+/* Large object benchmark. The downloads of 100 MB, 1 GB and 10 GB objects
+ * from memory mapped files run one after the other, so that the resident
+ * memory of the process only reflects one transfer. The memory should
+ * stay flat as the size grows, bounded by the data in flight.
+ */
+static const uint64_t dtn_object_bench_sizes[] = {
+    100000000ull, 1000000000ull, 10000000000ull
+};
+
+int dtn_object_benchmark(char const* file_name)
+{
+    int ret = 0;
+    size_t nb_sizes = sizeof(dtn_object_bench_sizes) / sizeof(uint64_t);
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "object_size, ");
+        dtn_result_csv_header(F);
+        fprintf(F, "\n");
+        for (size_t i = 0; i < nb_sizes; i++) {
+            dtn_test_spec_t spec;
+            dtn_test_result_t result;
+
+            dtn_set_object_test_spec(&spec, dtn_object_bench_sizes[i]);
+            (void)dtn_test_one_ex(0x0b, (uint16_t)(i + 1), &spec, &result);
+            fprintf(F, "%" PRIu64 ", ", dtn_object_bench_sizes[i]);
+            dtn_result_csv_line(F, &result);
+            fprintf(F, "\n");
+            fflush(F);
+            fprintf(stdout, "object %" PRIu64 ": %s, completion %.3f s, wall time %.3f s, server memory peak %" PRIst
+                " bytes, process memory %" PRIst " to %" PRIst " bytes\n",
+                dtn_object_bench_sizes[i], (result.ret == 0) ? "pass" : "fail",
+                ((double)result.completion_time) / 1000000.0, ((double)result.wall_time) / 1000000.0,
+                result.server_memory.peak.total_bytes, result.profile.process_memory_start,
+                result.profile.process_memory_peak);
+            fflush(stdout);
+            if (result.ret != 0) {
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "Object benchmark done, %d of %" PRIst " sizes failed, results in %s\n",
+            nb_failed, nb_sizes, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+/* Multipath benchmark: each single path alone, then the combined paths,
+ * then the failure of one path during the transfer. The daily volume is
+ * the volume that the goodput would carry in 24 hours of contact. */
+int dtn_multipath_benchmark(char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "test, ret, nb_paths, completion_us, bytes_received, goodput_mbps, daily_volume_gb, ");
+        for (int i = 0; i < DTN_MULTIPATH_MAX_PATHS; i++) {
+            fprintf(F, "path%d_bytes, path%d_lost, ", i, i);
+        }
+        fprintf(F, "failure_us, failover_stall_us, wall_us\n");
+        for (size_t i = 0; i < dtn_nb_multipath_cases; i++) {
+            dtn_multipath_spec_t spec;
+            dtn_multipath_result_t result;
+            double daily_volume_gb;
+
+            dtn_multipath_cases[i].set_spec(&spec);
+            (void)dtn_multipath_test_one(&spec, &result);
+            daily_volume_gb = result.goodput_mbps * 86400.0 / 8000.0;
+            fprintf(F, "%s, %d, %" PRIst ", %" PRIu64 ", %" PRIu64 ", %f, %f, ", dtn_multipath_cases[i].test_name,
+                result.ret, spec.nb_paths, result.completion_time, result.bytes_received, result.goodput_mbps, daily_volume_gb);
+            for (int j = 0; j < DTN_MULTIPATH_MAX_PATHS; j++) {
+                fprintf(F, "%" PRIu64 ", %" PRIu64 ", ", result.path_bytes_down[j], result.path_packets_lost[j]);
+            }
+            fprintf(F, "%" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n", result.failure_time, result.failover_stall, result.wall_time);
+            fflush(F);
+            fprintf(stdout, "%s: %s, completion %.3f s, goodput %.3f Mbps, %.1f GB per day\n",
+                dtn_multipath_cases[i].test_name, (result.ret == 0) ? "pass" : "fail",
+                ((double)result.completion_time) / 1000000.0, result.goodput_mbps, daily_volume_gb);
+            fflush(stdout);
+            if (result.ret != 0) {
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "Multipath benchmark done, %d of %" PRIst " cases failed, results in %s\n",
+            nb_failed, dtn_nb_multipath_cases, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+/* Relay benchmark: store and forward through the relay, against one
+ * direct connection over both hops, for each geometry. */
+int dtn_relay_benchmark(char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "test, ret, direct, completion_us, first_byte_us, bytes_received, custody_peak, ");
+        fprintf(F, "hop0_bytes, hop0_usage, hop1_bytes, hop1_usage, wall_us\n");
+        for (size_t i = 0; i < dtn_nb_relay_cases; i++) {
+            dtn_relay_spec_t spec;
+            dtn_relay_result_t result;
+
+            dtn_relay_cases[i].set_spec(&spec);
+            (void)dtn_relay_test_one(&spec, &result);
+            fprintf(F, "%s, %d, %d, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", ", dtn_relay_cases[i].test_name,
+                result.ret, spec.is_direct, result.completion_time, result.first_byte_time, result.bytes_received,
+                result.custody_peak);
+            fprintf(F, "%" PRIu64 ", %f, %" PRIu64 ", %f, %" PRIu64 "\n", result.hop_bytes_down[0], result.hop_usage_down[0],
+                result.hop_bytes_down[1], result.hop_usage_down[1], result.wall_time);
+            fflush(F);
+            fprintf(stdout, "%s: %s, delivery %.3f s, usage %.3f and %.3f\n",
+                dtn_relay_cases[i].test_name, (result.ret == 0) ? "pass" : "fail",
+                ((double)result.completion_time) / 1000000.0, result.hop_usage_down[0], result.hop_usage_down[1]);
+            fflush(stdout);
+            if (result.ret != 0) {
+                nb_failed++;
+            }
+        }
+        /* The direct connections may fail by design, the count is for information */
+        fprintf(stdout, "Relay benchmark done, %d of %" PRIst " cases failed, results in %s\n",
+            nb_failed, dtn_nb_relay_cases, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+/* Latency benchmark: the basic exchange with latencies from 1 second to
+ * 1 hour, with the test rounds and with the event driven rounds. With the
+ * event driven rounds, the wall time should stay about the same as the
+ * latency grows. */
+static const uint64_t dtn_latency_bench_values[] = {
+    1000000ull, 10000000ull, 60000000ull, 600000000ull, 1200000000ull, 2400000000ull, 3600000000ull
+};
+
+int dtn_latency_benchmark(char const* file_name)
+{
+    int ret = 0;
+    size_t nb_latencies = sizeof(dtn_latency_bench_values) / sizeof(uint64_t);
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "latency_us, event_loop, ret, completion_us, wall_us, rounds, jumps, small_jumps\n");
+        for (size_t i = 0; i < nb_latencies; i++) {
+            for (int event_loop = 0; event_loop <= 1; event_loop++) {
+                dtn_test_spec_t spec;
+                dtn_test_result_t result;
+
+                dtn_set_basic_test_spec(&spec);
+                spec.latency = dtn_latency_bench_values[i];
+                spec.max_completion_time = 8 * spec.latency;
+                spec.event_loop = event_loop;
+                spec.log_level = dtn_log_off;
+                (void)dtn_test_one_ex(0xe1, (uint16_t)(2 * i + event_loop), &spec, &result);
+                fprintf(F, "%" PRIu64 ", %d, %d, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n",
+                    spec.latency, event_loop, result.ret, result.completion_time, result.wall_time,
+                    result.profile.nb_rounds, result.profile.nb_time_jumps, result.profile.nb_small_jumps);
+                fflush(F);
+                fprintf(stdout, "latency %.0f s, %s: %s, completion %.3f s, wall time %.3f s, %" PRIu64 " rounds\n",
+                    ((double)spec.latency) / 1000000.0, (event_loop) ? "events" : "rounds",
+                    (result.ret == 0) ? "pass" : "fail", ((double)result.completion_time) / 1000000.0,
+                    ((double)result.wall_time) / 1000000.0, result.profile.nb_rounds);
+                fflush(stdout);
+                if (result.ret != 0) {
+                    nb_failed++;
+                }
+            }
+        }
+        fprintf(stdout, "Latency benchmark done, %d of %" PRIst " runs failed, results in %s\n",
+            nb_failed, 2 * nb_latencies, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+/* Queue benchmark: the 100 MB download with a 100 MB credit, for each
+ * congestion control, without buffer limit, then through a 1 MB buffer
+ * with tail drop and with RED. The bursts and the pacing error show
+ * whether the traffic is smooth enough for the modems. */
+#define DTN_QUEUE_BENCH_BUFFER 1000000
+
+typedef struct st_dtn_queue_bench_buffer_t {
+    uint64_t bottleneck_buffer;
+    dtn_queue_policy_t queue_policy;
+    char const* name;
+} dtn_queue_bench_buffer_t;
+
+static const dtn_queue_bench_buffer_t dtn_queue_bench_buffers[] = {
+    { 0, dtn_queue_tail_drop, "unlimited" },
+    { DTN_QUEUE_BENCH_BUFFER, dtn_queue_tail_drop, "tail_drop" },
+    { DTN_QUEUE_BENCH_BUFFER, dtn_queue_red, "red" }
+};
+
+int dtn_queue_benchmark(char const* file_name)
+{
+    int ret = 0;
+    size_t nb_buffers = sizeof(dtn_queue_bench_buffers) / sizeof(dtn_queue_bench_buffer_t);
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+        int nb_runs = 0;
+
+        fprintf(F, "cc, buffer, policy, ret, completion_us, goodput_mbps, queue_peak_bytes, queue_average_bytes, ");
+        fprintf(F, "queue_drops, burst_max, burst_average, burst_packet_ratio, pacing_error, wall_us\n");
+        for (size_t i = 0; i < DTN_BENCH_NB_CC; i++) {
+            picoquic_congestion_algorithm_t const* alg = dtn_get_congestion_algorithm(dtn_bench_cc[i]);
+
+            if (alg == NULL) {
+                continue;
+            }
+            for (size_t j = 0; j < nb_buffers; j++) {
+                dtn_queue_bench_buffer_t const* buffer = &dtn_queue_bench_buffers[j];
+                dtn_test_spec_t spec;
+                dtn_test_result_t result;
+
+                dtn_set_queue_test_spec(&spec, alg, buffer->bottleneck_buffer, buffer->queue_policy);
+                spec.log_level = dtn_log_off;
+                (void)dtn_test_one_ex(0x9c, (uint16_t)(i * nb_buffers + j + 1), &spec, &result);
+                fprintf(F, "%s, %" PRIu64 ", %s, %d, %" PRIu64 ", %f, %" PRIu64 ", %f, ", dtn_bench_cc[i],
+                    buffer->bottleneck_buffer, buffer->name, result.ret, result.completion_time, result.goodput_mbps,
+                    result.queue_peak_bytes, result.queue_average_bytes);
+                fprintf(F, "%" PRIu64 ", %" PRIu64 ", %f, %f, %f, %" PRIu64 "\n", result.queue_drops, result.burst_max,
+                    result.burst_average, result.burst_packet_ratio, result.pacing_error, result.wall_time);
+                fflush(F);
+                fprintf(stdout, "%s, %s: %s, completion %.3f s, queue peak %" PRIu64 " bytes, %" PRIu64
+                    " drops, bursts up to %" PRIu64 " packets, pacing error %.1f%%\n",
+                    dtn_bench_cc[i], buffer->name, (result.ret == 0) ? "pass" : "fail",
+                    ((double)result.completion_time) / 1000000.0, result.queue_peak_bytes, result.queue_drops,
+                    result.burst_max, 100.0 * result.pacing_error);
+                fflush(stdout);
+                nb_runs++;
+                if (result.ret != 0) {
+                    nb_failed++;
+                }
+            }
+        }
+        fprintf(stdout, "Queue benchmark done, %d of %d runs failed, results in %s\n",
+            nb_failed, nb_runs, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+/* MTU benchmark: the 100 MB download with path MTU discovery, then with
+ * link MTUs from the minimum to jumbo frames. The sizes above the packet
+ * buffers of picoquic are capped, see dtn_mtu.c. */
+static const size_t dtn_mtu_bench_sizes[] = {
+    0, 1200, 1280, 1440, 1500, PICOQUIC_MAX_PACKET_SIZE, 9000
+};
+
+int dtn_mtu_benchmark(char const* file_name)
+{
+    int ret = 0;
+    size_t nb_sizes = sizeof(dtn_mtu_bench_sizes) / sizeof(size_t);
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "link_mtu, effective_mtu, ret, completion_us, goodput_mbps, goodput_ratio, overhead_ratio, ");
+        fprintf(F, "packets_per_mb, send_mtu, mtu_convergence_us, wall_us\n");
+        for (size_t i = 0; i < nb_sizes; i++) {
+            dtn_test_spec_t spec;
+            dtn_test_result_t result;
+
+            dtn_set_mtu_test_spec(&spec, dtn_mtu_bench_sizes[i]);
+            spec.log_level = dtn_log_off;
+            (void)dtn_test_one_ex(0x3b, (uint16_t)(i + 1), &spec, &result);
+            fprintf(F, "%" PRIst ", %" PRIst ", %d, %" PRIu64 ", %f, %f, %f, ", dtn_mtu_bench_sizes[i],
+                dtn_mtu_effective(dtn_mtu_bench_sizes[i]), result.ret, result.completion_time, result.goodput_mbps,
+                result.goodput_ratio, result.overhead_ratio);
+            fprintf(F, "%f, %" PRIst ", %" PRIu64 ", %" PRIu64 "\n", result.packets_per_mb, result.send_mtu,
+                result.mtu_convergence_time, result.wall_time);
+            fflush(F);
+            fprintf(stdout, "MTU %" PRIst ": %s, completion %.3f s, goodput %.3f Mbps, %.1f packets per MB, send MTU %" PRIst
+                " after %.3f s\n", dtn_mtu_bench_sizes[i], (result.ret == 0) ? "pass" : "fail",
+                ((double)result.completion_time) / 1000000.0, result.goodput_mbps, result.packets_per_mb,
+                result.send_mtu, ((double)result.mtu_convergence_time) / 1000000.0);
+            fflush(stdout);
+            if (result.ret != 0) {
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "MTU benchmark done, %d of %" PRIst " sizes failed, results in %s\n",
+            nb_failed, nb_sizes, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
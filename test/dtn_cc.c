@@ -0,0 +1,251 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Congestion control for scheduled deep space links.
+ *
+ * The classic algorithms probe the path: slow start doubles the window
+ * once per RTT, which with a 2 minutes RTT wastes many minutes of a
+ * contact before the link is used. On a scheduled link, the rate is
+ * known in advance. The "dtn" algorithm starts directly at that rate,
+ * or at a fraction of it, and paces packets at that rate instead of
+ * probing. The window is set to the bandwidth delay product, with a
+ * margin, so that the pacing and not the window limits the sender.
+ *
+ * Losses on these links come from corruption rather than congestion,
+ * so they do not reduce the rate. ECN marks are the only congestion
+ * signal: each CE event reduces the rate by 1/8, down to a floor of
+ * 1/4 of the configured rate.
+ *
+ * The algorithm API does not carry parameters, so the link rates are
+ * registered per QUIC context with dtn_cc_set_link_rate(), before the
+ * connections start. Contexts that are not registered use a rate of
+ * DTN_CC_DEFAULT_MBPS.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WINDOWS
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_CC_ID "dtn"
+#define DTN_CC_ALGO_NUMBER 0xd7
+#define DTN_CC_DEFAULT_MBPS 1.0
+#define DTN_CC_MAX_CONTEXTS 256
+#define DTN_CC_WINDOW_MARGIN 2
+
+typedef struct st_dtn_cc_rate_t {
+    picoquic_quic_t* quic;
+    double bytes_per_second;
+} dtn_cc_rate_t;
+
+/* The simulations run in parallel threads, hence the lock on the table.
+ * The lock is statically initialized, since any thread may be first. */
+static dtn_cc_rate_t dtn_cc_rates[DTN_CC_MAX_CONTEXTS];
+#ifdef _WINDOWS
+static SRWLOCK dtn_cc_rate_lock = SRWLOCK_INIT;
+#define dtn_cc_lock() AcquireSRWLockExclusive(&dtn_cc_rate_lock)
+#define dtn_cc_unlock() ReleaseSRWLockExclusive(&dtn_cc_rate_lock)
+#else
+static pthread_mutex_t dtn_cc_rate_lock = PTHREAD_MUTEX_INITIALIZER;
+#define dtn_cc_lock() pthread_mutex_lock(&dtn_cc_rate_lock)
+#define dtn_cc_unlock() pthread_mutex_unlock(&dtn_cc_rate_lock)
+#endif
+
+typedef struct st_dtn_cc_state_t {
+    double configured_rate;
+    double rate;
+    uint64_t nb_ce_events;
+    uint64_t bytes_lost;
+} dtn_cc_state_t;
+
+int dtn_cc_set_link_rate(picoquic_quic_t* quic, double mbps, double fraction)
+{
+    int ret = -1;
+    int free_index = -1;
+
+    if (fraction <= 0 || fraction > 1.0) {
+        fraction = 1.0;
+    }
+
+    dtn_cc_lock();
+    for (int i = 0; i < DTN_CC_MAX_CONTEXTS; i++) {
+        if (dtn_cc_rates[i].quic == quic) {
+            free_index = i;
+            break;
+        }
+        else if (dtn_cc_rates[i].quic == NULL && free_index < 0) {
+            free_index = i;
+        }
+    }
+    if (free_index >= 0) {
+        dtn_cc_rates[free_index].quic = quic;
+        dtn_cc_rates[free_index].bytes_per_second = fraction * mbps * 1000000.0 / 8.0;
+        ret = 0;
+    }
+    dtn_cc_unlock();
+
+    return ret;
+}
+
+void dtn_cc_clear_link_rate(picoquic_quic_t* quic)
+{
+    dtn_cc_lock();
+    for (int i = 0; i < DTN_CC_MAX_CONTEXTS; i++) {
+        if (dtn_cc_rates[i].quic == quic) {
+            dtn_cc_rates[i].quic = NULL;
+        }
+    }
+    dtn_cc_unlock();
+}
+
+static double dtn_cc_get_link_rate(picoquic_quic_t* quic)
+{
+    double rate = DTN_CC_DEFAULT_MBPS * 1000000.0 / 8.0;
+
+    dtn_cc_lock();
+    for (int i = 0; i < DTN_CC_MAX_CONTEXTS; i++) {
+        if (dtn_cc_rates[i].quic == quic) {
+            rate = dtn_cc_rates[i].bytes_per_second;
+            break;
+        }
+    }
+    dtn_cc_unlock();
+
+    return rate;
+}
+
+/* Window of one bandwidth delay product times the margin, using the
+ * highest RTT estimate so that the window never limits the pacing.
+ */
+static void dtn_cc_update(picoquic_cnx_t* cnx, picoquic_path_t* path_x, dtn_cc_state_t* state)
+{
+    uint64_t rtt = (path_x->smoothed_rtt > path_x->rtt_min) ? path_x->smoothed_rtt : path_x->rtt_min;
+    double cwin = DTN_CC_WINDOW_MARGIN * state->rate * ((double)rtt) / 1000000.0;
+    uint64_t quantum = 4 * path_x->send_mtu;
+
+    path_x->cwin = (cwin > (double)PICOQUIC_CWIN_INITIAL) ? (uint64_t)cwin : PICOQUIC_CWIN_INITIAL;
+    picoquic_update_pacing_rate(cnx, path_x, state->rate, quantum);
+    path_x->is_cc_data_updated = 1;
+}
+
+static void dtn_cc_init(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint64_t current_time)
+{
+    dtn_cc_state_t* state = (dtn_cc_state_t*)malloc(sizeof(dtn_cc_state_t));
+
+    path_x->congestion_alg_state = (void*)state;
+    if (state != NULL) {
+        memset(state, 0, sizeof(dtn_cc_state_t));
+        state->configured_rate = dtn_cc_get_link_rate(cnx->quic);
+        state->rate = state->configured_rate;
+        dtn_cc_update(cnx, path_x, state);
+    }
+    (void)current_time;
+}
+
+static void dtn_cc_notify(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_congestion_notification_t notification, picoquic_per_ack_state_t* ack_state, uint64_t current_time)
+{
+    dtn_cc_state_t* state = (dtn_cc_state_t*)path_x->congestion_alg_state;
+
+    (void)current_time;
+
+    if (state != NULL) {
+        switch (notification) {
+        case picoquic_congestion_notification_repeat:
+        case picoquic_congestion_notification_timeout:
+            /* Corruption, not congestion: keep the rate */
+            if (ack_state != NULL) {
+                state->bytes_lost += ack_state->nb_bytes_newly_lost;
+            }
+            break;
+        case picoquic_congestion_notification_ecn_ec:
+            state->nb_ce_events++;
+            state->rate -= state->rate / 8.0;
+            if (state->rate < state->configured_rate / 4.0) {
+                state->rate = state->configured_rate / 4.0;
+            }
+            dtn_cc_update(cnx, path_x, state);
+            break;
+        case picoquic_congestion_notification_rtt_measurement:
+        case picoquic_congestion_notification_acknowledgement:
+            /* Track the RTT in the window size */
+            dtn_cc_update(cnx, path_x, state);
+            break;
+        case picoquic_congestion_notification_reset:
+            state->rate = state->configured_rate;
+            dtn_cc_update(cnx, path_x, state);
+            break;
+        default:
+            /* Spurious repeats, bandwidth measurements, seeds and blocked
+             * windows do not change a rate that is known in advance */
+            break;
+        }
+    }
+}
+
+static void dtn_cc_delete(picoquic_path_t* path_x)
+{
+    if (path_x->congestion_alg_state != NULL) {
+        free(path_x->congestion_alg_state);
+        path_x->congestion_alg_state = NULL;
+    }
+}
+
+static void dtn_cc_observe(picoquic_path_t* path_x, uint64_t* cc_state, uint64_t* cc_param)
+{
+    dtn_cc_state_t* state = (dtn_cc_state_t*)path_x->congestion_alg_state;
+
+    *cc_state = 0;
+    *cc_param = (state == NULL) ? 0 : (uint64_t)state->rate;
+}
+
+static picoquic_congestion_algorithm_t dtn_cc_algorithm_struct = {
+    DTN_CC_ID, DTN_CC_ALGO_NUMBER,
+    dtn_cc_init,
+    dtn_cc_notify,
+    dtn_cc_delete,
+    dtn_cc_observe
+};
+
+picoquic_congestion_algorithm_t const* dtn_cc_algorithm = &dtn_cc_algorithm_struct;
+
+/* Same as picoquic_get_congestion_algorithm, plus the "dtn" algorithm */
+picoquic_congestion_algorithm_t const* dtn_get_congestion_algorithm(char const* alg_name)
+{
+    picoquic_congestion_algorithm_t const* alg = NULL;
+
+    if (alg_name != NULL && strcmp(alg_name, DTN_CC_ID) == 0) {
+        alg = dtn_cc_algorithm;
+    }
+    else {
+        alg = picoquic_get_congestion_algorithm(alg_name);
+    }
+
+    return alg;
+}
@@ -0,0 +1,174 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Contact plans.
+ *
+ * Deep space links are not always up. The antennas of the ground
+ * station are scheduled, the planets occult the spacecraft, and the
+ * latency changes as the orbits move. The contact plan of a test spec
+ * describes the windows in which the link is up, with the rate and
+ * latency of each window. The simulation follows the plan by setting
+ * the rate and latency of the simulated links at the start of each
+ * window, and by losing all the packets sent while the link is down.
+ * The links apply the latency when the packets are submitted, so the
+ * packets already in flight keep the latency of the window in which
+ * they were sent.
+ *
+ * The rounds of the simulation stop at each window boundary, so the
+ * changes happen at the planned time. For each window, we count the
+ * bytes sent by the client and the server while the window is up, and
+ * compare that to the capacity of the window, up to the end of the
+ * transfer.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+static uint64_t dtn_contact_bytes_sent(picoquic_cnx_t* cnx)
+{
+    uint64_t bytes_sent = 0;
+
+    if (cnx != NULL) {
+        picoquic_path_quality_t quality;
+
+        picoquic_get_default_path_quality(cnx, &quality);
+        bytes_sent = quality.bytes_sent;
+    }
+
+    return bytes_sent;
+}
+
+void dtn_contact_start(dtn_contact_state_t* state, dtn_test_spec_t const* spec, uint64_t* loss_mask,
+    dtn_test_result_t* result)
+{
+    memset(state, 0, sizeof(dtn_contact_state_t));
+    state->spec = spec;
+    state->loss_mask = loss_mask;
+    state->down_mask = UINT64_MAX;
+    state->result = result;
+    if (result != NULL) {
+        result->nb_contacts_used = 0;
+        result->contact_usage_down = 0;
+        memset(result->contact_usage, 0, sizeof(result->contact_usage));
+    }
+}
+
+/* Close the accounting of the current window */
+static void dtn_contact_close_window(dtn_contact_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    if (state->is_up && state->result != NULL && state->current < DTN_MAX_CONTACTS) {
+        dtn_contact_t const* contact = &state->spec->contact_plan[state->current];
+        dtn_contact_usage_t* usage = &state->result->contact_usage[state->current];
+
+        usage->duration = simulated_time - state->window_start;
+        usage->bytes_up = dtn_contact_bytes_sent(test_ctx->cnx_client) - state->bytes_up_start;
+        usage->bytes_down = dtn_contact_bytes_sent(test_ctx->cnx_server) - state->bytes_down_start;
+        if (usage->duration > 0) {
+            /* Mbps times microseconds gives bits */
+            usage->usage_up = ((double)usage->bytes_up * 8.0) / (contact->mbps_up * (double)usage->duration);
+            usage->usage_down = ((double)usage->bytes_down * 8.0) / (contact->mbps_down * (double)usage->duration);
+        }
+        state->result->nb_contacts_used = state->current + 1;
+    }
+    state->is_up = 0;
+}
+
+/* Set the links for the simulated time, and return the time of the next
+ * change of the plan, or 0 if there is none.
+ */
+uint64_t dtn_contact_update(dtn_contact_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    dtn_test_spec_t const* spec = state->spec;
+    uint64_t next_change = 0;
+    double fec_factor;
+
+    if (spec == NULL || spec->nb_contacts == 0) {
+        return 0;
+    }
+    fec_factor = dtn_fec_rate_factor(&spec->fec);
+
+    if (state->is_up && simulated_time >= spec->contact_plan[state->current].end_time) {
+        dtn_contact_close_window(state, test_ctx, simulated_time);
+        state->current++;
+    }
+    while (state->current < spec->nb_contacts && simulated_time >= spec->contact_plan[state->current].end_time) {
+        /* Window missed entirely, e.g., during the handshake of a resumed contact */
+        state->current++;
+    }
+
+    if (state->current < spec->nb_contacts) {
+        dtn_contact_t const* contact = &spec->contact_plan[state->current];
+
+        if (simulated_time >= contact->start_time) {
+            if (!state->is_up) {
+                state->is_up = 1;
+                state->window_start = simulated_time;
+                state->bytes_up_start = dtn_contact_bytes_sent(test_ctx->cnx_client);
+                state->bytes_down_start = dtn_contact_bytes_sent(test_ctx->cnx_server);
+                test_ctx->c_to_s_link->microsec_latency = contact->latency;
+                test_ctx->c_to_s_link->picosec_per_byte = (uint64_t)((1000000.0 * 8 * fec_factor) / contact->mbps_up);
+                test_ctx->s_to_c_link->microsec_latency = contact->latency;
+                test_ctx->s_to_c_link->picosec_per_byte = (uint64_t)((1000000.0 * 8 * fec_factor) / contact->mbps_down);
+            }
+            next_change = contact->end_time;
+        }
+        else {
+            next_change = contact->start_time;
+        }
+    }
+
+    test_ctx->c_to_s_link->loss_mask = (state->is_up) ? state->loss_mask : &state->down_mask;
+    test_ctx->s_to_c_link->loss_mask = (state->is_up) ? state->loss_mask : &state->down_mask;
+
+    return next_change;
+}
+
+void dtn_contact_finish(dtn_contact_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    if (state->spec != NULL && state->spec->nb_contacts > 0) {
+        double bits_sent = 0;
+        double capacity = 0;
+
+        dtn_contact_close_window(state, test_ctx, simulated_time);
+
+        if (state->result != NULL) {
+            for (size_t i = 0; i < state->result->nb_contacts_used; i++) {
+                bits_sent += 8.0 * (double)state->result->contact_usage[i].bytes_down;
+                capacity += state->spec->contact_plan[i].mbps_down * (double)state->result->contact_usage[i].duration;
+            }
+            if (capacity > 0) {
+                state->result->contact_usage_down = bits_sent / capacity;
+            }
+        }
+        /* Restore the loss mask, the links are used again to close the connections */
+        test_ctx->c_to_s_link->loss_mask = state->loss_mask;
+        test_ctx->s_to_c_link->loss_mask = state->loss_mask;
+    }
+}
+
+int dtn_contact_is_up(dtn_contact_state_t const* state)
+{
+    return state->spec == NULL || state->spec->nb_contacts == 0 || state->is_up;
+}
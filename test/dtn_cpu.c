@@ -0,0 +1,299 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* CPU cost per packet.
+ *
+ * Flight computers run below a GHz, and some have no AES instructions.
+ * The crypto part of the benchmark measures, for each cipher suite and
+ * packet size, the time to encrypt and to decrypt the payload of one
+ * packet, and the time to compute the header protection mask. The
+ * minicrypto suites are the portable C implementations of picotls, and
+ * stand for the CPUs on which OpenSSL cannot use AES instructions.
+ *
+ * The path part runs a 10 MB download over a short link with logging
+ * off, for each suite and link MTU, and divides the wall time of the
+ * transfer by the number of packets sent and received. Each packet is
+ * sent once and received once, so that is the cost of going through the
+ * send path of one side and the receive path of the other, plus the share
+ * of the simulated link, which is the same for all suites.
+ *
+ * Times are in nanoseconds. If the CPU frequency is given, the benchmark
+ * also reports cycles, i.e. nanoseconds times MHz / 1000; on the bench
+ * computer that is only an estimate of the cycles of the flight CPU.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picotls.h>
+#include <picotls/openssl.h>
+#include <picotls/minicrypto.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+/* Short header: first byte, 8 bytes connection ID, 4 bytes sequence number */
+#define DTN_CPU_HEADER_SIZE 13
+#define DTN_CPU_SAMPLE_SIZE 16
+#define DTN_CPU_MASK_SIZE 5
+
+typedef struct st_dtn_cpu_suite_t {
+    char const* name;
+    ptls_cipher_suite_t* suite;
+} dtn_cpu_suite_t;
+
+static const dtn_cpu_suite_t dtn_cpu_suites[] = {
+    { "openssl_aes128gcm", &ptls_openssl_aes128gcmsha256 },
+    { "openssl_aes256gcm", &ptls_openssl_aes256gcmsha384 },
+#ifdef PTLS_OPENSSL_HAVE_CHACHA20_POLY1305
+    { "openssl_chacha20", &ptls_openssl_chacha20poly1305sha256 },
+#endif
+    { "minicrypto_aes128gcm", &ptls_minicrypto_aes128gcmsha256 },
+    { "minicrypto_chacha20", &ptls_minicrypto_chacha20poly1305sha256 }
+};
+
+static const size_t dtn_cpu_packet_sizes[] = {
+    64, 256, 1200, 1440, PICOQUIC_MAX_PACKET_SIZE
+};
+
+/* Suites of the path part, by picoquic cipher suite ID */
+typedef struct st_dtn_cpu_path_suite_t {
+    char const* name;
+    int cipher_suite_id;
+} dtn_cpu_path_suite_t;
+
+static const dtn_cpu_path_suite_t dtn_cpu_path_suites[] = {
+    { "aes128gcm", 128 },
+    { "aes256gcm", 256 },
+    { "chacha20", 20 }
+};
+
+static const size_t dtn_cpu_path_mtus[] = {
+    1200, 1440, PICOQUIC_MAX_PACKET_SIZE
+};
+
+static double dtn_cpu_ns(uint64_t start_time, int nb_iterations)
+{
+    return ((double)(picoquic_current_time() - start_time)) * 1000.0 / (double)nb_iterations;
+}
+
+static double dtn_cpu_cycles(double ns, double cpu_mhz)
+{
+    return ns * cpu_mhz / 1000.0;
+}
+
+/* Time the encryption, decryption and header protection of one packet of
+ * the given size, averaged over nb_iterations. The keys are constant,
+ * the cost does not depend on them. */
+static int dtn_cpu_crypto_one(ptls_cipher_suite_t* suite, size_t packet_size, int nb_iterations,
+    double* encrypt_ns, double* decrypt_ns, double* header_ns)
+{
+    int ret = 0;
+    uint8_t secret[64];
+    uint8_t hp_key[32];
+    uint8_t header[DTN_CPU_HEADER_SIZE];
+    uint8_t mask[DTN_CPU_MASK_SIZE];
+    uint8_t mask_zero[DTN_CPU_MASK_SIZE];
+    uint8_t* payload = (uint8_t*)malloc(PICOQUIC_MAX_PACKET_SIZE);
+    uint8_t* encrypted = (uint8_t*)malloc(PICOQUIC_MAX_PACKET_SIZE);
+    uint8_t* decrypted = (uint8_t*)malloc(PICOQUIC_MAX_PACKET_SIZE);
+    ptls_aead_context_t* aead_enc = NULL;
+    ptls_aead_context_t* aead_dec = NULL;
+    ptls_cipher_context_t* hp_enc = NULL;
+    size_t tag_size = suite->aead->tag_size;
+    size_t payload_size = packet_size - DTN_CPU_HEADER_SIZE - tag_size;
+    size_t encrypted_size = 0;
+
+    memset(secret, 0x5a, sizeof(secret));
+    memset(hp_key, 0xa5, sizeof(hp_key));
+    memset(header, 0x40, sizeof(header));
+    memset(mask_zero, 0, sizeof(mask_zero));
+
+    if (payload == NULL || encrypted == NULL || decrypted == NULL || packet_size < DTN_CPU_HEADER_SIZE + tag_size + DTN_CPU_SAMPLE_SIZE) {
+        ret = -1;
+    }
+    else {
+        memset(payload, 0x2b, payload_size);
+        aead_enc = ptls_aead_new(suite->aead, suite->hash, 1, secret, "tls13 quic ");
+        aead_dec = ptls_aead_new(suite->aead, suite->hash, 0, secret, "tls13 quic ");
+        hp_enc = ptls_cipher_new(suite->aead->ctr_cipher, 1, hp_key);
+        if (aead_enc == NULL || aead_dec == NULL || hp_enc == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        uint64_t start_time = picoquic_current_time();
+
+        for (int i = 0; i < nb_iterations; i++) {
+            encrypted_size = ptls_aead_encrypt(aead_enc, encrypted, payload, payload_size, (uint64_t)i,
+                header, sizeof(header));
+        }
+        *encrypt_ns = dtn_cpu_ns(start_time, nb_iterations);
+
+        /* Decrypt the last packet again and again, the AEAD does not check replays */
+        start_time = picoquic_current_time();
+        for (int i = 0; ret == 0 && i < nb_iterations; i++) {
+            if (ptls_aead_decrypt(aead_dec, decrypted, encrypted, encrypted_size, (uint64_t)(nb_iterations - 1),
+                header, sizeof(header)) != payload_size) {
+                ret = -1;
+            }
+        }
+        *decrypt_ns = dtn_cpu_ns(start_time, nb_iterations);
+
+        if (ret == 0 && memcmp(payload, decrypted, payload_size) != 0) {
+            ret = -1;
+        }
+
+        /* The mask is computed from a sample of the encrypted payload, the
+         * same way on both sides */
+        start_time = picoquic_current_time();
+        for (int i = 0; i < nb_iterations; i++) {
+            ptls_cipher_init(hp_enc, encrypted);
+            ptls_cipher_encrypt(hp_enc, mask, mask_zero, sizeof(mask));
+        }
+        *header_ns = dtn_cpu_ns(start_time, nb_iterations);
+    }
+
+    if (hp_enc != NULL) {
+        ptls_cipher_free(hp_enc);
+    }
+    if (aead_dec != NULL) {
+        ptls_aead_free(aead_dec);
+    }
+    if (aead_enc != NULL) {
+        ptls_aead_free(aead_enc);
+    }
+    free(decrypted);
+    free(encrypted);
+    free(payload);
+
+    return ret;
+}
+
+static int dtn_cpu_crypto_benchmark(FILE* F, int nb_iterations, double cpu_mhz, int* nb_failed)
+{
+    int ret = 0;
+    size_t nb_suites = sizeof(dtn_cpu_suites) / sizeof(dtn_cpu_suite_t);
+    size_t nb_sizes = sizeof(dtn_cpu_packet_sizes) / sizeof(size_t);
+
+    for (size_t i = 0; ret == 0 && i < nb_suites; i++) {
+        for (size_t j = 0; ret == 0 && j < nb_sizes; j++) {
+            double encrypt_ns = 0;
+            double decrypt_ns = 0;
+            double header_ns = 0;
+            double packet_ns;
+            int crypto_ret = dtn_cpu_crypto_one(dtn_cpu_suites[i].suite, dtn_cpu_packet_sizes[j], nb_iterations,
+                &encrypt_ns, &decrypt_ns, &header_ns);
+
+            /* Each packet is protected by the sender and unprotected by the receiver */
+            packet_ns = encrypt_ns + decrypt_ns + 2 * header_ns;
+            fprintf(F, "crypto, %s, %" PRIst ", %d, %f, %f, %f, %f, %f\n", dtn_cpu_suites[i].name,
+                dtn_cpu_packet_sizes[j], crypto_ret, encrypt_ns, decrypt_ns, header_ns, packet_ns,
+                dtn_cpu_cycles(packet_ns, cpu_mhz));
+            fflush(F);
+            fprintf(stdout, "Crypto %s, %" PRIst " bytes: %s, encrypt %.1f ns, decrypt %.1f ns, header %.1f ns",
+                dtn_cpu_suites[i].name, dtn_cpu_packet_sizes[j], (crypto_ret == 0) ? "pass" : "fail",
+                encrypt_ns, decrypt_ns, header_ns);
+            if (cpu_mhz > 0) {
+                fprintf(stdout, ", %.0f cycles per packet", dtn_cpu_cycles(packet_ns, cpu_mhz));
+            }
+            fprintf(stdout, "\n");
+            fflush(stdout);
+            if (crypto_ret != 0) {
+                (*nb_failed)++;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_cpu_path_benchmark(FILE* F, double cpu_mhz, int* nb_failed)
+{
+    int ret = 0;
+    size_t nb_suites = sizeof(dtn_cpu_path_suites) / sizeof(dtn_cpu_path_suite_t);
+    size_t nb_mtus = sizeof(dtn_cpu_path_mtus) / sizeof(size_t);
+    uint16_t test_seq = 0;
+
+    for (size_t i = 0; i < nb_suites; i++) {
+        for (size_t j = 0; j < nb_mtus; j++) {
+            dtn_test_spec_t spec;
+            dtn_test_result_t result;
+            uint64_t nb_packets;
+            double packet_ns = 0;
+
+            dtn_set_cpu_test_spec(&spec, dtn_cpu_path_suites[i].cipher_suite_id, dtn_cpu_path_mtus[j]);
+            spec.log_level = dtn_log_off;
+            test_seq++;
+            (void)dtn_test_one_ex(0xc6, test_seq, &spec, &result);
+            nb_packets = result.nb_packets_sent + result.nb_packets_received;
+            if (nb_packets > 0) {
+                packet_ns = ((double)result.profile.transfer_wall_time) * 1000.0 / (double)nb_packets;
+            }
+            fprintf(F, "path, %s, %" PRIst ", %d, , , , %f, %f\n", dtn_cpu_path_suites[i].name,
+                dtn_mtu_effective(dtn_cpu_path_mtus[j]), result.ret, packet_ns, dtn_cpu_cycles(packet_ns, cpu_mhz));
+            fflush(F);
+            fprintf(stdout, "Path %s, MTU %" PRIst ": %s, %" PRIu64 " packets in %.3f s, %.1f ns per packet",
+                dtn_cpu_path_suites[i].name, dtn_mtu_effective(dtn_cpu_path_mtus[j]), (result.ret == 0) ? "pass" : "fail",
+                nb_packets, ((double)result.profile.transfer_wall_time) / 1000000.0, packet_ns);
+            if (cpu_mhz > 0) {
+                fprintf(stdout, ", %.0f cycles", dtn_cpu_cycles(packet_ns, cpu_mhz));
+            }
+            fprintf(stdout, "\n");
+            fflush(stdout);
+            if (result.ret != 0) {
+                (*nb_failed)++;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int dtn_cpu_benchmark(char const* file_name, int nb_iterations, double cpu_mhz)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        int nb_failed = 0;
+
+        fprintf(F, "part, suite, packet_size, ret, encrypt_ns, decrypt_ns, header_ns, packet_ns, packet_cycles\n");
+        if (nb_iterations <= 0) {
+            nb_iterations = DTN_CPU_DEFAULT_ITERATIONS;
+        }
+        ret = dtn_cpu_crypto_benchmark(F, nb_iterations, cpu_mhz, &nb_failed);
+        if (ret == 0) {
+            ret = dtn_cpu_path_benchmark(F, cpu_mhz, &nb_failed);
+        }
+        fprintf(stdout, "CPU benchmark done, %d runs failed, results in %s\n", nb_failed, file_name);
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
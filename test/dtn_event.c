@@ -0,0 +1,201 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Event driven simulation rounds.
+ *
+ * With latencies of minutes or hours, the cost of a simulation should
+ * depend on the number of packets, not on the simulated time. The event
+ * round keeps the next time of each source of events in a heap: the
+ * wake times of the client and the server, the next arrival on each
+ * link, and the next change of the link models. Each round jumps the
+ * simulated time straight to the earliest event, then handles all the
+ * events due at that time: packets are delivered first, then the server
+ * and the client each send a packet if they are ready. A side that has
+ * more to send is still ready at the same time, so the next round does
+ * not move the clock. Sending at most one packet per side and per round
+ * keeps the loss models, which draw the fate of one packet per round,
+ * exact. Nothing in the round advances in fixed steps or polls.
+ *
+ * The round replaces tls_api_one_sim_round in the data transfer loop
+ * when the spec sets event_loop. The handshake still uses the rounds of
+ * the test_api.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+static int dtn_event_is_before(dtn_event_queue_t const* queue, size_t i, size_t j)
+{
+    return queue->time[queue->heap[i]] < queue->time[queue->heap[j]];
+}
+
+static void dtn_event_swap(dtn_event_queue_t* queue, size_t i, size_t j)
+{
+    int source = queue->heap[i];
+
+    queue->heap[i] = queue->heap[j];
+    queue->heap[j] = source;
+    queue->position[queue->heap[i]] = i;
+    queue->position[queue->heap[j]] = j;
+}
+
+void dtn_event_queue_init(dtn_event_queue_t* queue)
+{
+    for (int i = 0; i < dtn_event_nb_sources; i++) {
+        queue->heap[i] = i;
+        queue->position[i] = (size_t)i;
+        queue->time[i] = UINT64_MAX;
+    }
+}
+
+/* Set the next time of a source, 0 or UINT64_MAX if it has none */
+void dtn_event_set(dtn_event_queue_t* queue, dtn_event_source_t source, uint64_t event_time)
+{
+    size_t i = queue->position[source];
+
+    queue->time[source] = (event_time == 0) ? UINT64_MAX : event_time;
+    while (i > 0 && dtn_event_is_before(queue, i, (i - 1) / 2)) {
+        dtn_event_swap(queue, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t first = i;
+        size_t left = 2 * i + 1;
+
+        if (left < dtn_event_nb_sources && dtn_event_is_before(queue, left, first)) {
+            first = left;
+        }
+        if (left + 1 < dtn_event_nb_sources && dtn_event_is_before(queue, left + 1, first)) {
+            first = left + 1;
+        }
+        if (first == i) {
+            break;
+        }
+        dtn_event_swap(queue, i, first);
+        i = first;
+    }
+}
+
+uint64_t dtn_event_next_time(dtn_event_queue_t const* queue)
+{
+    return queue->time[queue->heap[0]];
+}
+
+static int dtn_event_deliver(picoquic_test_tls_api_ctx_t* test_ctx, picoquic_quic_t* quic,
+    picoquictest_sim_link_t* link, uint64_t simulated_time, int* was_active)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet;
+
+    while (ret == 0 && (packet = picoquictest_sim_link_dequeue(link, simulated_time)) != NULL) {
+        ret = picoquic_incoming_packet(quic, packet->bytes, packet->length,
+            (struct sockaddr*)&packet->addr_from, (struct sockaddr*)&packet->addr_to, 0, 0, simulated_time);
+        free(packet);
+        *was_active = 1;
+    }
+    if (ret == 0 && quic == test_ctx->qserver && test_ctx->cnx_server == NULL) {
+        /* The server connection is created by the first packet of the client */
+        test_ctx->cnx_server = picoquic_get_first_cnx(test_ctx->qserver);
+    }
+
+    return ret;
+}
+
+static int dtn_event_send(picoquic_quic_t* quic, picoquictest_sim_link_t* link, struct sockaddr_in const* default_from,
+    uint64_t simulated_time, int* was_active)
+{
+    int ret = 0;
+
+    if (picoquic_get_next_wake_time(quic, simulated_time) <= simulated_time) {
+        picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+        int if_index = 0;
+        picoquic_connection_id_t log_cid;
+        picoquic_cnx_t* last_cnx = NULL;
+
+        if (packet == NULL) {
+            ret = -1;
+        }
+        else {
+            ret = picoquic_prepare_next_packet(quic, simulated_time, packet->bytes, PICOQUIC_MAX_PACKET_SIZE,
+                &packet->length, &packet->addr_to, &packet->addr_from, &if_index, &log_cid, &last_cnx);
+            if (ret == 0 && packet->length > 0) {
+                if (packet->addr_from.ss_family == 0) {
+                    picoquic_store_addr(&packet->addr_from, (struct sockaddr*)default_from);
+                }
+                picoquictest_sim_link_submit(link, packet, simulated_time);
+                *was_active = 1;
+            }
+            else {
+                /* Nothing to send, the wake time was pushed back */
+                free(packet);
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* One round of the event driven simulation. The next change of the link
+ * models is an event of its own, 0 if there is none. */
+int dtn_event_sim_round(picoquic_test_tls_api_ctx_t* test_ctx, dtn_event_queue_t* queue,
+    uint64_t* simulated_time, uint64_t next_change, int* was_active)
+{
+    int ret = 0;
+    uint64_t event_time;
+
+    *was_active = 0;
+    dtn_event_set(queue, dtn_event_client, picoquic_get_next_wake_time(test_ctx->qclient, *simulated_time));
+    dtn_event_set(queue, dtn_event_server, picoquic_get_next_wake_time(test_ctx->qserver, *simulated_time));
+    dtn_event_set(queue, dtn_event_uplink, picoquictest_sim_link_next_arrival(test_ctx->c_to_s_link, UINT64_MAX));
+    dtn_event_set(queue, dtn_event_downlink, picoquictest_sim_link_next_arrival(test_ctx->s_to_c_link, UINT64_MAX));
+    dtn_event_set(queue, dtn_event_model, next_change);
+
+    event_time = dtn_event_next_time(queue);
+    if (event_time == UINT64_MAX) {
+        /* Nothing will ever happen */
+        return 0;
+    }
+    if (event_time > *simulated_time) {
+        *simulated_time = event_time;
+    }
+
+    if (queue->time[dtn_event_uplink] <= *simulated_time) {
+        ret = dtn_event_deliver(test_ctx, test_ctx->qserver, test_ctx->c_to_s_link, *simulated_time, was_active);
+    }
+    if (ret == 0 && queue->time[dtn_event_downlink] <= *simulated_time) {
+        ret = dtn_event_deliver(test_ctx, test_ctx->qclient, test_ctx->s_to_c_link, *simulated_time, was_active);
+    }
+    /* Deliveries may have moved the wake times */
+    if (ret == 0) {
+        ret = dtn_event_send(test_ctx->qserver, test_ctx->s_to_c_link, &test_ctx->server_addr, *simulated_time, was_active);
+    }
+    if (ret == 0) {
+        ret = dtn_event_send(test_ctx->qclient, test_ctx->c_to_s_link, &test_ctx->client_addr, *simulated_time, was_active);
+    }
+
+    return ret;
+}
@@ -0,0 +1,123 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Idle timeout and keep alive schedule of the DTN connections.
+ *
+ * By default the harness sets the idle timeout to 5 times the latency,
+ * and only enables the picoquic keep alive when a silence in the spec
+ * would outlast it. In the low chatter mode, the schedule is derived from
+ * the latency and the contact plan instead:
+ *  - the idle timeout covers the longest silence or gap between contacts,
+ *    plus two round trips, so that no packet at all is needed to keep
+ *    the connection alive,
+ *  - if the spec caps the idle timeout, keep alive packets are sent as
+ *    rarely as possible, but early enough to reach the peer and get the
+ *    ACK back before the timer expires, i.e., one and a quarter round
+ *    trip before the end of the idle period. A shorter interval would
+ *    only send probes that the next one makes redundant,
+ *  - the initial RTT is set to the expected round trip, so that the
+ *    handshake packets are not repeated every few hundred milliseconds
+ *    while the first ones are still in flight.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "delay_tolerant_internal.h"
+
+static uint64_t dtn_idle_max_latency(dtn_test_spec_t const* spec)
+{
+    uint64_t latency = spec->latency;
+
+    for (size_t i = 0; i < spec->nb_contacts; i++) {
+        if (spec->contact_plan[i].latency > latency) {
+            latency = spec->contact_plan[i].latency;
+        }
+    }
+
+    return latency;
+}
+
+static uint64_t dtn_idle_longest_quiet(dtn_test_spec_t const* spec)
+{
+    uint64_t quiet = spec->silence_duration;
+
+    for (size_t i = 1; i < spec->nb_contacts; i++) {
+        if (spec->contact_plan[i].start_time > spec->contact_plan[i - 1].end_time &&
+            spec->contact_plan[i].start_time - spec->contact_plan[i - 1].end_time > quiet) {
+            quiet = spec->contact_plan[i].start_time - spec->contact_plan[i - 1].end_time;
+        }
+    }
+
+    return quiet;
+}
+
+void dtn_idle_schedule(dtn_test_spec_t const* spec, dtn_idle_schedule_t* schedule)
+{
+    uint64_t rtt = 2 * dtn_idle_max_latency(spec);
+
+    memset(schedule, 0, sizeof(dtn_idle_schedule_t));
+    schedule->idle_timeout = 5 * spec->latency;
+
+    if (!spec->low_chatter) {
+        if (spec->silence_duration >= schedule->idle_timeout) {
+            /* Picoquic default, half the idle timeout */
+            schedule->keep_alive_interval = schedule->idle_timeout / 2;
+        }
+    }
+    else {
+        uint64_t needed = dtn_idle_longest_quiet(spec) + 2 * rtt;
+
+        if (needed > schedule->idle_timeout) {
+            schedule->idle_timeout = needed;
+        }
+        if (spec->max_idle_timeout > 0 && schedule->idle_timeout > spec->max_idle_timeout) {
+            schedule->idle_timeout = spec->max_idle_timeout;
+            if (schedule->idle_timeout > (9 * rtt) / 4) {
+                schedule->keep_alive_interval = schedule->idle_timeout - (5 * rtt) / 4;
+            }
+            else {
+                /* No interval gets the ACK back in time, do the best we can */
+                schedule->keep_alive_interval = schedule->idle_timeout / 2;
+            }
+        }
+        schedule->initial_rtt = rtt;
+    }
+}
+
+void dtn_idle_apply(picoquic_cnx_t* cnx, dtn_idle_schedule_t const* schedule, int is_client)
+{
+    if (cnx != NULL) {
+        if (is_client && schedule->keep_alive_interval > 0) {
+            /* One side is enough, the ACK of the PING resets the other timer */
+            picoquic_enable_keep_alive(cnx, schedule->keep_alive_interval);
+        }
+        if (schedule->initial_rtt > 0 && cnx->path != NULL && cnx->path[0] != NULL) {
+            /* Same initial variance as RFC 9002, half the RTT */
+            cnx->path[0]->smoothed_rtt = schedule->initial_rtt;
+            cnx->path[0]->rtt_variant = schedule->initial_rtt / 2;
+            cnx->path[0]->retransmit_timer = 3 * schedule->initial_rtt;
+        }
+    }
+}
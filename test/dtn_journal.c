@@ -0,0 +1,300 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Journal of the data received on each stream.
+ *
+ * Long transfers run over hours or several contacts. If the receiving
+ * process restarts, the data already received should not be sent again
+ * over the scarce deep space link. Stream data is delivered in order, so
+ * the data received and stored by the application on a stream is the
+ * range from 0 to some offset. The journal records that offset, with the
+ * checksum of the data up to it, every journal interval, so a new
+ * connection can request the rest of the object.
+ *
+ * The journal is a file of fixed size records, each protected by a
+ * checksum. Records are appended and flushed, and forced to the disk if
+ * is_sync is set. A crash while writing leaves at most one torn record
+ * at the end of the file, which is ignored when the journal is read. On
+ * open, and when the file holds more than DTN_JOURNAL_MAX_RECORDS
+ * records, the journal is compacted: the last entry of each stream is
+ * written to a temporary file, which then replaces the journal.
+ */
+
+#ifdef _WINDOWS
+#include "wincompat.h"
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "delay_tolerant_internal.h"
+
+#define DTN_JOURNAL_MAGIC 0x444e544aul
+#define DTN_JOURNAL_RECORD_SIZE 32
+#define DTN_JOURNAL_MAX_RECORDS 1024
+
+static uint32_t dtn_journal_crc(uint8_t const* bytes, size_t length)
+{
+    uint32_t crc = 0x811c9dc5u;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc *= 0x01000193u;
+    }
+
+    return crc;
+}
+
+static void dtn_journal_encode_64(uint8_t* bytes, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(v >> (56 - 8 * i));
+    }
+}
+
+static uint64_t dtn_journal_decode_64(uint8_t const* bytes)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | bytes[i];
+    }
+
+    return v;
+}
+
+/* Record layout: magic (4), stream id (8), offset (8), checksum (8),
+ * crc of the previous fields (4), all in network order. */
+static void dtn_journal_encode(uint8_t* record, dtn_journal_entry_t const* entry)
+{
+    uint32_t crc;
+
+    record[0] = (uint8_t)(DTN_JOURNAL_MAGIC >> 24);
+    record[1] = (uint8_t)(DTN_JOURNAL_MAGIC >> 16);
+    record[2] = (uint8_t)(DTN_JOURNAL_MAGIC >> 8);
+    record[3] = (uint8_t)(DTN_JOURNAL_MAGIC);
+    dtn_journal_encode_64(record + 4, entry->stream_id);
+    dtn_journal_encode_64(record + 12, entry->offset);
+    dtn_journal_encode_64(record + 20, entry->checksum);
+    crc = dtn_journal_crc(record, 28);
+    record[28] = (uint8_t)(crc >> 24);
+    record[29] = (uint8_t)(crc >> 16);
+    record[30] = (uint8_t)(crc >> 8);
+    record[31] = (uint8_t)(crc);
+}
+
+static int dtn_journal_decode(uint8_t const* record, dtn_journal_entry_t* entry)
+{
+    uint32_t magic = ((uint32_t)record[0] << 24) | ((uint32_t)record[1] << 16) | ((uint32_t)record[2] << 8) | record[3];
+    uint32_t crc = ((uint32_t)record[28] << 24) | ((uint32_t)record[29] << 16) | ((uint32_t)record[30] << 8) | record[31];
+    int ret = 0;
+
+    if (magic != DTN_JOURNAL_MAGIC || crc != dtn_journal_crc(record, 28)) {
+        ret = -1;
+    }
+    else {
+        entry->stream_id = dtn_journal_decode_64(record + 4);
+        entry->offset = dtn_journal_decode_64(record + 12);
+        entry->checksum = dtn_journal_decode_64(record + 20);
+    }
+
+    return ret;
+}
+
+static int dtn_journal_sync(dtn_journal_t* journal, FILE* F)
+{
+    int ret = fflush(F);
+
+    if (ret == 0 && journal->is_sync) {
+#ifdef _WINDOWS
+        ret = _commit(_fileno(F));
+#else
+        ret = fsync(fileno(F));
+#endif
+    }
+
+    return ret;
+}
+
+static int dtn_journal_update_entry(dtn_journal_t* journal, dtn_journal_entry_t const* entry)
+{
+    int ret = 0;
+    size_t i = 0;
+
+    while (i < journal->nb_entries && journal->entry[i].stream_id != entry->stream_id) {
+        i++;
+    }
+    if (i >= DTN_JOURNAL_MAX_STREAMS) {
+        DBG_PRINTF("Journal is limited to %d streams", DTN_JOURNAL_MAX_STREAMS);
+        ret = -1;
+    }
+    else {
+        journal->entry[i] = *entry;
+        if (i == journal->nb_entries) {
+            journal->nb_entries++;
+        }
+    }
+
+    return ret;
+}
+
+/* Read the valid records, stopping at the first torn or corrupt one */
+static void dtn_journal_load(dtn_journal_t* journal)
+{
+    FILE* F = picoquic_file_open(journal->file_name, "rb");
+
+    if (F != NULL) {
+        uint8_t record[DTN_JOURNAL_RECORD_SIZE];
+        dtn_journal_entry_t entry;
+
+        while (fread(record, 1, sizeof(record), F) == sizeof(record) &&
+            dtn_journal_decode(record, &entry) == 0 &&
+            dtn_journal_update_entry(journal, &entry) == 0) {
+        }
+        (void)picoquic_file_close(F);
+    }
+}
+
+/* Replace the journal by the last entry of each stream */
+static int dtn_journal_compact(dtn_journal_t* journal)
+{
+    int ret = 0;
+    char tmp_name[sizeof(journal->file_name) + 4];
+    FILE* F;
+
+    if (journal->F != NULL) {
+        (void)picoquic_file_close(journal->F);
+        journal->F = NULL;
+    }
+    (void)picoquic_sprintf(tmp_name, sizeof(tmp_name), NULL, "%s.tmp", journal->file_name);
+    if ((F = picoquic_file_open(tmp_name, "wb")) == NULL) {
+        ret = -1;
+    }
+    else {
+        for (size_t i = 0; ret == 0 && i < journal->nb_entries; i++) {
+            uint8_t record[DTN_JOURNAL_RECORD_SIZE];
+
+            dtn_journal_encode(record, &journal->entry[i]);
+            if (fwrite(record, 1, sizeof(record), F) != sizeof(record)) {
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            ret = dtn_journal_sync(journal, F);
+        }
+        (void)picoquic_file_close(F);
+    }
+    if (ret == 0) {
+#ifdef _WINDOWS
+        ret = MoveFileExA(tmp_name, journal->file_name, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+        ret = rename(tmp_name, journal->file_name);
+#endif
+    }
+    if (ret == 0) {
+        journal->nb_file_records = journal->nb_entries;
+        if ((journal->F = picoquic_file_open(journal->file_name, "ab")) == NULL) {
+            ret = -1;
+        }
+    }
+    if (ret != 0) {
+        DBG_PRINTF("Cannot compact journal %s", journal->file_name);
+    }
+
+    return ret;
+}
+
+int dtn_journal_open(dtn_journal_t* journal, char const* file_name, int is_sync)
+{
+    int ret = 0;
+
+    memset(journal, 0, sizeof(dtn_journal_t));
+    journal->is_sync = is_sync;
+    if (strlen(file_name) >= sizeof(journal->file_name)) {
+        DBG_PRINTF("Journal name too long: %s", file_name);
+        ret = -1;
+    }
+    else {
+        memcpy(journal->file_name, file_name, strlen(file_name) + 1);
+        dtn_journal_load(journal);
+        /* Drop the torn record, if any, before appending */
+        ret = dtn_journal_compact(journal);
+    }
+
+    return ret;
+}
+
+int dtn_journal_record(dtn_journal_t* journal, uint64_t stream_id, uint64_t offset, uint64_t checksum)
+{
+    int ret = 0;
+    uint64_t wall_time = picoquic_current_time();
+    uint8_t record[DTN_JOURNAL_RECORD_SIZE];
+    dtn_journal_entry_t entry;
+
+    entry.stream_id = stream_id;
+    entry.offset = offset;
+    entry.checksum = checksum;
+    dtn_journal_encode(record, &entry);
+    if (journal->F == NULL || fwrite(record, 1, sizeof(record), journal->F) != sizeof(record) ||
+        dtn_journal_sync(journal, journal->F) != 0) {
+        DBG_PRINTF("Cannot write journal %s", journal->file_name);
+        ret = -1;
+    }
+    else {
+        journal->nb_file_records++;
+        journal->nb_records++;
+        journal->bytes_written += sizeof(record);
+        ret = dtn_journal_update_entry(journal, &entry);
+        if (ret == 0 && journal->nb_file_records > DTN_JOURNAL_MAX_RECORDS) {
+            ret = dtn_journal_compact(journal);
+            journal->bytes_written += journal->nb_entries * DTN_JOURNAL_RECORD_SIZE;
+        }
+    }
+    journal->write_wall_time += picoquic_current_time() - wall_time;
+
+    return ret;
+}
+
+dtn_journal_entry_t const* dtn_journal_find(dtn_journal_t const* journal, uint64_t stream_id)
+{
+    dtn_journal_entry_t const* entry = NULL;
+
+    for (size_t i = 0; i < journal->nb_entries; i++) {
+        if (journal->entry[i].stream_id == stream_id) {
+            entry = &journal->entry[i];
+            break;
+        }
+    }
+
+    return entry;
+}
+
+void dtn_journal_close(dtn_journal_t* journal)
+{
+    if (journal->F != NULL) {
+        (void)picoquic_file_close(journal->F);
+        journal->F = NULL;
+    }
+}
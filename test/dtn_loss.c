@@ -0,0 +1,273 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Loss models.
+ *
+ * The has_loss option of the spec uses the loss mask of the simulated
+ * links, which only describes a fixed periodic pattern. Real links have
+ * random losses, bursts of errors, bit error rates that make large
+ * packets more likely to be lost than small ones, and scheduled
+ * blackouts, e.g., during solar conjunction. The loss models describe
+ * these cases:
+ *  - Bernoulli: each packet is lost with the same probability,
+ *  - Gilbert-Elliott: the link alternates between a good and a bad
+ *    state, with a loss probability for each state,
+ *  - BER: each bit is in error with the given probability, and a packet
+ *    is lost if any of its bits is in error,
+ *  - blackouts: all packets are lost during the listed intervals, in
+ *    addition to the losses of the model.
+ *
+ * The simulated links decide the loss of a packet when it is submitted,
+ * by testing the low bit of the loss mask, then rotating the mask by one
+ * bit. Before each round, we draw the fate of the next packet on each
+ * link, and set it in the low bit of the mask, with a marker in bit 62.
+ * If the mask changed after the round, the packet was submitted and we
+ * draw the next one. Other packets submitted in the same round test the
+ * zero bits that follow, and are not lost, unless more than 62 of them
+ * are submitted before the marker comes down. The size of the next
+ * packet is not known when its fate is drawn, so the BER model uses the
+ * size of the last packet seen on the link.
+ *
+ * Each direction has its own random generator, seeded from the model, so
+ * runs with the same seed lose the same packets.
+ *
+ * Picoquic does not implement FEC, so the erasure coding is simulated at
+ * the link layer, as done by the CCSDS links. Each block of source packets
+ * is followed by repair packets. The repair packets use the capacity of the
+ * link, so the rate seen by QUIC is reduced by the redundancy ratio. The
+ * fate of all the packets of a block, source and repair, is drawn when the
+ * block starts. If no more packets are lost than there are repair packets,
+ * the decoder recovers all the source packets of the block, otherwise the
+ * lost source packets stay lost. The recovered packets are delivered
+ * without waiting for the end of the block, since the block duration is
+ * small compared to the latency. Blackouts erase whole blocks and are not
+ * recovered.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_LOSS_DEFAULT_SEED 0x10550de1u
+#define DTN_LOSS_RANDOM_RANGE ((uint64_t)1 << 53)
+#define DTN_LOSS_MASK_MARKER ((uint64_t)1 << 62)
+
+static double dtn_loss_random(uint64_t* random_ctx)
+{
+    return ((double)picoquic_test_uniform_random(random_ctx, DTN_LOSS_RANDOM_RANGE)) / (double)DTN_LOSS_RANDOM_RANGE;
+}
+
+/* Probability that a packet of the given size has no bit in error,
+ * computed by squaring so there is no need for the math library */
+static double dtn_loss_ber_success(double ber, size_t packet_size)
+{
+    double success = 1.0;
+    double factor = 1.0 - ber;
+    uint64_t nb_bits = 8 * (uint64_t)packet_size;
+
+    while (nb_bits > 0) {
+        if (nb_bits & 1) {
+            success *= factor;
+        }
+        factor *= factor;
+        nb_bits >>= 1;
+    }
+
+    return success;
+}
+
+static int dtn_loss_draw(dtn_loss_state_t* state, int direction)
+{
+    dtn_loss_model_t const* model = state->model;
+    uint64_t* random_ctx = &state->random_ctx[direction];
+    int is_lost = 0;
+
+    switch (model->type) {
+    case dtn_loss_bernoulli:
+        is_lost = dtn_loss_random(random_ctx) < model->loss_rate;
+        break;
+    case dtn_loss_gilbert_elliott:
+        if (state->is_bad[direction]) {
+            state->is_bad[direction] = !(dtn_loss_random(random_ctx) < model->p_bad_to_good);
+        }
+        else {
+            state->is_bad[direction] = dtn_loss_random(random_ctx) < model->p_good_to_bad;
+        }
+        is_lost = dtn_loss_random(random_ctx) < ((state->is_bad[direction]) ? model->loss_bad : model->loss_good);
+        break;
+    case dtn_loss_ber:
+        is_lost = dtn_loss_random(random_ctx) >= dtn_loss_ber_success(model->ber, state->last_packet_size[direction]);
+        break;
+    default:
+        break;
+    }
+
+    return is_lost;
+}
+
+/* Link rate divided by this factor when FEC is used */
+double dtn_fec_rate_factor(dtn_fec_t const* fec)
+{
+    double factor = 1.0;
+
+    if (fec->redundancy > 0) {
+        size_t block_size = (fec->block_size == 0) ? DTN_FEC_DEFAULT_BLOCK : fec->block_size;
+        size_t nb_repair = (size_t)(fec->redundancy * (double)block_size + 0.999999);
+
+        factor = ((double)(block_size + nb_repair)) / (double)block_size;
+    }
+
+    return factor;
+}
+
+/* Draw the fate of the packets of the next block, and keep the fate of
+ * the source packets after decoding */
+static void dtn_fec_draw_block(dtn_loss_state_t* state, int direction)
+{
+    uint8_t fate[2 * DTN_FEC_MAX_BLOCK];
+    size_t nb_lost = 0;
+    size_t nb_source_lost = 0;
+
+    for (size_t i = 0; i < state->fec_nb_source + state->fec_nb_repair; i++) {
+        fate[i] = (uint8_t)dtn_loss_draw(state, direction);
+        nb_lost += fate[i];
+        if (i < state->fec_nb_source) {
+            nb_source_lost += fate[i];
+        }
+    }
+    state->fec_blocks++;
+    if (nb_lost <= state->fec_nb_repair) {
+        memset(state->fec_fate[direction], 0, state->fec_nb_source);
+        state->fec_recovered += nb_source_lost;
+    }
+    else {
+        memcpy(state->fec_fate[direction], fate, state->fec_nb_source);
+    }
+    state->fec_index[direction] = 0;
+}
+
+static int dtn_loss_next_fate(dtn_loss_state_t* state, int direction)
+{
+    int is_lost;
+
+    if (state->fec_nb_source == 0) {
+        is_lost = dtn_loss_draw(state, direction);
+    }
+    else {
+        if (state->fec_index[direction] >= state->fec_nb_source) {
+            dtn_fec_draw_block(state, direction);
+        }
+        is_lost = state->fec_fate[direction][state->fec_index[direction]++];
+    }
+
+    return is_lost;
+}
+
+void dtn_loss_start(dtn_loss_state_t* state, dtn_loss_model_t const* model, dtn_fec_t const* fec)
+{
+    uint64_t seed = (model->seed == 0) ? DTN_LOSS_DEFAULT_SEED : model->seed;
+
+    memset(state, 0, sizeof(dtn_loss_state_t));
+    state->model = model;
+    state->blackout_mask = UINT64_MAX;
+    for (int d = 0; d < 2; d++) {
+        state->random_ctx[d] = seed ^ ((uint64_t)(d + 1) * 0x9E3779B97F4A7C15ull);
+        state->last_packet_size[d] = PICOQUIC_INITIAL_MTU_IPV4;
+    }
+    state->fec = fec;
+    if (fec != NULL && fec->redundancy > 0) {
+        state->fec_nb_source = (fec->block_size == 0) ? DTN_FEC_DEFAULT_BLOCK : fec->block_size;
+        if (state->fec_nb_source > DTN_FEC_MAX_BLOCK) {
+            state->fec_nb_source = DTN_FEC_MAX_BLOCK;
+        }
+        state->fec_nb_repair = (size_t)(fec->redundancy * (double)state->fec_nb_source + 0.999999);
+        if (state->fec_nb_repair > DTN_FEC_MAX_BLOCK) {
+            state->fec_nb_repair = DTN_FEC_MAX_BLOCK;
+        }
+        /* Start with a new block on each direction */
+        state->fec_index[0] = state->fec_nb_source;
+        state->fec_index[1] = state->fec_nb_source;
+    }
+}
+
+/* Set the loss masks of the links for the next round, and return the time
+ * of the next blackout boundary, or 0 if there is none. The links are not
+ * changed if they are down, e.g., outside of a contact window.
+ */
+uint64_t dtn_loss_update(dtn_loss_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time, int link_is_up)
+{
+    dtn_loss_model_t const* model = state->model;
+    picoquictest_sim_link_t* link[2];
+    uint64_t next_change = 0;
+    int in_blackout = 0;
+
+    if (model == NULL || (model->type == dtn_loss_none && model->nb_blackouts == 0)) {
+        return 0;
+    }
+
+    link[0] = test_ctx->c_to_s_link;
+    link[1] = test_ctx->s_to_c_link;
+
+    for (size_t i = 0; i < model->nb_blackouts; i++) {
+        if (simulated_time < model->blackouts[i].start_time) {
+            next_change = model->blackouts[i].start_time;
+            break;
+        }
+        else if (simulated_time < model->blackouts[i].end_time) {
+            in_blackout = 1;
+            next_change = model->blackouts[i].end_time;
+            break;
+        }
+    }
+
+    for (int d = 0; d < 2; d++) {
+        if (state->is_armed[d] && state->mask[d] != state->armed_mask[d]) {
+            /* The packet was submitted to the link */
+            state->nb_packets++;
+            if (state->armed_mask[d] & 1) {
+                state->nb_losses++;
+            }
+            state->is_armed[d] = 0;
+        }
+        if (link[d]->last_packet != NULL) {
+            state->last_packet_size[d] = link[d]->last_packet->length;
+        }
+        if (!link_is_up) {
+            continue;
+        }
+        if (in_blackout) {
+            link[d]->loss_mask = &state->blackout_mask;
+        }
+        else {
+            if (!state->is_armed[d]) {
+                state->armed_mask[d] = ((uint64_t)dtn_loss_next_fate(state, d)) | DTN_LOSS_MASK_MARKER;
+                state->is_armed[d] = 1;
+            }
+            state->mask[d] = state->armed_mask[d];
+            link[d]->loss_mask = &state->mask[d];
+        }
+    }
+
+    return next_change;
+}
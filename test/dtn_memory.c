@@ -0,0 +1,152 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Memory accounting of the DTN connections.
+ *
+ * With long RTT and large flow control credit, the sender has to keep a
+ * lot of data in memory until it is acknowledged. The harness samples the
+ * state of each connection during the simulation and estimates the memory
+ * used by:
+ *  - the connection context and its paths,
+ *  - the data queued on the streams, waiting to be sent or to be
+ *    reassembled,
+ *  - the packets waiting for acknowledgement, estimated from the bytes in
+ *    flight on each path, since each packet in the retransmission queue
+ *    keeps a full copy of the packet,
+ *  - the ranges of acknowledged packet numbers.
+ * The statistics keep the peak of each category, and the average of the
+ * total weighted by the simulated time.
+ */
+
+#ifdef _WINDOWS
+#include "wincompat.h"
+#else
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "delay_tolerant_internal.h"
+
+void dtn_memory_sample(picoquic_cnx_t* cnx, dtn_memory_sample_t* sample)
+{
+    memset(sample, 0, sizeof(dtn_memory_sample_t));
+
+    if (cnx != NULL) {
+        picoquic_stream_head_t* stream = picoquic_first_stream(cnx);
+
+        sample->cnx_bytes = sizeof(picoquic_cnx_t) + cnx->nb_paths * sizeof(picoquic_path_t);
+
+        while (stream != NULL) {
+            picoquic_stream_queue_node_t* node = stream->send_queue;
+
+            sample->cnx_bytes += sizeof(picoquic_stream_head_t);
+            while (node != NULL) {
+                sample->stream_bytes += sizeof(picoquic_stream_queue_node_t) + node->length;
+                node = node->next_stream_data;
+            }
+            /* Out of order data waiting for reassembly, counted as full packets */
+            sample->stream_bytes += ((size_t)stream->stream_data_tree.size) * PICOQUIC_MAX_PACKET_SIZE;
+            stream = picoquic_next_stream(stream);
+        }
+
+        for (int i = 0; i < cnx->nb_paths; i++) {
+            picoquic_path_t* path_x = cnx->path[i];
+
+            if (path_x != NULL && path_x->send_mtu > 0) {
+                uint64_t nb_packets = (path_x->bytes_in_flight + path_x->send_mtu - 1) / path_x->send_mtu;
+                sample->retransmit_bytes += (size_t)nb_packets * sizeof(picoquic_packet_t);
+            }
+        }
+
+        for (int pc = 0; pc < picoquic_nb_packet_context; pc++) {
+            sample->ack_range_bytes += ((size_t)cnx->ack_ctx[pc].sack_list.ack_tree.size) * sizeof(picoquic_sack_item_t);
+        }
+    }
+
+    sample->total_bytes = sample->cnx_bytes + sample->stream_bytes + sample->retransmit_bytes + sample->ack_range_bytes;
+}
+
+void dtn_memory_stats_update(dtn_memory_stats_t* stats, picoquic_cnx_t* cnx, uint64_t simulated_time)
+{
+    dtn_memory_sample_t sample;
+
+    dtn_memory_sample(cnx, &sample);
+
+    if (stats->nb_samples > 0 && simulated_time > stats->last_sample_time) {
+        /* The previous sample holds until this one */
+        stats->weighted_total += ((double)stats->last_total_bytes) * (double)(simulated_time - stats->last_sample_time);
+        stats->sampled_duration += simulated_time - stats->last_sample_time;
+    }
+    stats->nb_samples++;
+    stats->last_sample_time = simulated_time;
+    stats->last_total_bytes = sample.total_bytes;
+
+    if (sample.total_bytes > stats->peak.total_bytes) {
+        stats->peak.total_bytes = sample.total_bytes;
+        stats->peak_time = simulated_time;
+    }
+    if (sample.cnx_bytes > stats->peak.cnx_bytes) {
+        stats->peak.cnx_bytes = sample.cnx_bytes;
+    }
+    if (sample.stream_bytes > stats->peak.stream_bytes) {
+        stats->peak.stream_bytes = sample.stream_bytes;
+    }
+    if (sample.retransmit_bytes > stats->peak.retransmit_bytes) {
+        stats->peak.retransmit_bytes = sample.retransmit_bytes;
+    }
+    if (sample.ack_range_bytes > stats->peak.ack_range_bytes) {
+        stats->peak.ack_range_bytes = sample.ack_range_bytes;
+    }
+}
+
+size_t dtn_memory_stats_average(dtn_memory_stats_t const* stats)
+{
+    size_t average = stats->last_total_bytes;
+
+    if (stats->sampled_duration > 0) {
+        average = (size_t)(stats->weighted_total / (double)stats->sampled_duration);
+    }
+
+    return average;
+}
+
+/* Resident memory of the process, or 0 if not available on this platform */
+size_t dtn_process_memory()
+{
+    size_t rss = 0;
+#if defined(__linux__)
+    FILE* F = fopen("/proc/self/statm", "r");
+
+    if (F != NULL) {
+        unsigned long nb_pages_total = 0;
+        unsigned long nb_pages_resident = 0;
+        if (fscanf(F, "%lu %lu", &nb_pages_total, &nb_pages_resident) == 2) {
+            rss = (size_t)nb_pages_resident * (size_t)sysconf(_SC_PAGESIZE);
+        }
+        (void)fclose(F);
+    }
+#endif
+    return rss;
+}
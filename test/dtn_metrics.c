@@ -0,0 +1,175 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Live metrics.
+ *
+ * The sweeps and the stress runs report the results of each simulation
+ * when it ends, which for DTN latencies can take a long time. With live
+ * metrics on, each running simulation appends a snapshot of its state to
+ * the metrics file every interval of simulated time, so that a dashboard
+ * can tail the file, watch where the wall time goes, and let the operator
+ * stop the hopeless configurations early. The file has one JSON object
+ * per line:
+ *
+ *     {"test_id": 218, "test_seq": 0, "event": "snapshot", "sim_us": 70000000, "wall_us": 1500, ...}
+ *
+ * The snapshots carry the simulated and wall times, the bytes delivered
+ * to the client, the congestion window, smoothed RTT and bytes in transit
+ * of the server, the packet counts of both sides and the number of
+ * simulation rounds. When the simulation ends, a last line with the event
+ * "done" carries its return code.
+ *
+ * On the hot path, sampling is a comparison of the simulated time with the
+ * time of the next snapshot, which is 0 when the metrics are off. The
+ * snapshots of the parallel jobs are written under the lock of the sink,
+ * one line at a time, and flushed so that readers always see complete
+ * lines.
+ *
+ * The snapshots go to the sink of the spec, or by default to the sink
+ * opened with "-L". That one is opened by main before any test thread
+ * starts, and closed once they are all done. A test can check its own
+ * snapshots through a sink of its own, without touching the default.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+static dtn_metrics_sink_t dtn_metrics_file_sink;
+static dtn_metrics_sink_t* dtn_metrics_default_sink = NULL;
+
+int dtn_metrics_sink_open(dtn_metrics_sink_t* sink, char const* file_name, uint64_t interval)
+{
+    int ret = 0;
+
+    memset(sink, 0, sizeof(dtn_metrics_sink_t));
+    if (picoquic_create_mutex(&sink->lock) != 0) {
+        fprintf(stderr, "Cannot create the lock of the live metrics\n");
+        ret = -1;
+    }
+    else if ((sink->F = picoquic_file_open(file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        (void)picoquic_delete_mutex(&sink->lock);
+        ret = -1;
+    }
+    else {
+        sink->interval = (interval > 0) ? interval : DTN_METRICS_DEFAULT_INTERVAL;
+    }
+
+    return ret;
+}
+
+/* Only called once the simulations that write to the sink are done */
+void dtn_metrics_sink_close(dtn_metrics_sink_t* sink)
+{
+    if (sink->F != NULL) {
+        sink->F = picoquic_file_close(sink->F);
+        (void)picoquic_delete_mutex(&sink->lock);
+    }
+}
+
+int dtn_metrics_open(char const* file_name, uint64_t interval)
+{
+    int ret = dtn_metrics_sink_open(&dtn_metrics_file_sink, file_name, interval);
+
+    if (ret == 0) {
+        dtn_metrics_default_sink = &dtn_metrics_file_sink;
+    }
+
+    return ret;
+}
+
+void dtn_metrics_close(void)
+{
+    if (dtn_metrics_default_sink != NULL) {
+        dtn_metrics_sink_close(dtn_metrics_default_sink);
+        dtn_metrics_default_sink = NULL;
+    }
+}
+
+void dtn_metrics_start(dtn_metrics_state_t* state, dtn_metrics_sink_t* sink, uint8_t test_id, uint16_t test_seq,
+    uint64_t simulated_time)
+{
+    memset(state, 0, sizeof(dtn_metrics_state_t));
+    state->sink = (sink != NULL) ? sink : dtn_metrics_default_sink;
+    state->test_id = test_id;
+    state->test_seq = test_seq;
+    if (state->sink != NULL) {
+        state->next_time = simulated_time + state->sink->interval;
+        state->wall_time_start = picoquic_current_time();
+    }
+}
+
+static void dtn_metrics_snapshot(dtn_metrics_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time,
+    dtn_sim_profile_t const* profile)
+{
+    picoquic_path_quality_t quality;
+    picoquic_cnx_t* cnx_server = test_ctx->cnx_server;
+    picoquic_cnx_t* cnx_client = test_ctx->cnx_client;
+    uint64_t wall_time = picoquic_current_time() - state->wall_time_start;
+
+    memset(&quality, 0, sizeof(picoquic_path_quality_t));
+    if (cnx_server != NULL) {
+        picoquic_get_default_path_quality(cnx_server, &quality);
+    }
+    picoquic_lock_mutex(&state->sink->lock);
+    fprintf(state->sink->F, "{\"test_id\": %u, \"test_seq\": %u, \"event\": \"snapshot\", \"sim_us\": %" PRIu64
+        ", \"wall_us\": %" PRIu64 ", \"bytes_acked\": %" PRIu64 ", \"cwin\": %" PRIu64 ", \"rtt\": %" PRIu64
+        ", \"bytes_in_transit\": %" PRIu64 ", \"server_packets_sent\": %" PRIu64 ", \"client_packets_sent\": %" PRIu64
+        ", \"client_packets_received\": %" PRIu64 ", \"retransmissions\": %" PRIu64 ", \"rounds\": %" PRIu64 "}\n",
+        state->test_id, state->test_seq, simulated_time, wall_time,
+        (cnx_server == NULL) ? 0 : cnx_server->path[0]->delivered, quality.cwin, quality.rtt, quality.bytes_in_transit,
+        (cnx_server == NULL) ? 0 : cnx_server->nb_packets_sent, cnx_client->nb_packets_sent,
+        cnx_client->nb_packets_received, (cnx_server == NULL) ? 0 : cnx_server->nb_retransmission_total,
+        profile->nb_rounds);
+    fflush(state->sink->F);
+    picoquic_unlock_mutex(&state->sink->lock);
+}
+
+void dtn_metrics_sample(dtn_metrics_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time,
+    dtn_sim_profile_t const* profile)
+{
+    if (state->next_time != 0 && simulated_time >= state->next_time) {
+        dtn_metrics_snapshot(state, test_ctx, simulated_time, profile);
+        /* After a long jump of the simulated time, skip the missed snapshots */
+        state->next_time = simulated_time + state->sink->interval;
+    }
+}
+
+void dtn_metrics_finish(dtn_metrics_state_t* state, uint64_t simulated_time, int ret)
+{
+    if (state->next_time != 0) {
+        uint64_t wall_time = picoquic_current_time() - state->wall_time_start;
+
+        picoquic_lock_mutex(&state->sink->lock);
+        fprintf(state->sink->F, "{\"test_id\": %u, \"test_seq\": %u, \"event\": \"done\", \"sim_us\": %" PRIu64
+            ", \"wall_us\": %" PRIu64 ", \"ret\": %d}\n", state->test_id, state->test_seq, simulated_time,
+            wall_time, ret);
+        fflush(state->sink->F);
+        picoquic_unlock_mutex(&state->sink->lock);
+        state->next_time = 0;
+    }
+}
@@ -0,0 +1,126 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Known link MTU.
+ *
+ * By default, the client requires path MTU discovery. The probes take
+ * several round trips to converge, and at DTN latencies the connection
+ * sends minutes of data in packets of the initial size. The MTU of a
+ * deep space link is configured, not discovered, so the spec can give it
+ * as the largest UDP payload that the link carries. The harness then
+ * announces it in the max packet size transport parameter of both sides,
+ * which also bounds the discovery, and sets it as the send MTU of both
+ * connections once the handshake completes. The simulated links drop the
+ * packets larger than the link MTU.
+ *
+ * Picoquic is built with packet buffers of PICOQUIC_MAX_PACKET_SIZE
+ * bytes, so jumbo frames of optical links are capped at that size. The
+ * MTU cannot be lower than the size of the initial packets.
+ *
+ * During the transfer, the harness samples the send MTU of the server,
+ * to find the time at which it reached its final value.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+size_t dtn_mtu_effective(size_t link_mtu)
+{
+    size_t mtu = link_mtu;
+
+    if (mtu > PICOQUIC_MAX_PACKET_SIZE) {
+        mtu = PICOQUIC_MAX_PACKET_SIZE;
+    }
+    else if (mtu > 0 && mtu < PICOQUIC_ENFORCED_INITIAL_MTU) {
+        mtu = PICOQUIC_ENFORCED_INITIAL_MTU;
+    }
+
+    return mtu;
+}
+
+void dtn_mtu_set_parameters(picoquic_tp_t* tp, dtn_test_spec_t const* spec)
+{
+    size_t mtu = dtn_mtu_effective(spec->link_mtu);
+
+    if (mtu > 0) {
+        tp->max_packet_size = (uint32_t)mtu;
+    }
+}
+
+void dtn_mtu_start(dtn_mtu_state_t* state, dtn_test_spec_t const* spec)
+{
+    memset(state, 0, sizeof(dtn_mtu_state_t));
+    state->spec = spec;
+}
+
+static void dtn_mtu_set_path(picoquic_cnx_t* cnx, size_t mtu)
+{
+    if (cnx != NULL && cnx->nb_paths > 0 && cnx->path[0] != NULL) {
+        cnx->path[0]->send_mtu = mtu;
+    }
+}
+
+void dtn_mtu_apply(dtn_mtu_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    size_t mtu = dtn_mtu_effective(state->spec->link_mtu);
+
+    if (mtu > 0) {
+        dtn_mtu_set_path(test_ctx->cnx_client, mtu);
+        dtn_mtu_set_path(test_ctx->cnx_server, mtu);
+        test_ctx->c_to_s_link->path_mtu = mtu;
+        test_ctx->s_to_c_link->path_mtu = mtu;
+    }
+    state->is_started = 1;
+    state->start_time = simulated_time;
+    state->change_time = simulated_time;
+    state->send_mtu = 0;
+}
+
+void dtn_mtu_sample(dtn_mtu_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    picoquic_cnx_t* cnx = test_ctx->cnx_server;
+
+    if (state->is_started && cnx != NULL && cnx->nb_paths > 0 && cnx->path[0] != NULL) {
+        size_t send_mtu = cnx->path[0]->send_mtu;
+
+        if (send_mtu != state->send_mtu) {
+            if (state->send_mtu != 0) {
+                state->change_time = simulated_time;
+            }
+            state->send_mtu = send_mtu;
+        }
+    }
+}
+
+void dtn_mtu_finish(dtn_mtu_state_t* state, dtn_test_result_t* result)
+{
+    if (state->is_started && result != NULL) {
+        result->link_mtu = dtn_mtu_effective(state->spec->link_mtu);
+        result->send_mtu = state->send_mtu;
+        result->mtu_convergence_time = state->change_time - state->start_time;
+    }
+}
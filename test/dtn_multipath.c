@@ -0,0 +1,412 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Multipath scenarios.
+ *
+ * A spacecraft is often reachable through more than one relay, for
+ * example an orbiter relay and a direct to Earth link, each with its own
+ * latency, rates and contact plan. The test_api context of picoquictest
+ * only wires one pair of links, so, as in the scaling test, the
+ * multipath test creates its own QUIC contexts and runs its own
+ * simulation loop, with the helpers of dtn_sim.c and one pair of links
+ * per path. Each path has its own client address. The packets sent by
+ * the client are routed by source address, those sent by the server by
+ * destination address.
+ *
+ * The client downloads one object on stream 4 with multipath enabled.
+ * The first path is set up by the handshake, the others are probed by
+ * the client once the connection is ready. A path follows its contact
+ * plan if it has one, and is always up otherwise. Packets sent while a
+ * path is down are lost. The test measures the total goodput, the
+ * share of the data carried by each path, and, when a path fails
+ * during the transfer, the longest gap in the data received after the
+ * failure.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_MULTIPATH_STREAM_ID 4
+#define DTN_MULTIPATH_CLIENT_PORT 1234
+
+typedef struct st_dtn_mp_path_t {
+    dtn_relay_path_t const* relay;
+    picoquictest_sim_link_t* c_to_s_link;
+    picoquictest_sim_link_t* s_to_c_link;
+    struct sockaddr_storage client_addr;
+    size_t current;
+    int is_up;
+    int is_probed;
+    uint64_t bytes_down;
+    uint64_t packets_lost;
+} dtn_mp_path_t;
+
+typedef struct st_dtn_mp_ctx_t {
+    dtn_multipath_spec_t const* spec;
+    uint64_t simulated_time;
+    dtn_sim_quic_t sim;
+    picoquic_cnx_t* cnx_client;
+    struct sockaddr_storage server_addr;
+    dtn_mp_path_t path[DTN_MULTIPATH_MAX_PATHS];
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t last_data_time;
+    uint64_t failure_time;
+    uint64_t failover_stall;
+    uint64_t done_time;
+    int is_done;
+    int error_detected;
+} dtn_mp_ctx_t;
+
+static int dtn_mp_server_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_mp_ctx_t* ctx = (dtn_mp_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_fin && stream_id == DTN_MULTIPATH_STREAM_ID) {
+        /* The request is complete, the data is provided as packets are prepared */
+        ret = picoquic_mark_active_stream(cnx, stream_id, 1, NULL);
+    }
+    else if (fin_or_event == picoquic_callback_prepare_to_send) {
+        uint64_t remaining = ctx->spec->object_size - ctx->bytes_sent;
+        size_t sent = (length < remaining) ? length : (size_t)remaining;
+        int is_fin = (sent == remaining);
+        uint8_t* buffer = picoquic_provide_stream_data_buffer(bytes, sent, is_fin, !is_fin);
+
+        if (buffer == NULL) {
+            ctx->error_detected = 1;
+            ret = -1;
+        }
+        else {
+            memset(buffer, 0x5a, sent);
+            ctx->bytes_sent += sent;
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_mp_client_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_mp_ctx_t* ctx = (dtn_mp_ctx_t*)callback_ctx;
+
+    (void)cnx;
+    (void)bytes;
+    (void)v_stream_ctx;
+
+    if ((fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) &&
+        stream_id == DTN_MULTIPATH_STREAM_ID) {
+        if (length > 0) {
+            if (ctx->failure_time > 0) {
+                uint64_t since = (ctx->last_data_time > ctx->failure_time) ? ctx->last_data_time : ctx->failure_time;
+
+                if (ctx->simulated_time - since > ctx->failover_stall) {
+                    ctx->failover_stall = ctx->simulated_time - since;
+                }
+            }
+            ctx->last_data_time = ctx->simulated_time;
+            ctx->bytes_received += length;
+        }
+        if (fin_or_event == picoquic_callback_stream_fin && !ctx->is_done) {
+            ctx->is_done = 1;
+            ctx->done_time = ctx->simulated_time;
+            if (ctx->bytes_received != ctx->spec->object_size) {
+                ctx->error_detected = 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void dtn_mp_delete_ctx(dtn_mp_ctx_t* ctx)
+{
+    dtn_sim_delete_quic(&ctx->sim);
+    for (size_t i = 0; i < DTN_MULTIPATH_MAX_PATHS; i++) {
+        if (ctx->path[i].c_to_s_link != NULL) {
+            picoquictest_sim_link_delete(ctx->path[i].c_to_s_link);
+        }
+        if (ctx->path[i].s_to_c_link != NULL) {
+            picoquictest_sim_link_delete(ctx->path[i].s_to_c_link);
+        }
+    }
+    free(ctx);
+}
+
+static uint64_t dtn_mp_max_latency(dtn_multipath_spec_t const* spec)
+{
+    uint64_t max_latency = 0;
+
+    for (size_t i = 0; i < spec->nb_paths; i++) {
+        dtn_relay_path_t const* relay = &spec->path[i];
+
+        if (relay->latency > max_latency) {
+            max_latency = relay->latency;
+        }
+        for (size_t j = 0; j < relay->nb_contacts; j++) {
+            if (relay->contact_plan[j].latency > max_latency) {
+                max_latency = relay->contact_plan[j].latency;
+            }
+        }
+    }
+
+    return max_latency;
+}
+
+static dtn_mp_ctx_t* dtn_mp_create_ctx(dtn_multipath_spec_t const* spec)
+{
+    int ret = 0;
+    dtn_mp_ctx_t* ctx = (dtn_mp_ctx_t*)calloc(1, sizeof(dtn_mp_ctx_t));
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->spec = spec;
+    ((struct sockaddr_in*)&ctx->server_addr)->sin_family = AF_INET;
+    ((struct sockaddr_in*)&ctx->server_addr)->sin_port = htons(4433);
+
+    ret = dtn_sim_create_quic(&ctx->sim, 4, dtn_mp_server_callback, dtn_mp_client_callback, ctx, &ctx->simulated_time);
+
+    for (size_t i = 0; ret == 0 && i < spec->nb_paths; i++) {
+        dtn_mp_path_t* path = &ctx->path[i];
+
+        path->relay = &spec->path[i];
+        ((struct sockaddr_in*)&path->client_addr)->sin_family = AF_INET;
+        ((struct sockaddr_in*)&path->client_addr)->sin_port = htons((uint16_t)(DTN_MULTIPATH_CLIENT_PORT + i));
+        path->c_to_s_link = picoquictest_sim_link_create(path->relay->mbps_up / 1000.0, path->relay->latency, NULL, 0, ctx->simulated_time);
+        path->s_to_c_link = picoquictest_sim_link_create(path->relay->mbps_down / 1000.0, path->relay->latency, NULL, 0, ctx->simulated_time);
+        if (path->c_to_s_link == NULL || path->s_to_c_link == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        dtn_sim_set_transport(&ctx->sim, spec->ccalgo, dtn_mp_max_latency(spec) * 5,
+            (spec->nb_paths > 1) ? DTN_MULTIPATH_MAX_PATHS : 0);
+        ctx->cnx_client = picoquic_create_cnx(ctx->sim.qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1,
+            PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+        if (ctx->cnx_client == NULL) {
+            ret = -1;
+        }
+        else {
+            uint8_t request[257];
+
+            memset(request, 0x5c, sizeof(request));
+            ret = picoquic_add_to_stream(ctx->cnx_client, DTN_MULTIPATH_STREAM_ID, request, sizeof(request), 1);
+            if (ret == 0) {
+                ret = picoquic_start_client_cnx(ctx->cnx_client);
+            }
+        }
+    }
+
+    if (ret != 0) {
+        dtn_mp_delete_ctx(ctx);
+        ctx = NULL;
+    }
+
+    return ctx;
+}
+
+/* Follow the contact plan of the path, and return the time of the next
+ * change of the plan, or 0 if there is none. */
+static uint64_t dtn_mp_path_update(dtn_mp_ctx_t* ctx, dtn_mp_path_t* path)
+{
+    dtn_relay_path_t const* relay = path->relay;
+    uint64_t next_change = 0;
+    int was_up = path->is_up;
+
+    if (relay->nb_contacts == 0) {
+        path->is_up = 1;
+        return 0;
+    }
+
+    while (path->current < relay->nb_contacts && ctx->simulated_time >= relay->contact_plan[path->current].end_time) {
+        path->current++;
+    }
+    path->is_up = 0;
+    if (path->current < relay->nb_contacts) {
+        dtn_contact_t const* contact = &relay->contact_plan[path->current];
+
+        if (ctx->simulated_time >= contact->start_time) {
+            path->is_up = 1;
+            dtn_sim_link_set(path->c_to_s_link, contact->latency, contact->mbps_up);
+            dtn_sim_link_set(path->s_to_c_link, contact->latency, contact->mbps_down);
+            next_change = contact->end_time;
+        }
+        else {
+            next_change = contact->start_time;
+        }
+    }
+    if (was_up && !path->is_up && ctx->bytes_received > 0 && !ctx->is_done && ctx->failure_time == 0) {
+        ctx->failure_time = ctx->simulated_time;
+    }
+
+    return next_change;
+}
+
+/* Path of a packet, found by the address of the client, path 0 by default */
+static dtn_mp_path_t* dtn_mp_find_path(dtn_mp_ctx_t* ctx, struct sockaddr_storage const* client_addr)
+{
+    dtn_mp_path_t* path = &ctx->path[0];
+
+    for (size_t i = 1; i < ctx->spec->nb_paths; i++) {
+        if (picoquic_compare_addr((struct sockaddr*)&ctx->path[i].client_addr, (struct sockaddr*)client_addr) == 0) {
+            path = &ctx->path[i];
+            break;
+        }
+    }
+
+    return path;
+}
+
+/* Prepare the next packet of one of the QUIC contexts and submit it to the link of its path */
+static int dtn_mp_prepare(dtn_mp_ctx_t* ctx, picoquic_quic_t* quic, int is_client)
+{
+    picoquictest_sim_packet_t* packet;
+    int ret = dtn_sim_prepare(quic, ctx->simulated_time, (is_client) ? &ctx->path[0].client_addr : &ctx->server_addr,
+        &packet);
+
+    if (ret == 0 && packet != NULL) {
+        dtn_mp_path_t* path = dtn_mp_find_path(ctx, (is_client) ? &packet->addr_from : &packet->addr_to);
+
+        if (path->is_up) {
+            picoquictest_sim_link_submit((is_client) ? path->c_to_s_link : path->s_to_c_link, packet, ctx->simulated_time);
+        }
+        else {
+            path->packets_lost++;
+            free(packet);
+        }
+    }
+
+    return ret;
+}
+
+/* Once the connection is ready, the client probes the other paths. The
+ * probe fails until the server has provided enough connection IDs, in
+ * which case it is tried again on the next round. */
+static void dtn_mp_probe_paths(dtn_mp_ctx_t* ctx)
+{
+    if (ctx->cnx_client->cnx_state == picoquic_state_ready || ctx->cnx_client->cnx_state == picoquic_state_client_ready_start) {
+        for (size_t i = 1; i < ctx->spec->nb_paths; i++) {
+            if (!ctx->path[i].is_probed && ctx->path[i].is_up &&
+                picoquic_probe_new_path(ctx->cnx_client, (struct sockaddr*)&ctx->server_addr,
+                    (struct sockaddr*)&ctx->path[i].client_addr, ctx->simulated_time) == 0) {
+                ctx->path[i].is_probed = 1;
+            }
+        }
+    }
+}
+
+static int dtn_mp_loop(dtn_mp_ctx_t* ctx)
+{
+    int ret = 0;
+    uint64_t max_time = ctx->spec->max_completion_time;
+
+    while (ret == 0 && !ctx->is_done && !ctx->error_detected && ctx->simulated_time < max_time &&
+        ctx->cnx_client->cnx_state != picoquic_state_disconnected) {
+        uint64_t next_time = dtn_sim_next_wake_time(ctx->sim.qclient, ctx->simulated_time + max_time);
+
+        next_time = dtn_sim_next_wake_time(ctx->sim.qserver, next_time);
+        for (size_t i = 0; i < ctx->spec->nb_paths; i++) {
+            uint64_t next_change = dtn_mp_path_update(ctx, &ctx->path[i]);
+
+            if (next_change > ctx->simulated_time && next_change < next_time) {
+                next_time = next_change;
+            }
+            next_time = picoquictest_sim_link_next_arrival(ctx->path[i].c_to_s_link, next_time);
+            next_time = picoquictest_sim_link_next_arrival(ctx->path[i].s_to_c_link, next_time);
+        }
+        if (next_time > ctx->simulated_time) {
+            ctx->simulated_time = next_time;
+        }
+        for (size_t i = 0; ret == 0 && i < ctx->spec->nb_paths; i++) {
+            (void)dtn_mp_path_update(ctx, &ctx->path[i]);
+            ret = dtn_sim_deliver(ctx->sim.qserver, ctx->path[i].c_to_s_link, ctx->simulated_time, NULL, NULL);
+            if (ret == 0) {
+                ret = dtn_sim_deliver(ctx->sim.qclient, ctx->path[i].s_to_c_link, ctx->simulated_time, NULL,
+                    &ctx->path[i].bytes_down);
+            }
+        }
+        if (ret == 0) {
+            dtn_mp_probe_paths(ctx);
+        }
+        if (ret == 0 && dtn_sim_is_awake(ctx->sim.qserver, ctx->simulated_time)) {
+            ret = dtn_mp_prepare(ctx, ctx->sim.qserver, 0);
+        }
+        if (ret == 0 && dtn_sim_is_awake(ctx->sim.qclient, ctx->simulated_time)) {
+            ret = dtn_mp_prepare(ctx, ctx->sim.qclient, 1);
+        }
+    }
+
+    if (ret == 0 && (!ctx->is_done || ctx->error_detected)) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int dtn_multipath_test_one(dtn_multipath_spec_t const* spec, dtn_multipath_result_t* result)
+{
+    int ret = 0;
+    uint64_t wall_time_start = picoquic_current_time();
+    dtn_mp_ctx_t* ctx = NULL;
+
+    memset(result, 0, sizeof(dtn_multipath_result_t));
+    if (spec->nb_paths == 0 || spec->nb_paths > DTN_MULTIPATH_MAX_PATHS) {
+        DBG_PRINTF("Spec has %" PRIst " paths, max is %d", spec->nb_paths, DTN_MULTIPATH_MAX_PATHS);
+        ret = -1;
+    }
+    else if ((ctx = dtn_mp_create_ctx(spec)) == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = dtn_mp_loop(ctx);
+        result->completion_time = (ctx->is_done) ? ctx->done_time : ctx->simulated_time;
+        result->bytes_received = ctx->bytes_received;
+        if (result->completion_time > 0) {
+            result->goodput_mbps = ((double)ctx->bytes_received * 8.0) / (double)result->completion_time;
+        }
+        for (size_t i = 0; i < spec->nb_paths; i++) {
+            result->path_bytes_down[i] = ctx->path[i].bytes_down;
+            result->path_packets_lost[i] = ctx->path[i].packets_lost;
+        }
+        result->failure_time = ctx->failure_time;
+        result->failover_stall = ctx->failover_stall;
+        dtn_mp_delete_ctx(ctx);
+    }
+    result->ret = ret;
+    result->wall_time = picoquic_current_time() - wall_time_start;
+
+    return ret;
+}
@@ -0,0 +1,545 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Large object download from a memory mapped file.
+ *
+ * The default test application of tls_api_one_scenario_body allocates
+ * the whole response in memory, and picoquic_add_to_stream copies it
+ * again in the send queue of the stream. That does not scale to the
+ * multi gigabyte files of image and science data downlinks. In the
+ * object scenario, the client sends a request on stream 4, and the server
+ * answers with the content of a file. The server marks the stream active
+ * and provides the data when picoquic prepares a packet, with
+ * picoquic_provide_stream_data_buffer, copying the bytes straight from
+ * the mapped file into the packet. Nothing is queued on the stream.
+ *
+ * The file is mapped one view of DTN_OBJECT_VIEW_SIZE bytes at a time,
+ * and the view moves forward as the data is sent. Retransmissions are
+ * made from the copies of the packets kept by picoquic, so the data
+ * behind the view is never needed again. The memory used by the server
+ * is thus bounded by the view and the data in flight, whatever the size
+ * of the object.
+ *
+ * The client does not keep the data either. Both sides compute a
+ * checksum of the bytes in stream order, and the client compares its
+ * count and checksum with those of the server at the end. If the spec
+ * does not name a file, a temporary one is created. It is sparse, with
+ * the offset stamped every DTN_OBJECT_STAMP_INTERVAL bytes so that the
+ * checksum catches misplaced data.
+ *
+ * The request starts with the offset from which the object is sent, in
+ * network order, 0 for a new download. With a journal, the client
+ * records its offset and checksum every journal interval. After a
+ * restart, it reads them back from the journal, and requests the rest
+ * of the object. The server does not keep any state between connections:
+ * it computes the checksum of the data before the offset from the file,
+ * so the checksums can still be compared at the end.
+ */
+
+#ifdef _WINDOWS
+#include "wincompat.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_OBJECT_STREAM_ID 4
+#define DTN_OBJECT_REQUEST_SIZE 257
+#define DTN_OBJECT_STAMP_INTERVAL ((uint64_t)1024 * 1024)
+#define DTN_OBJECT_FNV_OFFSET 0xcbf29ce484222325ull
+#define DTN_OBJECT_FNV_PRIME 0x100000001b3ull
+
+static uint64_t dtn_object_checksum(uint64_t checksum, uint8_t const* bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        checksum ^= bytes[i];
+        checksum *= DTN_OBJECT_FNV_PRIME;
+    }
+
+    return checksum;
+}
+
+/* Seek with 64 bit offsets, long is only 32 bits on Windows */
+int dtn_object_seek(FILE* F, uint64_t offset)
+{
+#ifdef _WINDOWS
+    return _fseeki64(F, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(F, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static int dtn_object_create_file(char const* file_name, uint64_t size)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "wb");
+
+    if (F == NULL) {
+        DBG_PRINTF("Cannot create %s", file_name);
+        ret = -1;
+    }
+    else {
+        for (uint64_t offset = 0; ret == 0 && offset + 8 <= size; offset += DTN_OBJECT_STAMP_INTERVAL) {
+            uint8_t stamp[8];
+
+            for (int i = 0; i < 8; i++) {
+                stamp[i] = (uint8_t)(offset >> (56 - 8 * i));
+            }
+            if (dtn_object_seek(F, offset) != 0 || fwrite(stamp, 1, sizeof(stamp), F) != sizeof(stamp)) {
+                ret = -1;
+            }
+        }
+        if (ret == 0 && size > 0) {
+            /* Set the size of the file, the rest is a hole */
+            uint8_t last = 0xff;
+
+            if (dtn_object_seek(F, size - 1) != 0 || fwrite(&last, 1, 1, F) != 1) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Cannot write %s", file_name);
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+static int dtn_object_file_open(dtn_object_file_t* file, char const* file_name)
+{
+    int ret = 0;
+
+    memset(file, 0, sizeof(dtn_object_file_t));
+#ifdef _WINDOWS
+    file->h_file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->h_file == INVALID_HANDLE_VALUE) {
+        ret = -1;
+    }
+    else {
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(file->h_file, &file_size) ||
+            (file->h_map = CreateFileMappingA(file->h_file, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL) {
+            ret = -1;
+        }
+        else {
+            file->size = (uint64_t)file_size.QuadPart;
+        }
+    }
+#else
+    struct stat st;
+
+    if ((file->fd = open(file_name, O_RDONLY)) < 0) {
+        ret = -1;
+    }
+    else if (fstat(file->fd, &st) != 0) {
+        ret = -1;
+    }
+    else {
+        file->size = (uint64_t)st.st_size;
+    }
+#endif
+    if (ret != 0) {
+        DBG_PRINTF("Cannot map %s", file_name);
+    }
+
+    return ret;
+}
+
+static void dtn_object_file_unmap(dtn_object_file_t* file)
+{
+    if (file->view != NULL) {
+#ifdef _WINDOWS
+        (void)UnmapViewOfFile(file->view);
+#else
+        (void)munmap(file->view, file->view_size);
+#endif
+        file->view = NULL;
+        file->view_size = 0;
+    }
+}
+
+static void dtn_object_file_close(dtn_object_file_t* file)
+{
+    dtn_object_file_unmap(file);
+#ifdef _WINDOWS
+    if (file->h_map != NULL) {
+        (void)CloseHandle(file->h_map);
+        file->h_map = NULL;
+    }
+    if (file->h_file != NULL && file->h_file != INVALID_HANDLE_VALUE) {
+        (void)CloseHandle(file->h_file);
+    }
+    file->h_file = NULL;
+#else
+    if (file->fd >= 0) {
+        (void)close(file->fd);
+    }
+    file->fd = -1;
+#endif
+}
+
+/* Return the mapped bytes at the offset, and the number of bytes available
+ * in the current view. The view only moves forward. */
+static uint8_t const* dtn_object_file_get(dtn_object_file_t* file, uint64_t offset, size_t* available)
+{
+    uint8_t const* bytes = NULL;
+
+    *available = 0;
+    if (offset < file->size) {
+        if (file->view == NULL || offset < file->view_offset || offset >= file->view_offset + file->view_size) {
+            uint64_t view_offset = offset - (offset % DTN_OBJECT_VIEW_SIZE);
+            size_t view_size = (size_t)((file->size - view_offset < DTN_OBJECT_VIEW_SIZE) ?
+                file->size - view_offset : DTN_OBJECT_VIEW_SIZE);
+
+            dtn_object_file_unmap(file);
+#ifdef _WINDOWS
+            file->view = (uint8_t*)MapViewOfFile(file->h_map, FILE_MAP_READ,
+                (DWORD)(view_offset >> 32), (DWORD)(view_offset & 0xffffffff), view_size);
+#else
+            file->view = (uint8_t*)mmap(NULL, view_size, PROT_READ, MAP_SHARED, file->fd, (off_t)view_offset);
+            if (file->view == (uint8_t*)MAP_FAILED) {
+                file->view = NULL;
+            }
+            else {
+                (void)madvise(file->view, view_size, MADV_SEQUENTIAL);
+            }
+#endif
+            if (file->view != NULL) {
+                file->view_offset = view_offset;
+                file->view_size = view_size;
+            }
+        }
+        if (file->view != NULL) {
+            bytes = file->view + (offset - file->view_offset);
+            *available = (size_t)(file->view_offset + file->view_size - offset);
+        }
+    }
+
+    return bytes;
+}
+
+static void dtn_object_encode_offset(uint8_t* bytes, uint64_t offset)
+{
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(offset >> (56 - 8 * i));
+    }
+}
+
+/* Position the server at the offset found in the request */
+static int dtn_object_start_at(dtn_object_ctx_t* object, uint8_t const* header)
+{
+    int ret = 0;
+    uint64_t offset = 0;
+
+    for (int i = 0; i < 8; i++) {
+        offset = (offset << 8) | header[i];
+    }
+    if (object->request_header_length < 8 || offset > object->file.size) {
+        DBG_PRINTF("Invalid request, offset %" PRIu64 " for %" PRIu64 " bytes", offset, object->file.size);
+        object->error_detected = 1;
+        ret = -1;
+    }
+    else {
+        object->sent_offset = 0;
+        object->sent_checksum = DTN_OBJECT_FNV_OFFSET;
+        while (ret == 0 && object->sent_offset < offset) {
+            size_t available = 0;
+            uint8_t const* data = dtn_object_file_get(&object->file, object->sent_offset, &available);
+
+            if (data == NULL) {
+                object->error_detected = 1;
+                ret = -1;
+            }
+            else {
+                if (available > offset - object->sent_offset) {
+                    available = (size_t)(offset - object->sent_offset);
+                }
+                object->sent_checksum = dtn_object_checksum(object->sent_checksum, data, available);
+                object->sent_offset += available;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_object_server_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_object_ctx_t* object = (dtn_object_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)v_stream_ctx;
+
+    switch (fin_or_event) {
+    case picoquic_callback_stream_data:
+    case picoquic_callback_stream_fin:
+        if (stream_id == DTN_OBJECT_STREAM_ID) {
+            for (size_t i = 0; i < length && object->request_header_length < sizeof(object->request_header); i++) {
+                object->request_header[object->request_header_length++] = bytes[i];
+            }
+            if (fin_or_event == picoquic_callback_stream_fin) {
+                /* Request received, start sending the object from the requested offset */
+                ret = dtn_object_start_at(object, object->request_header);
+                if (ret == 0) {
+                    ret = picoquic_mark_active_stream(cnx, stream_id, 1, NULL);
+                }
+                object->request_header_length = 0;
+            }
+        }
+        break;
+    case picoquic_callback_prepare_to_send: {
+        uint64_t remaining = object->file.size - object->sent_offset;
+        size_t available = 0;
+        uint8_t const* data = dtn_object_file_get(&object->file, object->sent_offset, &available);
+
+        if (data == NULL) {
+            object->error_detected = 1;
+            ret = -1;
+        }
+        else {
+            size_t sent = length;
+            int is_fin;
+            uint8_t* buffer;
+
+            if (sent > available) {
+                sent = available;
+            }
+            if (sent > remaining) {
+                sent = (size_t)remaining;
+            }
+            is_fin = (sent == remaining);
+            buffer = picoquic_provide_stream_data_buffer(bytes, sent, is_fin, !is_fin);
+            if (buffer == NULL) {
+                object->error_detected = 1;
+                ret = -1;
+            }
+            else {
+                memcpy(buffer, data, sent);
+                object->sent_checksum = dtn_object_checksum(object->sent_checksum, data, sent);
+                object->sent_offset += sent;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static int dtn_object_client_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_object_ctx_t* object = (dtn_object_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)v_stream_ctx;
+
+    if (object->is_crashed) {
+        /* The process is down, nothing is received */
+    }
+    else if ((fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) &&
+        stream_id == DTN_OBJECT_STREAM_ID) {
+        if (length > 0 && object->restart_time > 0 && object->resume_first_byte_time == 0) {
+            object->resume_first_byte_time = picoquic_get_quic_time(cnx->quic);
+        }
+        object->received_checksum = dtn_object_checksum(object->received_checksum, bytes, length);
+        object->received_offset += length;
+        if (object->has_journal && (fin_or_event == picoquic_callback_stream_fin ||
+            object->received_offset - object->journaled_offset >= object->journal_interval)) {
+            ret = dtn_journal_record(&object->journal, stream_id, object->received_offset, object->received_checksum);
+            object->journaled_offset = object->received_offset;
+        }
+        if (fin_or_event == picoquic_callback_stream_fin) {
+            object->is_complete = 1;
+            object->test_ctx->test_finished = 1;
+        }
+        else if (object->restart_offset > 0 && object->received_offset >= object->restart_offset) {
+            /* Simulated crash, the data received since the last journal record is lost */
+            object->is_crashed = 1;
+            object->crash_offset = object->received_offset;
+            object->test_ctx->test_finished = 1;
+        }
+    }
+    else if (fin_or_event == picoquic_callback_stream_reset) {
+        object->error_detected = 1;
+    }
+    if (ret != 0) {
+        object->error_detected = 1;
+    }
+
+    return ret;
+}
+
+int dtn_object_init(dtn_object_ctx_t* object, dtn_test_spec_t const* spec, uint8_t test_id, uint16_t test_seq)
+{
+    int ret = 0;
+    char const* file_name = spec->object_file;
+
+    memset(object, 0, sizeof(dtn_object_ctx_t));
+#ifndef _WINDOWS
+    object->file.fd = -1;
+#endif
+    object->sent_checksum = DTN_OBJECT_FNV_OFFSET;
+    object->received_checksum = DTN_OBJECT_FNV_OFFSET;
+
+    if (file_name == NULL) {
+        (void)picoquic_sprintf(object->file_name, sizeof(object->file_name), NULL,
+            "dtn_object_%02x_%04x.bin", test_id, test_seq);
+        file_name = object->file_name;
+        object->is_temporary = 1;
+        ret = dtn_object_create_file(file_name, spec->object_size);
+    }
+    if (ret == 0) {
+        ret = dtn_object_file_open(&object->file, file_name);
+    }
+    if (ret == 0 && (spec->journal_file != NULL || spec->restart_offset > 0)) {
+        char const* journal_name = spec->journal_file;
+
+        if (journal_name == NULL) {
+            (void)picoquic_sprintf(object->journal_name, sizeof(object->journal_name), NULL,
+                "dtn_journal_%02x_%04x.bin", test_id, test_seq);
+            journal_name = object->journal_name;
+            object->is_journal_temporary = 1;
+        }
+        /* Each test starts a new download */
+        (void)remove(journal_name);
+        object->has_journal = 1;
+        object->is_journal_sync = spec->journal_sync;
+        object->journal_interval = (spec->journal_interval > 0) ? spec->journal_interval : DTN_JOURNAL_DEFAULT_INTERVAL;
+        object->restart_offset = spec->restart_offset;
+        ret = dtn_journal_open(&object->journal, journal_name, object->is_journal_sync);
+    }
+
+    return ret;
+}
+
+/* Replace the test application by the object transfer, once the
+ * connections are established, and queue the request */
+int dtn_object_attach(dtn_object_ctx_t* object, picoquic_test_tls_api_ctx_t* test_ctx)
+{
+    uint8_t request[DTN_OBJECT_REQUEST_SIZE];
+
+    object->test_ctx = test_ctx;
+    memset(request, 'r', sizeof(request));
+    dtn_object_encode_offset(request, object->received_offset);
+    picoquic_set_callback(test_ctx->cnx_client, dtn_object_client_callback, object);
+    picoquic_set_callback(test_ctx->cnx_server, dtn_object_server_callback, object);
+
+    return picoquic_add_to_stream(test_ctx->cnx_client, DTN_OBJECT_STREAM_ID, request, sizeof(request), 1);
+}
+
+int dtn_object_verify(dtn_object_ctx_t* object, dtn_test_result_t* result)
+{
+    int ret = 0;
+
+    if (!object->is_complete || object->error_detected) {
+        DBG_PRINTF("Object transfer incomplete, %" PRIu64 " of %" PRIu64 " bytes",
+            object->received_offset, object->file.size);
+        ret = -1;
+    }
+    else if (object->received_offset != object->file.size || object->sent_offset != object->file.size ||
+        object->received_checksum != object->sent_checksum) {
+        DBG_PRINTF("Object received %" PRIu64 " bytes, sent %" PRIu64 ", checksum %s",
+            object->received_offset, object->sent_offset,
+            (object->received_checksum == object->sent_checksum) ? "ok" : "mismatch");
+        ret = -1;
+    }
+    if (result != NULL) {
+        result->object_bytes_received = object->received_offset;
+        result->object_verified = (ret == 0);
+        if (object->has_journal) {
+            result->journal_records = object->journal.nb_records;
+            result->journal_bytes = object->journal.bytes_written;
+            result->journal_write_time = object->journal.write_wall_time;
+        }
+    }
+
+    return ret;
+}
+
+/* Restart of the client process after a crash. Everything not in the
+ * journal is forgotten, and the download will resume from the journaled
+ * offset. The resume latency runs from the restart to the first new byte.
+ */
+int dtn_object_restart(dtn_object_ctx_t* object, uint64_t simulated_time)
+{
+    int ret = 0;
+    char journal_name[sizeof(object->journal.file_name)];
+    dtn_journal_entry_t const* entry;
+    uint64_t nb_records = object->journal.nb_records;
+    uint64_t bytes_written = object->journal.bytes_written;
+    uint64_t write_wall_time = object->journal.write_wall_time;
+
+    memcpy(journal_name, object->journal.file_name, sizeof(journal_name));
+    dtn_journal_close(&object->journal);
+    ret = dtn_journal_open(&object->journal, journal_name, object->is_journal_sync);
+    /* Keep the write statistics of the whole download */
+    object->journal.nb_records += nb_records;
+    object->journal.bytes_written += bytes_written;
+    object->journal.write_wall_time += write_wall_time;
+
+    object->received_offset = 0;
+    object->received_checksum = DTN_OBJECT_FNV_OFFSET;
+    if (ret == 0 && (entry = dtn_journal_find(&object->journal, DTN_OBJECT_STREAM_ID)) != NULL) {
+        object->received_offset = entry->offset;
+        object->received_checksum = entry->checksum;
+    }
+    object->journaled_offset = object->received_offset;
+    object->resume_offset = object->received_offset;
+    object->restart_offset = 0;
+    object->is_crashed = 0;
+    object->is_complete = 0;
+    object->restart_time = simulated_time;
+    object->resume_first_byte_time = 0;
+
+    return ret;
+}
+
+void dtn_object_release(dtn_object_ctx_t* object)
+{
+    dtn_object_file_close(&object->file);
+    if (object->has_journal) {
+        dtn_journal_close(&object->journal);
+        if (object->is_journal_temporary) {
+            (void)remove(object->journal_name);
+        }
+        object->has_journal = 0;
+    }
+    if (object->is_temporary) {
+        (void)remove(object->file_name);
+        object->is_temporary = 0;
+    }
+}
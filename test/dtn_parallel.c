@@ -0,0 +1,149 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Execution of independent jobs on a pool of worker threads.
+ * Each DTN simulation builds its own test context and simulated clock,
+ * so independent simulations can run in separate threads. The workers
+ * pick the next job index under a lock, and the job function stores
+ * its result in the caller's context, indexed by the job number. The
+ * callers report the results in job order once all workers are done,
+ * so that the output does not depend on the scheduling.
+ */
+
+#ifdef _WINDOWS
+#include "wincompat.h"
+#else
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+
+typedef struct st_dtn_job_pool_t {
+    picoquic_mutex_t pool_lock;
+    size_t next_job;
+    size_t nb_jobs;
+    dtn_job_fn job_fn;
+    void* job_ctx;
+} dtn_job_pool_t;
+
+static int dtn_job_pool_next(dtn_job_pool_t* pool, size_t* job_index)
+{
+    int found = 0;
+
+    picoquic_lock_mutex(&pool->pool_lock);
+    if (pool->next_job < pool->nb_jobs) {
+        *job_index = pool->next_job++;
+        found = 1;
+    }
+    picoquic_unlock_mutex(&pool->pool_lock);
+
+    return found;
+}
+
+#ifdef _WINDOWS
+static DWORD WINAPI dtn_job_pool_worker(LPVOID v_pool)
+#else
+static void* dtn_job_pool_worker(void* v_pool)
+#endif
+{
+    dtn_job_pool_t* pool = (dtn_job_pool_t*)v_pool;
+    size_t job_index;
+
+    while (dtn_job_pool_next(pool, &job_index)) {
+        (void)pool->job_fn(pool->job_ctx, job_index);
+    }
+#ifdef _WINDOWS
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int dtn_get_nb_cores()
+{
+    int nb_cores = 1;
+#ifdef _WINDOWS
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    nb_cores = (int)sys_info.dwNumberOfProcessors;
+#else
+    long nb_online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nb_online > 0) {
+        nb_cores = (int)nb_online;
+    }
+#endif
+    return nb_cores;
+}
+
+int dtn_run_parallel(size_t nb_jobs, int nb_threads, dtn_job_fn job_fn, void* job_ctx)
+{
+    int ret = 0;
+    int nb_started = 0;
+    dtn_job_pool_t pool;
+    picoquic_thread_t* threads = NULL;
+
+    if (nb_threads <= 0) {
+        nb_threads = dtn_get_nb_cores();
+    }
+    if ((size_t)nb_threads > nb_jobs) {
+        nb_threads = (nb_jobs > 0) ? (int)nb_jobs : 1;
+    }
+
+    memset(&pool, 0, sizeof(dtn_job_pool_t));
+    pool.nb_jobs = nb_jobs;
+    pool.job_fn = job_fn;
+    pool.job_ctx = job_ctx;
+
+    if ((threads = (picoquic_thread_t*)malloc(nb_threads * sizeof(picoquic_thread_t))) == NULL) {
+        fprintf(stderr, "Could not allocate memory for %d threads.\n", nb_threads);
+        ret = -1;
+    }
+    else if ((ret = picoquic_create_mutex(&pool.pool_lock)) != 0) {
+        fprintf(stderr, "Could not create the job pool mutex, ret = %d.\n", ret);
+    }
+    else {
+        for (int t = 0; t < nb_threads; t++) {
+            if (picoquic_create_thread(&threads[t], dtn_job_pool_worker, &pool) != 0) {
+                fprintf(stderr, "Could not start thread %d.\n", t);
+                break;
+            }
+            nb_started++;
+        }
+        if (nb_started == 0) {
+            /* Run the jobs in the calling thread instead */
+            (void)dtn_job_pool_worker(&pool);
+        }
+        for (int t = 0; t < nb_started; t++) {
+            picoquic_delete_thread(&threads[t]);
+        }
+        picoquic_delete_mutex(&pool.pool_lock);
+    }
+
+    if (threads != NULL) {
+        free(threads);
+    }
+
+    return ret;
+}
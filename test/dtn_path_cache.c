@@ -0,0 +1,152 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Path state cache for the DTN connections.
+ *
+ * The rate and the latency of a deep space link are known in advance and
+ * barely change between contacts, yet each new connection starts with
+ * the initial congestion window and has to probe. At minutes of RTT,
+ * each round of slow start costs minutes of contact time. The harness
+ * saves the RTT and congestion state of each side at the end of a
+ * connection, and seeds the next connection with it, in the spirit of
+ * careful resumption and of the BDP frames.
+ *
+ * Seeding uses picoquic_seed_bandwidth. Picoquic only applies the seed if
+ * the peer address matches and the first RTT samples are consistent with
+ * the saved minimum RTT, after which the congestion algorithm receives a
+ * seed_cwin notification. The pacing rate is saved for information, since
+ * picoquic derives the pacing from the seeded window and the RTT.
+ *
+ * The cache can be written to a text file and read back, so the state
+ * survives between runs of the harness. Each line holds the side, then
+ * the minimum RTT and smoothed RTT in microseconds, the congestion window
+ * in bytes, and the pacing rate in bytes per second.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "delay_tolerant_internal.h"
+
+static char const* dtn_path_cache_side[2] = { "client", "server" };
+
+void dtn_path_state_save(picoquic_cnx_t* cnx, dtn_path_state_t* state)
+{
+    picoquic_path_quality_t quality;
+
+    if (cnx != NULL) {
+        picoquic_get_default_path_quality(cnx, &quality);
+        if (quality.rtt_min > 0 && quality.cwin > 0) {
+            state->is_valid = 1;
+            state->rtt_min = quality.rtt_min;
+            state->smoothed_rtt = quality.rtt;
+            state->cwin = quality.cwin;
+            state->pacing_rate = quality.pacing_rate;
+        }
+    }
+}
+
+int dtn_path_state_seed(picoquic_cnx_t* cnx, dtn_path_state_t const* state, struct sockaddr_in const* peer_addr)
+{
+    int is_seeded = 0;
+
+    if (cnx != NULL && state->is_valid) {
+        picoquic_seed_bandwidth(cnx, state->rtt_min, state->cwin,
+            (const uint8_t*)&peer_addr->sin_addr, (uint8_t)sizeof(peer_addr->sin_addr));
+        is_seeded = 1;
+    }
+
+    return is_seeded;
+}
+
+int dtn_path_cache_write(dtn_path_cache_t const* cache, char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "w");
+
+    if (F == NULL) {
+        DBG_PRINTF("Cannot open %s", file_name);
+        ret = -1;
+    }
+    else {
+        for (int i = 0; i < 2; i++) {
+            dtn_path_state_t const* state = &cache->state[i];
+
+            if (state->is_valid) {
+                fprintf(F, "%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", dtn_path_cache_side[i],
+                    state->rtt_min, state->smoothed_rtt, state->cwin, state->pacing_rate);
+            }
+        }
+        if (ferror(F)) {
+            ret = -1;
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+
+int dtn_path_cache_read(dtn_path_cache_t* cache, char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "r");
+
+    memset(cache, 0, sizeof(dtn_path_cache_t));
+
+    if (F == NULL) {
+        DBG_PRINTF("Cannot open %s", file_name);
+        ret = -1;
+    }
+    else {
+        char line[256];
+
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            char side[16];
+            dtn_path_state_t state;
+            int i;
+
+            memset(&state, 0, sizeof(dtn_path_state_t));
+            if (sscanf(line, "%15s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, side,
+                &state.rtt_min, &state.smoothed_rtt, &state.cwin, &state.pacing_rate) != 5) {
+                ret = -1;
+                continue;
+            }
+            for (i = 0; i < 2; i++) {
+                if (strcmp(side, dtn_path_cache_side[i]) == 0) {
+                    state.is_valid = 1;
+                    cache->state[i] = state;
+                    break;
+                }
+            }
+            if (i >= 2) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Invalid path cache line in %s", file_name);
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
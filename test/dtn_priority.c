@@ -0,0 +1,180 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Stream scheduling of mixed telemetry and bulk data.
+ *
+ * The server sends the responses, so the scheduling is set on the server
+ * streams, with picoquic_set_stream_priority. Lower priority values are
+ * served first. Streams with odd values are served in FIFO order of
+ * their stream identifiers, streams with even values in round robin.
+ * The modes are:
+ *  - fifo: all streams at the picoquic default, 9,
+ *  - round robin: all streams at 8,
+ *  - urgent first: the urgent streams, whose responses are not larger
+ *    than urgent_max_size, at 2, in round robin, and the bulk streams
+ *    at the default.
+ * The callbacks of the test application are wrapped, so the server can
+ * set the priority of a stream when the request arrives, before the
+ * response is queued, and the client can record the arrival of the
+ * first and last bytes of each response.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_PRIORITY_DEFAULT 9
+#define DTN_PRIORITY_ROUND_ROBIN 8
+#define DTN_PRIORITY_URGENT 2
+
+static int dtn_priority_stream_index(dtn_priority_ctx_t* prio, uint64_t stream_id)
+{
+    int index = -1;
+
+    for (size_t i = 0; i < prio->nb_streams; i++) {
+        if (prio->latency[i].stream_id == stream_id) {
+            index = (int)i;
+            break;
+        }
+    }
+
+    return index;
+}
+
+static uint8_t dtn_priority_of_stream(dtn_priority_ctx_t* prio, int index)
+{
+    uint8_t priority = DTN_PRIORITY_DEFAULT;
+
+    switch (prio->spec->priority_mode) {
+    case dtn_priority_round_robin:
+        priority = DTN_PRIORITY_ROUND_ROBIN;
+        break;
+    case dtn_priority_urgent_first:
+        if (prio->latency[index].is_urgent) {
+            priority = DTN_PRIORITY_URGENT;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return priority;
+}
+
+static int dtn_priority_server_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_priority_ctx_t* prio = (dtn_priority_ctx_t*)callback_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) {
+        int index = dtn_priority_stream_index(prio, stream_id);
+
+        if (index >= 0 && !prio->is_priority_set[index]) {
+            prio->is_priority_set[index] = 1;
+            (void)picoquic_set_stream_priority(cnx, stream_id, dtn_priority_of_stream(prio, index));
+        }
+    }
+
+    return test_api_callback(cnx, stream_id, bytes, length, fin_or_event, &prio->test_ctx->server_callback, v_stream_ctx);
+}
+
+static int dtn_priority_client_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_priority_ctx_t* prio = (dtn_priority_ctx_t*)callback_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) {
+        int index = dtn_priority_stream_index(prio, stream_id);
+
+        if (index >= 0) {
+            uint64_t current_time = picoquic_get_quic_time(cnx->quic);
+            dtn_stream_latency_t* latency = &prio->latency[index];
+
+            if (length > 0 && latency->first_byte_time == 0) {
+                latency->first_byte_time = current_time;
+            }
+            if (fin_or_event == picoquic_callback_stream_fin) {
+                latency->last_byte_time = current_time;
+            }
+        }
+    }
+
+    return test_api_callback(cnx, stream_id, bytes, length, fin_or_event, &prio->test_ctx->client_callback, v_stream_ctx);
+}
+
+/* Wrap the callbacks of both connections, once they are established and
+ * before the requests are queued. */
+void dtn_priority_attach(dtn_priority_ctx_t* prio, picoquic_test_tls_api_ctx_t* test_ctx,
+    dtn_test_spec_t const* spec, uint64_t start_time)
+{
+    memset(prio, 0, sizeof(dtn_priority_ctx_t));
+    prio->test_ctx = test_ctx;
+    prio->spec = spec;
+    prio->start_time = start_time;
+    prio->nb_streams = spec->sizeof_scenario / sizeof(test_api_stream_desc_t);
+    if (prio->nb_streams > PICOQUIC_MAX_TEST_STREAMS) {
+        prio->nb_streams = PICOQUIC_MAX_TEST_STREAMS;
+    }
+    for (size_t i = 0; i < prio->nb_streams; i++) {
+        prio->latency[i].stream_id = spec->scenario[i].stream_id;
+        prio->latency[i].is_urgent = spec->scenario[i].r_len <= spec->urgent_max_size;
+    }
+    picoquic_set_callback(test_ctx->cnx_client, dtn_priority_client_callback, prio);
+    picoquic_set_callback(test_ctx->cnx_server, dtn_priority_server_callback, prio);
+}
+
+/* Compute the latencies relative to the requests, and the maximum per class */
+void dtn_priority_collect(dtn_priority_ctx_t* prio, dtn_test_result_t* result)
+{
+    result->nb_stream_latencies = prio->nb_streams;
+    for (size_t i = 0; i < prio->nb_streams; i++) {
+        dtn_stream_latency_t latency = prio->latency[i];
+        int previous = -1;
+
+        if (prio->spec->scenario[i].previous_stream_id != 0) {
+            previous = dtn_priority_stream_index(prio, prio->spec->scenario[i].previous_stream_id);
+        }
+        latency.request_time = (previous >= 0) ? prio->latency[previous].last_byte_time : prio->start_time;
+        latency.first_byte_time = (latency.first_byte_time > latency.request_time) ?
+            latency.first_byte_time - latency.request_time : 0;
+        latency.last_byte_time = (latency.last_byte_time > latency.request_time) ?
+            latency.last_byte_time - latency.request_time : 0;
+        latency.request_time -= prio->start_time;
+        result->stream_latency[i] = latency;
+
+        if (latency.is_urgent) {
+            if (latency.first_byte_time > result->urgent_first_byte_max) {
+                result->urgent_first_byte_max = latency.first_byte_time;
+            }
+            if (latency.last_byte_time > result->urgent_last_byte_max) {
+                result->urgent_last_byte_max = latency.last_byte_time;
+            }
+        }
+        else if (latency.last_byte_time > result->bulk_last_byte_max) {
+            result->bulk_last_byte_max = latency.last_byte_time;
+        }
+    }
+}
@@ -0,0 +1,207 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Bottleneck queue of the downlink, and smoothness of the traffic.
+ *
+ * The harness gives the simulated links a queue as long as the latency,
+ * which never fills. Radio modems have much smaller buffers. With a large
+ * flow control credit, a sender that does not pace well releases bursts
+ * that overflow them. The spec can set the size of the bottleneck buffer
+ * in bytes, converted to the queue delay that the simulated links use
+ * with the link rate, and the drop policy:
+ *  - tail drop: packets that find the buffer full are dropped,
+ *  - RED: one packet in DTN_QUEUE_RED_RATE is dropped once the buffer
+ *    is half full, and all packets when it is full.
+ *
+ * After each round of the transfer, the harness samples the downlink:
+ *  - the queue occupancy, from the time at which the link will have sent
+ *    the queued packets, weighted by time,
+ *  - the bursts, runs of packets sent by the server less than half the
+ *    serialization time of a packet apart, faster than the link drains,
+ *  - the pacing error, the average relative difference between the
+ *    interval between two packets and the interval at the pacing rate
+ *    announced by picoquic. Intervals longer than four times the pacing
+ *    interval are idle periods, and are not counted.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+/* One drop in 8 between the RED threshold and the full buffer */
+#define DTN_QUEUE_RED_RATE 8
+#define DTN_QUEUE_RED_MASK 0x8080808080808080ull
+
+/* Queue delay of a buffer at the given rate, at least 1 us so that the
+ * link does not disable the limit */
+static uint64_t dtn_queue_delay(uint64_t buffer_bytes, double mbps)
+{
+    uint64_t delay = (uint64_t)(((double)buffer_bytes) * 8.0 / mbps);
+
+    return (delay > 0) ? delay : 1;
+}
+
+static void dtn_queue_set_limit(picoquictest_sim_link_t* link, uint64_t buffer_bytes, double mbps,
+    dtn_queue_policy_t policy)
+{
+    uint64_t delay = dtn_queue_delay(buffer_bytes, mbps);
+
+    if (policy == dtn_queue_red) {
+        link->queue_delay_max = (delay + 1) / 2;
+        link->red_drop_mask = DTN_QUEUE_RED_MASK;
+        link->red_queue_max = delay;
+    }
+    else {
+        link->queue_delay_max = delay;
+        link->red_drop_mask = 0;
+        link->red_queue_max = 0;
+    }
+}
+
+void dtn_queue_start(dtn_queue_state_t* state, dtn_test_spec_t const* spec)
+{
+    memset(state, 0, sizeof(dtn_queue_state_t));
+    state->spec = spec;
+}
+
+/* Set the limits of both links once the connection is established. The
+ * handshake uses the default queue, sized by the latency. */
+void dtn_queue_apply(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    dtn_test_spec_t const* spec = state->spec;
+
+    if (spec->bottleneck_buffer > 0) {
+        dtn_queue_set_limit(test_ctx->c_to_s_link, spec->bottleneck_buffer, spec->mbps_up, spec->queue_policy);
+        dtn_queue_set_limit(test_ctx->s_to_c_link, spec->bottleneck_buffer, spec->mbps_down, spec->queue_policy);
+    }
+    state->is_started = 1;
+    state->last_sample_time = simulated_time;
+    state->drops_start = test_ctx->s_to_c_link->packets_dropped;
+    state->packets_start = (test_ctx->cnx_server == NULL) ? 0 : test_ctx->cnx_server->nb_packets_sent;
+    state->last_packets_sent = state->packets_start;
+}
+
+static uint64_t dtn_queue_bytes(picoquictest_sim_link_t const* link, uint64_t simulated_time)
+{
+    uint64_t bytes = 0;
+
+    if (link->queue_time > simulated_time && link->picosec_per_byte > 0) {
+        bytes = ((link->queue_time - simulated_time) * 1000000) / link->picosec_per_byte;
+    }
+
+    return bytes;
+}
+
+static void dtn_queue_end_burst(dtn_queue_state_t* state)
+{
+    if (state->burst_length > 1) {
+        state->nb_bursts++;
+        state->burst_packets += state->burst_length;
+        if (state->burst_length > state->burst_max) {
+            state->burst_max = state->burst_length;
+        }
+    }
+    state->burst_length = 0;
+}
+
+void dtn_queue_sample(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, uint64_t simulated_time)
+{
+    picoquictest_sim_link_t* link = test_ctx->s_to_c_link;
+    uint64_t queue_bytes;
+
+    if (!state->is_started || test_ctx->cnx_server == NULL) {
+        return;
+    }
+
+    /* The occupancy holds since the previous sample */
+    if (simulated_time > state->last_sample_time) {
+        state->weighted_bytes += ((double)state->last_queue_bytes) * (double)(simulated_time - state->last_sample_time);
+        state->sampled_duration += simulated_time - state->last_sample_time;
+        state->last_sample_time = simulated_time;
+    }
+    queue_bytes = dtn_queue_bytes(link, simulated_time);
+    state->last_queue_bytes = queue_bytes;
+    if (queue_bytes > state->peak_bytes) {
+        state->peak_bytes = queue_bytes;
+    }
+
+    if (test_ctx->cnx_server->nb_packets_sent > state->last_packets_sent) {
+        size_t length = (link->last_packet != NULL) ? link->last_packet->length : PICOQUIC_MAX_PACKET_SIZE;
+        uint64_t packet_time = (length * link->picosec_per_byte) / 1000000;
+
+        state->last_packets_sent = test_ctx->cnx_server->nb_packets_sent;
+        if (state->has_sent) {
+            uint64_t gap = simulated_time - state->last_send_time;
+            picoquic_path_quality_t quality;
+
+            if (2 * gap < packet_time) {
+                state->burst_length += (state->burst_length == 0) ? 2 : 1;
+            }
+            else {
+                dtn_queue_end_burst(state);
+            }
+            picoquic_get_default_path_quality(test_ctx->cnx_server, &quality);
+            if (quality.pacing_rate > 0) {
+                double pacing_gap = ((double)length) * 1000000.0 / (double)quality.pacing_rate;
+
+                if ((double)gap < 4.0 * pacing_gap) {
+                    double error = ((double)gap - pacing_gap) / pacing_gap;
+
+                    state->pacing_error_sum += (error < 0) ? -error : error;
+                    state->nb_paced_gaps++;
+                }
+            }
+        }
+        state->has_sent = 1;
+        state->last_send_time = simulated_time;
+    }
+}
+
+void dtn_queue_finish(dtn_queue_state_t* state, picoquic_test_tls_api_ctx_t* test_ctx, dtn_test_result_t* result)
+{
+    if (!state->is_started) {
+        return;
+    }
+    dtn_queue_end_burst(state);
+    if (result != NULL) {
+        result->queue_peak_bytes = state->peak_bytes;
+        if (state->sampled_duration > 0) {
+            result->queue_average_bytes = state->weighted_bytes / (double)state->sampled_duration;
+        }
+        result->queue_drops = test_ctx->s_to_c_link->packets_dropped - state->drops_start;
+        result->burst_max = state->burst_max;
+        if (state->nb_bursts > 0) {
+            result->burst_average = ((double)state->burst_packets) / (double)state->nb_bursts;
+        }
+        if (test_ctx->cnx_server != NULL && test_ctx->cnx_server->nb_packets_sent > state->packets_start) {
+            result->burst_packet_ratio = ((double)state->burst_packets) /
+                (double)(test_ctx->cnx_server->nb_packets_sent - state->packets_start);
+        }
+        if (state->nb_paced_gaps > 0) {
+            result->pacing_error = state->pacing_error_sum / (double)state->nb_paced_gaps;
+        }
+    }
+}
@@ -0,0 +1,557 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Store and forward relay.
+ *
+ * Deep space paths often go through a relay orbiter. Instead of one
+ * connection over the full path, which needs both hops to be up at the
+ * same time for a whole transfer, the relay can end QUIC on each hop,
+ * keep the data in custody, and forward it on the next hop when that
+ * hop is up, as the Bundle Protocol does. The relay test compares the
+ * two approaches for the same geometry. Each hop has its own QUIC
+ * contexts and links, and the test runs its own simulation loop with the
+ * helpers of dtn_sim.c:
+ *
+ * - relay: the relay downloads the object from the spacecraft on the
+ *   first hop, and writes it to a temporary file. The ground station
+ *   downloads it from the relay on the second hop. The relay forwards
+ *   the data as soon as it is stored; when it has sent everything it
+ *   holds, the stream goes inactive until more data arrives.
+ * - direct: the ground station downloads the object from the spacecraft
+ *   over one link, which is up only when both hops are up, with the sum
+ *   of the latencies and the lowest of the rates.
+ *
+ * Each hop follows the contact plan of its relay path, and its client
+ * starts the connection when the hop first comes up. Packets sent while
+ * a hop is down are lost. The connections are expected to survive the
+ * gaps between contacts, so the idle timeout covers the whole test.
+ * The results give the delivery latency of the object to the ground,
+ * the usage of the downlink of each hop while it was up, and the peak
+ * of data held in custody by the relay, stored and not yet received by
+ * the ground station.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_RELAY_STREAM_ID 4
+#define DTN_RELAY_CLIENT_PORT 2000
+#define DTN_RELAY_SERVER_PORT 4433
+
+/* Pattern of the object, verified by the ground station */
+#define DTN_RELAY_BYTE(offset) ((uint8_t)((offset) % 251))
+
+/* State of one relay path, following its contact plan */
+typedef struct st_dtn_relay_leg_t {
+    dtn_relay_path_t const* path;
+    size_t current;
+    int is_up;
+    uint64_t latency;
+    double mbps_up;
+    double mbps_down;
+    double capacity_bits;
+    uint64_t bytes_down;
+} dtn_relay_leg_t;
+
+/* A hop carries one connection over one leg, or over both legs for the
+ * direct connection. */
+typedef struct st_dtn_relay_hop_t {
+    dtn_relay_leg_t* leg[2];
+    size_t nb_legs;
+    int is_up;
+    dtn_sim_quic_t sim;
+    picoquic_cnx_t* cnx_client;
+    picoquictest_sim_link_t* c_to_s_link;
+    picoquictest_sim_link_t* s_to_c_link;
+    struct sockaddr_storage client_addr;
+    struct sockaddr_storage server_addr;
+} dtn_relay_hop_t;
+
+typedef struct st_dtn_relay_ctx_t {
+    dtn_relay_spec_t const* spec;
+    uint64_t simulated_time;
+    size_t nb_hops;
+    dtn_relay_leg_t leg[2];
+    dtn_relay_hop_t hop[2];
+    uint64_t space_sent;
+    FILE* store;
+    uint64_t stored;
+    int is_store_complete;
+    picoquic_cnx_t* cnx_forward;
+    uint64_t forwarded;
+    int is_forward_waiting;
+    uint64_t custody_peak;
+    uint64_t ground_received;
+    uint64_t first_byte_time;
+    uint64_t done_time;
+    int is_done;
+    int error_detected;
+} dtn_relay_ctx_t;
+
+/* The spacecraft serves the object on stream 4 */
+static int dtn_relay_space_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_relay_ctx_t* ctx = (dtn_relay_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_fin && stream_id == DTN_RELAY_STREAM_ID) {
+        ret = picoquic_mark_active_stream(cnx, stream_id, 1, NULL);
+    }
+    else if (fin_or_event == picoquic_callback_prepare_to_send) {
+        uint64_t remaining = ctx->spec->object_size - ctx->space_sent;
+        size_t sent = (length < remaining) ? length : (size_t)remaining;
+        int is_fin = (sent == remaining);
+        uint8_t* buffer = picoquic_provide_stream_data_buffer(bytes, sent, is_fin, !is_fin);
+
+        if (buffer == NULL) {
+            ctx->error_detected = 1;
+            ret = -1;
+        }
+        else {
+            for (size_t i = 0; i < sent; i++) {
+                buffer[i] = DTN_RELAY_BYTE(ctx->space_sent + i);
+            }
+            ctx->space_sent += sent;
+        }
+    }
+
+    return ret;
+}
+
+/* The relay takes custody of the data received from the spacecraft */
+static int dtn_relay_store_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_relay_ctx_t* ctx = (dtn_relay_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)cnx;
+    (void)v_stream_ctx;
+
+    if ((fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) &&
+        stream_id == DTN_RELAY_STREAM_ID) {
+        if (length > 0) {
+            if (dtn_object_seek(ctx->store, ctx->stored) != 0 ||
+                fwrite(bytes, 1, length, ctx->store) != length) {
+                ctx->error_detected = 1;
+                ret = -1;
+            }
+            else {
+                ctx->stored += length;
+                /* The data stays in custody until the ground station has it,
+                 * not just until it is handed to the forward connection */
+                if (ctx->stored - ctx->ground_received > ctx->custody_peak) {
+                    ctx->custody_peak = ctx->stored - ctx->ground_received;
+                }
+            }
+        }
+        if (fin_or_event == picoquic_callback_stream_fin) {
+            ctx->is_store_complete = 1;
+        }
+        if (ret == 0 && ctx->is_forward_waiting) {
+            ctx->is_forward_waiting = 0;
+            ret = picoquic_mark_active_stream(ctx->cnx_forward, DTN_RELAY_STREAM_ID, 1, NULL);
+        }
+    }
+
+    return ret;
+}
+
+/* The relay forwards the data in custody to the ground station */
+static int dtn_relay_forward_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_relay_ctx_t* ctx = (dtn_relay_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_fin && stream_id == DTN_RELAY_STREAM_ID) {
+        ctx->cnx_forward = cnx;
+        ret = picoquic_mark_active_stream(cnx, stream_id, 1, NULL);
+    }
+    else if (fin_or_event == picoquic_callback_prepare_to_send) {
+        uint64_t available = ctx->stored - ctx->forwarded;
+        size_t sent = (length < available) ? length : (size_t)available;
+        int is_fin = ctx->is_store_complete && ctx->forwarded + sent == ctx->spec->object_size;
+
+        if (sent == 0 && !is_fin) {
+            /* Nothing in custody, wait for the next data from the spacecraft */
+            (void)picoquic_provide_stream_data_buffer(bytes, 0, 0, 0);
+            ctx->is_forward_waiting = 1;
+        }
+        else {
+            uint8_t* buffer = picoquic_provide_stream_data_buffer(bytes, sent, is_fin, !is_fin);
+
+            if (buffer == NULL || dtn_object_seek(ctx->store, ctx->forwarded) != 0 ||
+                fread(buffer, 1, sent, ctx->store) != sent) {
+                ctx->error_detected = 1;
+                ret = -1;
+            }
+            else {
+                ctx->forwarded += sent;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* The ground station verifies the object */
+static int dtn_relay_ground_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_relay_ctx_t* ctx = (dtn_relay_ctx_t*)callback_ctx;
+
+    (void)cnx;
+    (void)v_stream_ctx;
+
+    if ((fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) &&
+        stream_id == DTN_RELAY_STREAM_ID) {
+        if (length > 0 && ctx->ground_received == 0) {
+            ctx->first_byte_time = ctx->simulated_time;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (bytes[i] != DTN_RELAY_BYTE(ctx->ground_received + i)) {
+                ctx->error_detected = 1;
+                break;
+            }
+        }
+        ctx->ground_received += length;
+        if (fin_or_event == picoquic_callback_stream_fin && !ctx->is_done) {
+            ctx->is_done = 1;
+            ctx->done_time = ctx->simulated_time;
+            if (ctx->ground_received != ctx->spec->object_size) {
+                ctx->error_detected = 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void dtn_relay_delete_ctx(dtn_relay_ctx_t* ctx)
+{
+    for (size_t i = 0; i < 2; i++) {
+        dtn_relay_hop_t* hop = &ctx->hop[i];
+
+        dtn_sim_delete_quic(&hop->sim);
+        if (hop->c_to_s_link != NULL) {
+            picoquictest_sim_link_delete(hop->c_to_s_link);
+        }
+        if (hop->s_to_c_link != NULL) {
+            picoquictest_sim_link_delete(hop->s_to_c_link);
+        }
+    }
+    if (ctx->store != NULL) {
+        (void)fclose(ctx->store);
+    }
+    free(ctx);
+}
+
+static int dtn_relay_create_hop(dtn_relay_ctx_t* ctx, size_t hop_index,
+    picoquic_stream_data_cb_fn server_callback, picoquic_stream_data_cb_fn client_callback)
+{
+    int ret = 0;
+    dtn_relay_hop_t* hop = &ctx->hop[hop_index];
+
+    ((struct sockaddr_in*)&hop->client_addr)->sin_family = AF_INET;
+    ((struct sockaddr_in*)&hop->client_addr)->sin_port = htons((uint16_t)(DTN_RELAY_CLIENT_PORT + hop_index));
+    ((struct sockaddr_in*)&hop->server_addr)->sin_family = AF_INET;
+    ((struct sockaddr_in*)&hop->server_addr)->sin_port = htons((uint16_t)(DTN_RELAY_SERVER_PORT + hop_index));
+
+    ret = dtn_sim_create_quic(&hop->sim, 2, server_callback, client_callback, ctx, &ctx->simulated_time);
+    if (ret == 0) {
+        hop->c_to_s_link = picoquictest_sim_link_create(0.01, 0, NULL, 0, ctx->simulated_time);
+        hop->s_to_c_link = picoquictest_sim_link_create(0.01, 0, NULL, 0, ctx->simulated_time);
+        if (hop->c_to_s_link == NULL || hop->s_to_c_link == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        dtn_sim_set_transport(&hop->sim, ctx->spec->ccalgo, ctx->spec->max_completion_time, 0);
+    }
+
+    return ret;
+}
+
+static dtn_relay_ctx_t* dtn_relay_create_ctx(dtn_relay_spec_t const* spec)
+{
+    int ret = 0;
+    dtn_relay_ctx_t* ctx = (dtn_relay_ctx_t*)calloc(1, sizeof(dtn_relay_ctx_t));
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->spec = spec;
+    for (size_t i = 0; i < 2; i++) {
+        ctx->leg[i].path = &spec->hop[i];
+    }
+
+    if (spec->is_direct) {
+        ctx->nb_hops = 1;
+        ctx->hop[0].leg[0] = &ctx->leg[0];
+        ctx->hop[0].leg[1] = &ctx->leg[1];
+        ctx->hop[0].nb_legs = 2;
+        ret = dtn_relay_create_hop(ctx, 0, dtn_relay_space_callback, dtn_relay_ground_callback);
+    }
+    else {
+        ctx->nb_hops = 2;
+        for (size_t i = 0; i < 2; i++) {
+            ctx->hop[i].leg[0] = &ctx->leg[i];
+            ctx->hop[i].nb_legs = 1;
+        }
+        if ((ctx->store = tmpfile()) == NULL) {
+            DBG_PRINTF("%s", "Cannot create the relay store");
+            ret = -1;
+        }
+        if (ret == 0) {
+            ret = dtn_relay_create_hop(ctx, 0, dtn_relay_space_callback, dtn_relay_store_callback);
+        }
+        if (ret == 0) {
+            ret = dtn_relay_create_hop(ctx, 1, dtn_relay_forward_callback, dtn_relay_ground_callback);
+        }
+    }
+
+    if (ret != 0) {
+        dtn_relay_delete_ctx(ctx);
+        ctx = NULL;
+    }
+
+    return ctx;
+}
+
+/* Follow the contact plan of the leg, and return the time of the next
+ * change of the plan, or 0 if there is none. */
+static uint64_t dtn_relay_leg_update(dtn_relay_leg_t* leg, uint64_t simulated_time)
+{
+    dtn_relay_path_t const* path = leg->path;
+    uint64_t next_change = 0;
+
+    if (path->nb_contacts == 0) {
+        leg->is_up = 1;
+        leg->latency = path->latency;
+        leg->mbps_up = path->mbps_up;
+        leg->mbps_down = path->mbps_down;
+        return 0;
+    }
+
+    while (leg->current < path->nb_contacts && simulated_time >= path->contact_plan[leg->current].end_time) {
+        leg->current++;
+    }
+    leg->is_up = 0;
+    if (leg->current < path->nb_contacts) {
+        dtn_contact_t const* contact = &path->contact_plan[leg->current];
+
+        if (simulated_time >= contact->start_time) {
+            leg->is_up = 1;
+            leg->latency = contact->latency;
+            leg->mbps_up = contact->mbps_up;
+            leg->mbps_down = contact->mbps_down;
+            next_change = contact->end_time;
+        }
+        else {
+            next_change = contact->start_time;
+        }
+    }
+
+    return next_change;
+}
+
+/* Set the links of the hop from the state of its legs, and start the
+ * connection of the hop when it first comes up. */
+static int dtn_relay_hop_update(dtn_relay_ctx_t* ctx, dtn_relay_hop_t* hop)
+{
+    int ret = 0;
+    uint64_t latency = 0;
+    double mbps_up = 0;
+    double mbps_down = 0;
+
+    hop->is_up = 1;
+    for (size_t i = 0; i < hop->nb_legs; i++) {
+        dtn_relay_leg_t* leg = hop->leg[i];
+
+        if (!leg->is_up) {
+            hop->is_up = 0;
+            break;
+        }
+        latency += leg->latency;
+        if (i == 0 || leg->mbps_up < mbps_up) {
+            mbps_up = leg->mbps_up;
+        }
+        if (i == 0 || leg->mbps_down < mbps_down) {
+            mbps_down = leg->mbps_down;
+        }
+    }
+
+    if (hop->is_up) {
+        dtn_sim_link_set(hop->c_to_s_link, latency, mbps_up);
+        dtn_sim_link_set(hop->s_to_c_link, latency, mbps_down);
+        if (hop->cnx_client == NULL) {
+            uint8_t request[257];
+
+            hop->cnx_client = picoquic_create_cnx(hop->sim.qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+                (struct sockaddr*)&hop->server_addr, ctx->simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1,
+                PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+            if (hop->cnx_client == NULL) {
+                ret = -1;
+            }
+            else {
+                memset(request, 0x5c, sizeof(request));
+                ret = picoquic_add_to_stream(hop->cnx_client, DTN_RELAY_STREAM_ID, request, sizeof(request), 1);
+                if (ret == 0) {
+                    ret = picoquic_start_client_cnx(hop->cnx_client);
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Prepare the next packet of one of the QUIC contexts of the hop, and
+ * submit it to the link if the hop is up. */
+static int dtn_relay_prepare(dtn_relay_ctx_t* ctx, dtn_relay_hop_t* hop, int is_client)
+{
+    picoquictest_sim_packet_t* packet;
+    int ret = dtn_sim_prepare((is_client) ? hop->sim.qclient : hop->sim.qserver, ctx->simulated_time,
+        (is_client) ? &hop->client_addr : &hop->server_addr, &packet);
+
+    if (ret == 0 && packet != NULL) {
+        if (hop->is_up) {
+            picoquictest_sim_link_submit((is_client) ? hop->c_to_s_link : hop->s_to_c_link, packet, ctx->simulated_time);
+        }
+        else {
+            free(packet);
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_relay_loop(dtn_relay_ctx_t* ctx)
+{
+    int ret = 0;
+    uint64_t max_time = ctx->spec->max_completion_time;
+
+    while (ret == 0 && !ctx->is_done && !ctx->error_detected && ctx->simulated_time < max_time) {
+        uint64_t next_time = max_time;
+        uint64_t previous_time = ctx->simulated_time;
+
+        for (size_t i = 0; i < 2; i++) {
+            uint64_t next_change = dtn_relay_leg_update(&ctx->leg[i], ctx->simulated_time);
+
+            if (next_change > ctx->simulated_time && next_change < next_time) {
+                next_time = next_change;
+            }
+        }
+        for (size_t i = 0; ret == 0 && i < ctx->nb_hops; i++) {
+            dtn_relay_hop_t* hop = &ctx->hop[i];
+
+            ret = dtn_relay_hop_update(ctx, hop);
+            next_time = dtn_sim_next_wake_time(hop->sim.qserver, next_time);
+            if (hop->cnx_client != NULL) {
+                next_time = dtn_sim_next_wake_time(hop->sim.qclient, next_time);
+            }
+            next_time = picoquictest_sim_link_next_arrival(hop->c_to_s_link, next_time);
+            next_time = picoquictest_sim_link_next_arrival(hop->s_to_c_link, next_time);
+        }
+        if (next_time > ctx->simulated_time) {
+            ctx->simulated_time = next_time;
+        }
+        /* Capacity of the downlink of each leg while it was up */
+        for (size_t i = 0; i < 2; i++) {
+            if (ctx->leg[i].is_up) {
+                ctx->leg[i].capacity_bits += ctx->leg[i].mbps_down * (double)(ctx->simulated_time - previous_time);
+            }
+            (void)dtn_relay_leg_update(&ctx->leg[i], ctx->simulated_time);
+        }
+        for (size_t i = 0; ret == 0 && i < ctx->nb_hops; i++) {
+            dtn_relay_hop_t* hop = &ctx->hop[i];
+            uint64_t bytes_down = 0;
+
+            ret = dtn_relay_hop_update(ctx, hop);
+            if (ret == 0) {
+                ret = dtn_sim_deliver(hop->sim.qserver, hop->c_to_s_link, ctx->simulated_time, NULL, NULL);
+            }
+            if (ret == 0) {
+                ret = dtn_sim_deliver(hop->sim.qclient, hop->s_to_c_link, ctx->simulated_time, NULL, &bytes_down);
+            }
+            for (size_t j = 0; j < hop->nb_legs; j++) {
+                hop->leg[j]->bytes_down += bytes_down;
+            }
+            if (ret == 0 && dtn_sim_is_awake(hop->sim.qserver, ctx->simulated_time)) {
+                ret = dtn_relay_prepare(ctx, hop, 0);
+            }
+            if (ret == 0 && hop->cnx_client != NULL && dtn_sim_is_awake(hop->sim.qclient, ctx->simulated_time)) {
+                ret = dtn_relay_prepare(ctx, hop, 1);
+            }
+        }
+    }
+
+    if (ret == 0 && (!ctx->is_done || ctx->error_detected)) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int dtn_relay_test_one(dtn_relay_spec_t const* spec, dtn_relay_result_t* result)
+{
+    int ret = 0;
+    uint64_t wall_time_start = picoquic_current_time();
+    dtn_relay_ctx_t* ctx = NULL;
+
+    memset(result, 0, sizeof(dtn_relay_result_t));
+    if ((ctx = dtn_relay_create_ctx(spec)) == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = dtn_relay_loop(ctx);
+        result->completion_time = (ctx->is_done) ? ctx->done_time : ctx->simulated_time;
+        result->first_byte_time = ctx->first_byte_time;
+        result->bytes_received = ctx->ground_received;
+        result->custody_peak = ctx->custody_peak;
+        for (size_t i = 0; i < 2; i++) {
+            result->hop_bytes_down[i] = ctx->leg[i].bytes_down;
+            if (ctx->leg[i].capacity_bits > 0) {
+                result->hop_usage_down[i] = ((double)ctx->leg[i].bytes_down * 8.0) / ctx->leg[i].capacity_bits;
+            }
+        }
+        dtn_relay_delete_ctx(ctx);
+    }
+    result->ret = ret;
+    result->wall_time = picoquic_current_time() - wall_time_start;
+
+    return ret;
+}
@@ -0,0 +1,336 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Replay of the binary logs written by the DTN tests.
+ *
+ * Rerunning a long simulation to understand a goodput collapse is slow.
+ * The binary log of the connection already holds the state of the
+ * congestion control after each packet sent or acknowledged. The replay
+ * reads the log one event at a time, with the picoquic log reader, and
+ * rebuilds the timeline of the congestion window, RTT, bytes in flight
+ * and flow control blocking over simulated time. Only the current line
+ * of the timeline is kept in memory, so logs of very long transfers can
+ * be processed.
+ *
+ * The replay also flags the stalls, periods in which nothing was sent
+ * although data was in flight, the congestion window had room for one
+ * more packet and flow control did not block. The log does not say
+ * whether the application had data to send, so the wait for the last
+ * acknowledgements of a response can also show as a stall.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_binlog.h"
+#include "bytestream.h"
+#include "logreader.h"
+#include "delay_tolerant_internal.h"
+
+/* Fields of the congestion control update, in the order in which
+ * picoquic writes them in the binary log. Only the fields up to
+ * bytes_in_transit are read. The highest_ack, high_ack_time and
+ * last_time_ack group is only present if packet_rcvd is not zero, which
+ * is not the case for the updates logged before the first ACK. */
+typedef enum {
+    dtn_cc_sequence = 0,
+    dtn_cc_packet_rcvd,
+    dtn_cc_highest_ack,
+    dtn_cc_high_ack_time,
+    dtn_cc_last_time_ack,
+    dtn_cc_cwin,
+    dtn_cc_one_way_delay,
+    dtn_cc_rtt_sample,
+    dtn_cc_smoothed_rtt,
+    dtn_cc_rtt_min,
+    dtn_cc_bandwidth_estimate,
+    dtn_cc_receive_rate_estimate,
+    dtn_cc_send_mtu,
+    dtn_cc_pacing_packet_time,
+    dtn_cc_nb_retransmit,
+    dtn_cc_nb_spurious,
+    dtn_cc_cwin_blocked,
+    dtn_cc_flow_blocked,
+    dtn_cc_stream_blocked,
+    dtn_cc_state,
+    dtn_cc_param,
+    dtn_cc_bw_max,
+    dtn_cc_bytes_in_transit,
+    dtn_cc_nb_fields
+} dtn_cc_field_t;
+
+typedef struct st_dtn_replay_ctx_t {
+    FILE* F_csv;
+    uint64_t interval;
+    dtn_replay_result_t* result;
+    /* Last congestion control update */
+    int has_cc;
+    uint64_t cc_time;
+    uint64_t cc[dtn_cc_nb_fields];
+    /* Stall detection */
+    uint64_t last_send_time;
+    uint64_t open_since;
+    /* Current line of the timeline */
+    int has_line;
+    uint64_t line_start;
+    uint64_t line_sent;
+    uint64_t line_received;
+    uint64_t line_lost;
+    uint64_t line_cwin_blocked;
+    uint64_t line_flow_blocked;
+    uint64_t line_stall;
+} dtn_replay_ctx_t;
+
+static void dtn_replay_csv_header(FILE* F)
+{
+    fprintf(F, "time_us, sent, received, lost, sequence, highest_ack, cwin, bytes_in_transit, srtt_us, rtt_min_us, ");
+    fprintf(F, "retransmits, cwin_blocked_us, flow_blocked_us, stall_us\n");
+}
+
+static void dtn_replay_write_line(dtn_replay_ctx_t* ctx)
+{
+    if (ctx->has_line && ctx->F_csv != NULL) {
+        fprintf(ctx->F_csv, "%" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", ", ctx->line_start,
+            ctx->line_sent, ctx->line_received, ctx->line_lost);
+        fprintf(ctx->F_csv, "%" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", ",
+            ctx->cc[dtn_cc_sequence], ctx->cc[dtn_cc_highest_ack], ctx->cc[dtn_cc_cwin],
+            ctx->cc[dtn_cc_bytes_in_transit], ctx->cc[dtn_cc_smoothed_rtt], ctx->cc[dtn_cc_rtt_min]);
+        fprintf(ctx->F_csv, "%" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n", ctx->cc[dtn_cc_nb_retransmit],
+            ctx->line_cwin_blocked, ctx->line_flow_blocked, ctx->line_stall);
+    }
+    ctx->has_line = 0;
+    ctx->line_sent = 0;
+    ctx->line_received = 0;
+    ctx->line_lost = 0;
+    ctx->line_cwin_blocked = 0;
+    ctx->line_flow_blocked = 0;
+    ctx->line_stall = 0;
+}
+
+/* Events are grouped in lines of one interval. Intervals without events
+ * are skipped, so a long silence does not fill the timeline. */
+static void dtn_replay_line_advance(dtn_replay_ctx_t* ctx, uint64_t event_time)
+{
+    if (ctx->has_line && (ctx->interval == 0 || event_time >= ctx->line_start + ctx->interval)) {
+        dtn_replay_write_line(ctx);
+    }
+    if (!ctx->has_line) {
+        ctx->has_line = 1;
+        ctx->line_start = (ctx->interval == 0) ? event_time : event_time - (event_time % ctx->interval);
+    }
+}
+
+static int dtn_replay_window_is_open(uint64_t const* cc)
+{
+    return cc[dtn_cc_bytes_in_transit] > 0 && !cc[dtn_cc_flow_blocked] &&
+        cc[dtn_cc_cwin] >= cc[dtn_cc_bytes_in_transit] + cc[dtn_cc_send_mtu];
+}
+
+static void dtn_replay_cc_update(dtn_replay_ctx_t* ctx, uint64_t event_time, uint64_t const* cc)
+{
+    dtn_replay_result_t* result = ctx->result;
+
+    if (ctx->has_cc) {
+        uint64_t delta_t = (event_time > ctx->cc_time) ? event_time - ctx->cc_time : 0;
+
+        /* The blocking flags hold until the next update */
+        if (ctx->cc[dtn_cc_cwin_blocked]) {
+            result->cwin_blocked_time += delta_t;
+            ctx->line_cwin_blocked += delta_t;
+        }
+        if (ctx->cc[dtn_cc_flow_blocked]) {
+            result->flow_blocked_time += delta_t;
+            ctx->line_flow_blocked += delta_t;
+        }
+        if (cc[dtn_cc_sequence] > ctx->cc[dtn_cc_sequence]) {
+            /* A packet was sent. If the window stayed open since the previous one, check the gap */
+            if (ctx->open_since != UINT64_MAX) {
+                uint64_t stall_start = (ctx->open_since > ctx->last_send_time) ? ctx->open_since : ctx->last_send_time;
+                uint64_t stall = (event_time > stall_start) ? event_time - stall_start : 0;
+
+                if (stall > DTN_REPLAY_STALL_THRESHOLD && stall > 4 * cc[dtn_cc_pacing_packet_time]) {
+                    result->nb_stalls++;
+                    result->stall_time += stall;
+                    ctx->line_stall += stall;
+                    if (stall > result->longest_stall) {
+                        result->longest_stall = stall;
+                        result->longest_stall_start = stall_start;
+                    }
+                }
+            }
+            ctx->last_send_time = event_time;
+        }
+    }
+    else {
+        ctx->last_send_time = event_time;
+    }
+
+    if (!dtn_replay_window_is_open(cc)) {
+        ctx->open_since = UINT64_MAX;
+    }
+    else if (ctx->open_since == UINT64_MAX) {
+        ctx->open_since = event_time;
+    }
+
+    memcpy(ctx->cc, cc, sizeof(ctx->cc));
+    ctx->cc_time = event_time;
+    ctx->has_cc = 1;
+    result->nb_cc_updates++;
+    if (cc[dtn_cc_cwin] > result->cwin_max) {
+        result->cwin_max = cc[dtn_cc_cwin];
+    }
+    if (cc[dtn_cc_bytes_in_transit] > result->bytes_in_transit_max) {
+        result->bytes_in_transit_max = cc[dtn_cc_bytes_in_transit];
+    }
+    if (cc[dtn_cc_smoothed_rtt] > result->smoothed_rtt_max) {
+        result->smoothed_rtt_max = cc[dtn_cc_smoothed_rtt];
+    }
+}
+
+/* Called by the log reader for each event of the log */
+static int dtn_replay_event(bytestream* s, void* v_ctx)
+{
+    int ret = 0;
+    dtn_replay_ctx_t* ctx = (dtn_replay_ctx_t*)v_ctx;
+    picoquic_connection_id_t cid;
+    uint64_t event_time = 0;
+    uint64_t path_id = 0;
+    uint64_t event_type = 0;
+
+    if (byteread_cid(s, &cid) != 0 || byteread_vint(s, &event_time) != 0 ||
+        byteread_vint(s, &path_id) != 0 || byteread_vint(s, &event_type) != 0) {
+        /* A truncated record ends the replay, like the end of the file */
+        ret = -1;
+    }
+    else {
+        ctx->result->nb_events++;
+        ctx->result->last_time = event_time;
+        dtn_replay_line_advance(ctx, event_time);
+
+        switch (event_type) {
+        case picoquic_log_event_packet_sent:
+            ctx->result->nb_packets_sent++;
+            ctx->line_sent++;
+            break;
+        case picoquic_log_event_packet_received:
+            ctx->result->nb_packets_received++;
+            ctx->line_received++;
+            break;
+        case picoquic_log_event_packet_lost:
+            ctx->result->nb_packets_lost++;
+            ctx->line_lost++;
+            break;
+        case picoquic_log_event_cc_update: {
+            uint64_t cc[dtn_cc_nb_fields];
+            int nb_read = 0;
+
+            memset(cc, 0, sizeof(cc));
+            while (nb_read < dtn_cc_nb_fields && byteread_vint(s, &cc[nb_read]) == 0) {
+                nb_read++;
+                if (nb_read == dtn_cc_highest_ack && cc[dtn_cc_packet_rcvd] == 0) {
+                    /* No ACK group, the next field is the cwin */
+                    nb_read = dtn_cc_cwin;
+                }
+            }
+            if (nb_read > dtn_cc_stream_blocked) {
+                dtn_replay_cc_update(ctx, event_time, cc);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return ret;
+}
+
+int dtn_replay_binlog(char const* binlog_file, char const* csv_file, uint64_t interval, dtn_replay_result_t* result)
+{
+    int ret = 0;
+    uint32_t log_time = 0;
+    dtn_replay_ctx_t ctx;
+    FILE* F_log = NULL;
+
+    memset(result, 0, sizeof(dtn_replay_result_t));
+    memset(&ctx, 0, sizeof(dtn_replay_ctx_t));
+    ctx.interval = interval;
+    ctx.result = result;
+    ctx.open_since = UINT64_MAX;
+
+    if ((F_log = picoquic_open_cc_log_file_for_read(binlog_file, &log_time)) == NULL) {
+        DBG_PRINTF("Cannot open binary log %s", binlog_file);
+        ret = -1;
+    }
+    else if (csv_file != NULL && (ctx.F_csv = picoquic_file_open(csv_file, "w")) == NULL) {
+        DBG_PRINTF("Cannot open %s", csv_file);
+        ret = -1;
+    }
+    else {
+        if (ctx.F_csv != NULL) {
+            dtn_replay_csv_header(ctx.F_csv);
+        }
+        /* Stopping on a truncated record is not an error, the log of a
+         * crashed process ends with one. */
+        (void)fileread_binlog(F_log, dtn_replay_event, &ctx);
+        dtn_replay_write_line(&ctx);
+        if (result->nb_events == 0) {
+            DBG_PRINTF("No event in binary log %s", binlog_file);
+            ret = -1;
+        }
+    }
+
+    if (ctx.F_csv != NULL) {
+        (void)picoquic_file_close(ctx.F_csv);
+    }
+    if (F_log != NULL) {
+        (void)picoquic_file_close(F_log);
+    }
+
+    return ret;
+}
+
+int dtn_replay(char const* binlog_file, char const* csv_file)
+{
+    dtn_replay_result_t result;
+    int ret = dtn_replay_binlog(binlog_file, csv_file, DTN_REPLAY_DEFAULT_INTERVAL, &result);
+
+    if (ret != 0) {
+        fprintf(stderr, "Cannot replay %s\n", binlog_file);
+    }
+    else {
+        fprintf(stdout, "%s: %" PRIu64 " events over %.3f s, %" PRIu64 " packets sent, %" PRIu64 " received, %" PRIu64 " lost\n",
+            binlog_file, result.nb_events, ((double)result.last_time) / 1000000.0, result.nb_packets_sent,
+            result.nb_packets_received, result.nb_packets_lost);
+        fprintf(stdout, "cwin max %" PRIu64 ", bytes in transit max %" PRIu64 ", srtt max %.3f s\n",
+            result.cwin_max, result.bytes_in_transit_max, ((double)result.smoothed_rtt_max) / 1000000.0);
+        fprintf(stdout, "blocked by cwin %.3f s, by flow control %.3f s\n",
+            ((double)result.cwin_blocked_time) / 1000000.0, ((double)result.flow_blocked_time) / 1000000.0);
+        fprintf(stdout, "%" PRIu64 " stalls, %.3f s in total, longest %.3f s at %.3f s, timeline in %s\n",
+            result.nb_stalls, ((double)result.stall_time) / 1000000.0, ((double)result.longest_stall) / 1000000.0,
+            ((double)result.longest_stall_start) / 1000000.0, csv_file);
+    }
+
+    return ret;
+}
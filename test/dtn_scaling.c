@@ -0,0 +1,376 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Many connection scaling test.
+ *
+ * A ground station server talks to many spacecraft at the same time,
+ * and with long RTT each connection stays alive for minutes or hours.
+ * The scaling test builds one server and N clients sharing the same
+ * long latency links, each client doing one request/response
+ * transaction, and runs the simulation for N = 1, 2, 4, ... up to the
+ * requested number of connections, or until the time budget is
+ * exhausted. For each step, it reports the completion times, the
+ * number of packets handled by the server per second of wall clock
+ * time, and the memory of the server per connection.
+ *
+ * The server memory is the sum of the memory of the server connections,
+ * see dtn_memory.c, sampled after each round in which the server handles
+ * a packet, at its peak. The client connections live in the same process,
+ * so the process memory would count them too. Sampling all the server
+ * connections takes time, which is not counted in the wall time of the
+ * step.
+ *
+ * The test_api context of picoquictest only manages one client
+ * connection, so the test creates its own QUIC contexts and runs its
+ * own simulation loop over the two simulated links, with the helpers of
+ * dtn_sim.c.
+ */
+
+#ifdef _WINDOWS
+#include "wincompat.h"
+#else
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_SCALING_STREAM_ID 4
+#define DTN_SCALING_MAX_RESPONSE 65536
+
+typedef struct st_dtn_scaling_ctx_t dtn_scaling_ctx_t;
+
+typedef struct st_dtn_scaling_client_t {
+    dtn_scaling_ctx_t* ctx;
+    picoquic_cnx_t* cnx;
+    uint64_t bytes_received;
+    uint64_t done_time;
+    int is_done;
+} dtn_scaling_client_t;
+
+struct st_dtn_scaling_ctx_t {
+    uint64_t simulated_time;
+    dtn_sim_quic_t sim;
+    picoquictest_sim_link_t* c_to_s_link;
+    picoquictest_sim_link_t* s_to_c_link;
+    struct sockaddr_storage client_addr;
+    struct sockaddr_storage server_addr;
+    size_t nb_clients;
+    size_t nb_done;
+    dtn_scaling_client_t* clients;
+    size_t request_length;
+    size_t response_length;
+    uint8_t response[DTN_SCALING_MAX_RESPONSE];
+    uint64_t server_packets_received;
+    uint64_t server_packets_sent;
+    size_t server_memory_peak;
+    uint64_t sampling_wall_time;
+};
+
+typedef struct st_dtn_scaling_step_t {
+    size_t nb_clients;
+    int ret;
+    size_t nb_done;
+    uint64_t max_completion_time;
+    uint64_t average_completion_time;
+    uint64_t server_packets;
+    uint64_t wall_time;
+    size_t server_memory_per_cnx;
+} dtn_scaling_step_t;
+
+static int dtn_scaling_server_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_scaling_ctx_t* ctx = (dtn_scaling_ctx_t*)callback_ctx;
+    int ret = 0;
+
+    (void)bytes;
+    (void)length;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_fin) {
+        /* The request is complete, send the response */
+        ret = picoquic_add_to_stream(cnx, stream_id, ctx->response, ctx->response_length, 1);
+    }
+
+    return ret;
+}
+
+static int dtn_scaling_client_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    dtn_scaling_client_t* client = (dtn_scaling_client_t*)callback_ctx;
+    dtn_scaling_ctx_t* ctx = client->ctx;
+
+    (void)cnx;
+    (void)stream_id;
+    (void)bytes;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) {
+        client->bytes_received += length;
+        if (fin_or_event == picoquic_callback_stream_fin && !client->is_done) {
+            client->is_done = 1;
+            client->done_time = ctx->simulated_time;
+            ctx->nb_done++;
+        }
+    }
+
+    return 0;
+}
+
+static void dtn_scaling_delete_ctx(dtn_scaling_ctx_t* ctx)
+{
+    dtn_sim_delete_quic(&ctx->sim);
+    if (ctx->c_to_s_link != NULL) {
+        picoquictest_sim_link_delete(ctx->c_to_s_link);
+    }
+    if (ctx->s_to_c_link != NULL) {
+        picoquictest_sim_link_delete(ctx->s_to_c_link);
+    }
+    if (ctx->clients != NULL) {
+        free(ctx->clients);
+    }
+    free(ctx);
+}
+
+static dtn_scaling_ctx_t* dtn_scaling_create_ctx(dtn_test_spec_t* spec, size_t nb_clients)
+{
+    int ret = 0;
+    dtn_scaling_ctx_t* ctx = (dtn_scaling_ctx_t*)calloc(1, sizeof(dtn_scaling_ctx_t));
+
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->clients = (dtn_scaling_client_t*)calloc(nb_clients, sizeof(dtn_scaling_client_t));
+    ctx->nb_clients = nb_clients;
+    ctx->request_length = spec->scenario[0].q_len;
+    ctx->response_length = (spec->scenario[0].r_len < DTN_SCALING_MAX_RESPONSE) ? spec->scenario[0].r_len : DTN_SCALING_MAX_RESPONSE;
+    ((struct sockaddr_in*)&ctx->client_addr)->sin_family = AF_INET;
+    ((struct sockaddr_in*)&ctx->client_addr)->sin_port = htons(1234);
+    ((struct sockaddr_in*)&ctx->server_addr)->sin_family = AF_INET;
+    ((struct sockaddr_in*)&ctx->server_addr)->sin_port = htons(4433);
+
+    if (ctx->clients == NULL) {
+        ret = -1;
+    }
+    else if ((ret = dtn_sim_create_quic(&ctx->sim, (uint32_t)nb_clients + 1, dtn_scaling_server_callback,
+        dtn_scaling_client_callback, ctx, &ctx->simulated_time)) == 0) {
+        ctx->c_to_s_link = picoquictest_sim_link_create(spec->mbps_up / 1000.0, spec->latency, NULL, 0, ctx->simulated_time);
+        ctx->s_to_c_link = picoquictest_sim_link_create(spec->mbps_down / 1000.0, spec->latency, NULL, 0, ctx->simulated_time);
+        if (ctx->c_to_s_link == NULL || ctx->s_to_c_link == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        dtn_sim_set_transport(&ctx->sim, spec->ccalgo, spec->latency * 5, 0);
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_clients; i++) {
+        dtn_scaling_client_t* client = &ctx->clients[i];
+        uint8_t request[1024];
+        size_t request_length = (ctx->request_length < sizeof(request)) ? ctx->request_length : sizeof(request);
+
+        memset(request, 0x5c, sizeof(request));
+        client->ctx = ctx;
+        client->cnx = picoquic_create_cnx(ctx->sim.qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1,
+            PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+        if (client->cnx == NULL) {
+            ret = -1;
+        }
+        else {
+            picoquic_set_callback(client->cnx, dtn_scaling_client_callback, client);
+            ret = picoquic_add_to_stream(client->cnx, DTN_SCALING_STREAM_ID, request, request_length, 1);
+            if (ret == 0) {
+                ret = picoquic_start_client_cnx(client->cnx);
+            }
+        }
+    }
+
+    if (ret != 0) {
+        dtn_scaling_delete_ctx(ctx);
+        ctx = NULL;
+    }
+
+    return ctx;
+}
+
+/* Prepare the next packet of one of the QUIC contexts and submit it to its link */
+static int dtn_scaling_prepare(dtn_scaling_ctx_t* ctx, picoquic_quic_t* quic, picoquictest_sim_link_t* link,
+    struct sockaddr_storage* default_from, uint64_t* nb_sent)
+{
+    picoquictest_sim_packet_t* packet;
+    int ret = dtn_sim_prepare(quic, ctx->simulated_time, default_from, &packet);
+
+    if (ret == 0 && packet != NULL) {
+        picoquictest_sim_link_submit(link, packet, ctx->simulated_time);
+        (*nb_sent)++;
+    }
+
+    return ret;
+}
+
+/* Sum of the memory of the server connections */
+static void dtn_scaling_sample_server(dtn_scaling_ctx_t* ctx)
+{
+    uint64_t start_time = picoquic_current_time();
+    size_t total_bytes = 0;
+    picoquic_cnx_t* cnx = picoquic_get_first_cnx(ctx->sim.qserver);
+
+    while (cnx != NULL) {
+        dtn_memory_sample_t sample;
+
+        dtn_memory_sample(cnx, &sample);
+        total_bytes += sample.total_bytes;
+        cnx = picoquic_get_next_cnx(cnx);
+    }
+    if (total_bytes > ctx->server_memory_peak) {
+        ctx->server_memory_peak = total_bytes;
+    }
+    ctx->sampling_wall_time += picoquic_current_time() - start_time;
+}
+
+static int dtn_scaling_loop(dtn_scaling_ctx_t* ctx, uint64_t max_simulated_time, uint64_t wall_deadline)
+{
+    int ret = 0;
+    uint64_t nb_rounds = 0;
+    uint64_t client_packets = 0;
+
+    while (ret == 0 && ctx->nb_done < ctx->nb_clients && ctx->simulated_time < max_simulated_time) {
+        uint64_t next_time = dtn_sim_next_wake_time(ctx->sim.qclient, ctx->simulated_time + max_simulated_time);
+        uint64_t server_packets = ctx->server_packets_received + ctx->server_packets_sent;
+
+        next_time = dtn_sim_next_wake_time(ctx->sim.qserver, next_time);
+        next_time = picoquictest_sim_link_next_arrival(ctx->c_to_s_link, next_time);
+        next_time = picoquictest_sim_link_next_arrival(ctx->s_to_c_link, next_time);
+        if (next_time > ctx->simulated_time) {
+            ctx->simulated_time = next_time;
+        }
+
+        ret = dtn_sim_deliver(ctx->sim.qserver, ctx->c_to_s_link, ctx->simulated_time, &ctx->server_packets_received, NULL);
+        if (ret == 0) {
+            ret = dtn_sim_deliver(ctx->sim.qclient, ctx->s_to_c_link, ctx->simulated_time, &client_packets, NULL);
+        }
+        if (ret == 0 && dtn_sim_is_awake(ctx->sim.qserver, ctx->simulated_time)) {
+            ret = dtn_scaling_prepare(ctx, ctx->sim.qserver, ctx->s_to_c_link, &ctx->server_addr, &ctx->server_packets_sent);
+        }
+        if (ret == 0 && dtn_sim_is_awake(ctx->sim.qclient, ctx->simulated_time)) {
+            ret = dtn_scaling_prepare(ctx, ctx->sim.qclient, ctx->c_to_s_link, &ctx->client_addr, &client_packets);
+        }
+        if (ret == 0 && ctx->server_packets_received + ctx->server_packets_sent > server_packets) {
+            dtn_scaling_sample_server(ctx);
+        }
+        if ((++nb_rounds & 0x3ff) == 0 && picoquic_current_time() > wall_deadline) {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static void dtn_scaling_one_step(dtn_test_spec_t* spec, size_t nb_clients, uint64_t wall_deadline, dtn_scaling_step_t* step)
+{
+    uint64_t start_time = picoquic_current_time();
+    dtn_scaling_ctx_t* ctx = dtn_scaling_create_ctx(spec, nb_clients);
+
+    memset(step, 0, sizeof(dtn_scaling_step_t));
+    step->nb_clients = nb_clients;
+
+    if (ctx == NULL) {
+        step->ret = -1;
+    }
+    else {
+        uint64_t sum_completion = 0;
+
+        step->ret = dtn_scaling_loop(ctx, spec->max_completion_time, wall_deadline);
+        step->nb_done = ctx->nb_done;
+        for (size_t i = 0; i < nb_clients; i++) {
+            if (ctx->clients[i].is_done) {
+                sum_completion += ctx->clients[i].done_time;
+                if (ctx->clients[i].done_time > step->max_completion_time) {
+                    step->max_completion_time = ctx->clients[i].done_time;
+                }
+            }
+        }
+        if (ctx->nb_done > 0) {
+            step->average_completion_time = sum_completion / ctx->nb_done;
+        }
+        if (ctx->nb_done < nb_clients && step->ret == 0) {
+            step->ret = -1;
+        }
+        step->server_packets = ctx->server_packets_received + ctx->server_packets_sent;
+        step->server_memory_per_cnx = ctx->server_memory_peak / nb_clients;
+        start_time += ctx->sampling_wall_time;
+        dtn_scaling_delete_ctx(ctx);
+    }
+    step->wall_time = picoquic_current_time() - start_time;
+}
+
+int dtn_scaling(int minutes, int nb_connections)
+{
+    int ret = 0;
+    size_t n = 1;
+    dtn_test_spec_t spec;
+    uint64_t wall_deadline = picoquic_current_time() + ((uint64_t)minutes) * 60000000ull;
+
+    dtn_set_basic_test_spec(&spec);
+    /* Leave time for the transactions to queue behind each other on the links */
+    spec.max_completion_time = 16 * spec.latency;
+
+    fprintf(stdout, "DTN scaling, latency %.1f s, %.1f Mbps, up to %d connections for %d minutes.\n",
+        ((double)spec.latency) / 1000000.0, spec.mbps_down, nb_connections, minutes);
+    fprintf(stdout, "%10s %8s %12s %12s %14s %14s %10s\n",
+        "clients", "done", "avg_done_s", "max_done_s", "srv_pkt/wall_s", "srv_mem/cnx", "wall_s");
+
+    while (n <= (size_t)nb_connections && picoquic_current_time() < wall_deadline) {
+        dtn_scaling_step_t step;
+
+        dtn_scaling_one_step(&spec, n, wall_deadline, &step);
+        fprintf(stdout, "%10" PRIst " %8" PRIst " %12.1f %12.1f %14.1f %14" PRIst " %10.3f\n",
+            step.nb_clients, step.nb_done,
+            ((double)step.average_completion_time) / 1000000.0, ((double)step.max_completion_time) / 1000000.0,
+            (step.wall_time > 0) ? ((double)step.server_packets) * 1000000.0 / ((double)step.wall_time) : 0.0,
+            step.server_memory_per_cnx, ((double)step.wall_time) / 1000000.0);
+        fflush(stdout);
+        if (step.ret != 0) {
+            ret = -1;
+        }
+        /* Double the number of connections, finishing with the requested number */
+        if (n < (size_t)nb_connections && 2 * n > (size_t)nb_connections) {
+            n = (size_t)nb_connections;
+        }
+        else {
+            n *= 2;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,602 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Scenario files.
+ *
+ * The fixed DTN tests are built in C, and a new workload requires a
+ * rebuild. A scenario file describes test cases as data. It is a text
+ * file, in which each case starts with a "case <name>" line, followed by
+ * one line per parameter until the next case. Lines starting with '#'
+ * are comments. For example:
+ *
+ *     case leo_pass
+ *     latency 0.02
+ *     up 1
+ *     down 10
+ *     cc bbr
+ *     contact 0 600 1 10 0.02
+ *     contact 6000 6600 1 10 0.02
+ *     loss ge 0.01 0.2 0 0.5
+ *     stream 4 0 257 10000000
+ *     budget 8000000000 0.5 0 0
+ *
+ * The parameters are:
+ *  - latency s: one way latency, in seconds
+ *  - max_completion s: maximum completion time, in seconds. By default,
+ *    a generous bound computed from the latency, the downloaded bytes
+ *    and the contact plan.
+ *  - up mbps, down mbps: data rate of the links, in Mbps
+ *  - cc name: congestion control algorithm, including "dtn"
+ *  - credit bytes|auto: initial flow control credit, auto for the
+ *    bandwidth delay product
+ *  - utilization ratio: target utilization of the auto credit
+ *  - stream id previous q_len r_len: one stream of the scenario, as in
+ *    test_api_stream_desc_t. The default is the small download of the
+ *    basic test.
+ *  - contact start end mbps_up mbps_down latency: one window of the
+ *    contact plan, times in seconds
+ *  - loss none|bernoulli rate|ge p_gb p_bg loss_good loss_bad|ber ber:
+ *    loss model, see dtn_loss.c
+ *  - blackout start end: interval without link, in seconds
+ *  - seed n: seed of the loss model
+ *  - fec redundancy [block_size]: erasure coding of the links
+ *  - mtu bytes: known link MTU, see dtn_mtu.c
+ *  - queue bytes tail|red: bottleneck buffer, see dtn_queue.c
+ *  - event 0|1: event driven rounds, see dtn_event.c
+ *  - log 0|1|2: no logs (the default), summary or full logs
+ *  - budget completion_us goodput_ratio wall_us memory_bytes: performance
+ *    budget of the case, as in the baseline file, 0 for not checked
+ *
+ * The parameters that are not specified keep the values of the basic
+ * DTN test. Loading a file only reads it in memory and indexes the
+ * "case" lines, so a file with thousands of sweep points loads at once;
+ * each case is parsed when it runs. The errors of a case are reported
+ * with their line number, and only fail that case.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_SCENARIO_LINE_MAX 256
+
+static uint64_t dtn_scenario_microsec(double seconds)
+{
+    return (uint64_t)(seconds * 1000000.0);
+}
+
+/* Length of the line starting at text, without the end of line */
+static size_t dtn_scenario_line_length(char const* text, char const* text_end)
+{
+    char const* eol = text;
+
+    while (eol < text_end && *eol != '\n') {
+        eol++;
+    }
+
+    return eol - text;
+}
+
+/* If the line is a case line, copy the name and return 1 */
+static int dtn_scenario_is_case_line(char const* line, size_t length, char* name, size_t name_size)
+{
+    int is_case = 0;
+    size_t i = 0;
+
+    while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+        i++;
+    }
+    if (length - i > 5 && memcmp(line + i, "case", 4) == 0 && (line[i + 4] == ' ' || line[i + 4] == '\t')) {
+        size_t name_length = 0;
+
+        i += 5;
+        while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+            i++;
+        }
+        while (i < length && line[i] != ' ' && line[i] != '\t' && line[i] != '\r' &&
+            name_length + 1 < name_size) {
+            name[name_length++] = line[i++];
+        }
+        name[name_length] = 0;
+        is_case = name_length > 0;
+    }
+
+    return is_case;
+}
+
+static int dtn_scenario_is_blank_line(char const* line, size_t length)
+{
+    size_t i = 0;
+
+    while (i < length && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) {
+        i++;
+    }
+
+    return i >= length || line[i] == '#';
+}
+
+static int dtn_scenario_add_case(dtn_scenario_file_t* file, size_t offset, int line_number, char const* name)
+{
+    int ret = 0;
+
+    if (file->nb_cases >= file->nb_cases_max) {
+        size_t new_max = (file->nb_cases_max == 0) ? 64 : 2 * file->nb_cases_max;
+        dtn_scenario_index_t* new_cases = NULL;
+
+        if (new_max > DTN_SCENARIO_MAX_CASES) {
+            new_max = DTN_SCENARIO_MAX_CASES;
+        }
+        if (new_max > file->nb_cases) {
+            new_cases = (dtn_scenario_index_t*)realloc(file->cases, new_max * sizeof(dtn_scenario_index_t));
+        }
+        if (new_cases == NULL) {
+            ret = -1;
+        }
+        else {
+            file->cases = new_cases;
+            file->nb_cases_max = new_max;
+        }
+    }
+    if (ret == 0) {
+        dtn_scenario_index_t* index = &file->cases[file->nb_cases++];
+
+        index->offset = offset;
+        index->line_number = line_number;
+        memcpy(index->name, name, sizeof(index->name));
+    }
+
+    return ret;
+}
+
+int dtn_scenario_file_load(dtn_scenario_file_t* file, char const* file_name)
+{
+    int ret = 0;
+    FILE* F = picoquic_file_open(file_name, "rb");
+    long file_length = 0;
+
+    memset(file, 0, sizeof(dtn_scenario_file_t));
+
+    if (F == NULL) {
+        fprintf(stderr, "Cannot open %s\n", file_name);
+        ret = -1;
+    }
+    else if (fseek(F, 0, SEEK_END) != 0 || (file_length = ftell(F)) < 0 || fseek(F, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "Cannot read %s\n", file_name);
+        ret = -1;
+    }
+    else if ((file->text = (char*)malloc((size_t)file_length + 1)) == NULL) {
+        fprintf(stderr, "Cannot allocate %ld bytes for %s\n", file_length, file_name);
+        ret = -1;
+    }
+    else if (fread(file->text, 1, (size_t)file_length, F) != (size_t)file_length) {
+        fprintf(stderr, "Cannot read %s\n", file_name);
+        ret = -1;
+    }
+    else {
+        char const* text_end = file->text + file_length;
+        size_t offset = 0;
+        int line_number = 0;
+
+        file->text_length = (size_t)file_length;
+        file->text[file->text_length] = 0;
+
+        while (ret == 0 && offset < file->text_length) {
+            char const* line = file->text + offset;
+            size_t length = dtn_scenario_line_length(line, text_end);
+            char name[64];
+
+            line_number++;
+            if (dtn_scenario_is_case_line(line, length, name, sizeof(name))) {
+                if ((ret = dtn_scenario_add_case(file, offset, line_number, name)) != 0) {
+                    fprintf(stderr, "Too many cases in %s, max is %d\n", file_name, DTN_SCENARIO_MAX_CASES);
+                }
+            }
+            else if (file->nb_cases == 0 && !dtn_scenario_is_blank_line(line, length)) {
+                fprintf(stderr, "%s, line %d: parameter before the first case\n", file_name, line_number);
+                ret = -1;
+            }
+            offset += length + 1;
+        }
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    if (ret != 0) {
+        dtn_scenario_file_release(file);
+    }
+
+    return ret;
+}
+
+void dtn_scenario_file_release(dtn_scenario_file_t* file)
+{
+    if (file->cases != NULL) {
+        free(file->cases);
+    }
+    if (file->text != NULL) {
+        free(file->text);
+    }
+    memset(file, 0, sizeof(dtn_scenario_file_t));
+}
+
+static int dtn_scenario_parse_loss(dtn_loss_model_t* loss_model, char const* values)
+{
+    int ret = 0;
+    char type[16];
+    int n = 0;
+
+    if (sscanf(values, "%15s%n", type, &n) != 1) {
+        ret = -1;
+    }
+    else if (strcmp(type, "none") == 0) {
+        loss_model->type = dtn_loss_none;
+    }
+    else if (strcmp(type, "bernoulli") == 0) {
+        loss_model->type = dtn_loss_bernoulli;
+        ret = (sscanf(values + n, "%lf", &loss_model->loss_rate) == 1 &&
+            loss_model->loss_rate >= 0 && loss_model->loss_rate < 1.0) ? 0 : -1;
+    }
+    else if (strcmp(type, "ge") == 0) {
+        loss_model->type = dtn_loss_gilbert_elliott;
+        ret = (sscanf(values + n, "%lf %lf %lf %lf", &loss_model->p_good_to_bad, &loss_model->p_bad_to_good,
+            &loss_model->loss_good, &loss_model->loss_bad) == 4) ? 0 : -1;
+    }
+    else if (strcmp(type, "ber") == 0) {
+        loss_model->type = dtn_loss_ber;
+        ret = (sscanf(values + n, "%lf", &loss_model->ber) == 1 &&
+            loss_model->ber >= 0 && loss_model->ber < 1.0) ? 0 : -1;
+    }
+    else {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int dtn_scenario_parse_line(dtn_scenario_case_t* c, char const* key, char const* values, int* has_max_completion)
+{
+    int ret = 0;
+    dtn_test_spec_t* spec = &c->spec;
+    double v[5];
+    uint64_t u[4];
+    char word[64];
+
+    if (strcmp(key, "latency") == 0) {
+        ret = (sscanf(values, "%lf", &v[0]) == 1 && v[0] > 0) ? 0 : -1;
+        spec->latency = dtn_scenario_microsec(v[0]);
+    }
+    else if (strcmp(key, "max_completion") == 0) {
+        ret = (sscanf(values, "%lf", &v[0]) == 1 && v[0] > 0) ? 0 : -1;
+        spec->max_completion_time = dtn_scenario_microsec(v[0]);
+        *has_max_completion = 1;
+    }
+    else if (strcmp(key, "up") == 0) {
+        ret = (sscanf(values, "%lf", &spec->mbps_up) == 1 && spec->mbps_up > 0) ? 0 : -1;
+    }
+    else if (strcmp(key, "down") == 0) {
+        ret = (sscanf(values, "%lf", &spec->mbps_down) == 1 && spec->mbps_down > 0) ? 0 : -1;
+    }
+    else if (strcmp(key, "cc") == 0) {
+        ret = (sscanf(values, "%63s", word) == 1 &&
+            (spec->ccalgo = dtn_get_congestion_algorithm(word)) != NULL) ? 0 : -1;
+    }
+    else if (strcmp(key, "credit") == 0) {
+        if (sscanf(values, "%63s", word) != 1) {
+            ret = -1;
+        }
+        else if (strcmp(word, "auto") == 0) {
+            spec->auto_flow_control = 1;
+        }
+        else {
+            spec->auto_flow_control = 0;
+            ret = (sscanf(word, "%" SCNu64, &spec->initial_flow_control_credit) == 1) ? 0 : -1;
+        }
+    }
+    else if (strcmp(key, "utilization") == 0) {
+        ret = (sscanf(values, "%lf", &spec->target_utilization) == 1 &&
+            spec->target_utilization > 0 && spec->target_utilization <= 1.0) ? 0 : -1;
+    }
+    else if (strcmp(key, "stream") == 0) {
+        if (c->nb_streams >= PICOQUIC_MAX_TEST_STREAMS ||
+            sscanf(values, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, &u[0], &u[1], &u[2], &u[3]) != 4 ||
+            (u[0] % 4) != 0 || u[0] == 0 || u[3] == 0) {
+            ret = -1;
+        }
+        else {
+            test_api_stream_desc_t* stream = &c->streams[c->nb_streams++];
+
+            stream->stream_id = u[0];
+            stream->previous_stream_id = u[1];
+            stream->q_len = (size_t)u[2];
+            stream->r_len = (size_t)u[3];
+        }
+    }
+    else if (strcmp(key, "contact") == 0) {
+        if (spec->nb_contacts >= DTN_MAX_CONTACTS ||
+            sscanf(values, "%lf %lf %lf %lf %lf", &v[0], &v[1], &v[2], &v[3], &v[4]) != 5 ||
+            v[0] < 0 || v[1] <= v[0] || v[2] <= 0 || v[3] <= 0 || v[4] <= 0 ||
+            (spec->nb_contacts > 0 && dtn_scenario_microsec(v[0]) < c->contacts[spec->nb_contacts - 1].end_time)) {
+            ret = -1;
+        }
+        else {
+            dtn_contact_t* contact = &c->contacts[spec->nb_contacts++];
+
+            contact->start_time = dtn_scenario_microsec(v[0]);
+            contact->end_time = dtn_scenario_microsec(v[1]);
+            contact->mbps_up = v[2];
+            contact->mbps_down = v[3];
+            contact->latency = dtn_scenario_microsec(v[4]);
+            spec->contact_plan = c->contacts;
+        }
+    }
+    else if (strcmp(key, "loss") == 0) {
+        ret = dtn_scenario_parse_loss(&spec->loss_model, values);
+    }
+    else if (strcmp(key, "blackout") == 0) {
+        if (spec->loss_model.nb_blackouts >= DTN_SCENARIO_MAX_BLACKOUTS ||
+            sscanf(values, "%lf %lf", &v[0], &v[1]) != 2 || v[0] < 0 || v[1] <= v[0]) {
+            ret = -1;
+        }
+        else {
+            dtn_blackout_t* blackout = &c->blackouts[spec->loss_model.nb_blackouts++];
+
+            blackout->start_time = dtn_scenario_microsec(v[0]);
+            blackout->end_time = dtn_scenario_microsec(v[1]);
+            spec->loss_model.blackouts = c->blackouts;
+        }
+    }
+    else if (strcmp(key, "seed") == 0) {
+        ret = (sscanf(values, "%" SCNu64, &spec->loss_model.seed) == 1) ? 0 : -1;
+    }
+    else if (strcmp(key, "fec") == 0) {
+        int nb_values = sscanf(values, "%lf %" SCNu64, &v[0], &u[0]);
+
+        if (nb_values < 1 || v[0] < 0 || v[0] > 1.0 ||
+            (nb_values == 2 && (u[0] == 0 || u[0] > DTN_FEC_MAX_BLOCK))) {
+            ret = -1;
+        }
+        else {
+            spec->fec.redundancy = v[0];
+            spec->fec.block_size = (nb_values == 2) ? (size_t)u[0] : DTN_FEC_DEFAULT_BLOCK;
+        }
+    }
+    else if (strcmp(key, "mtu") == 0) {
+        ret = (sscanf(values, "%" SCNu64, &u[0]) == 1) ? 0 : -1;
+        spec->link_mtu = (size_t)u[0];
+    }
+    else if (strcmp(key, "queue") == 0) {
+        if (sscanf(values, "%" SCNu64 " %63s", &spec->bottleneck_buffer, word) != 2) {
+            ret = -1;
+        }
+        else if (strcmp(word, "tail") == 0) {
+            spec->queue_policy = dtn_queue_tail_drop;
+        }
+        else if (strcmp(word, "red") == 0) {
+            spec->queue_policy = dtn_queue_red;
+        }
+        else {
+            ret = -1;
+        }
+    }
+    else if (strcmp(key, "event") == 0) {
+        ret = (sscanf(values, "%d", &spec->event_loop) == 1) ? 0 : -1;
+    }
+    else if (strcmp(key, "log") == 0) {
+        int log_level = 0;
+
+        ret = (sscanf(values, "%d", &log_level) == 1 && log_level >= dtn_log_off && log_level <= dtn_log_full) ? 0 : -1;
+        spec->log_level = (dtn_log_level_t)log_level;
+    }
+    else if (strcmp(key, "budget") == 0) {
+        c->has_budget = 1;
+        ret = (sscanf(values, "%" SCNu64 " %lf %" SCNu64 " %" SCNu64, &c->budget.max_completion_time,
+            &c->budget.min_goodput_ratio, &c->budget.max_wall_time, &c->budget.max_memory) == 4) ? 0 : -1;
+    }
+    else {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Generous upper bound, as in the sweeps: handshake, request, probing,
+ * plus several times the transfer time, and at least the contact plan */
+static uint64_t dtn_scenario_max_completion(dtn_test_spec_t const* spec)
+{
+    uint64_t total_bytes = 0;
+    uint64_t max_completion;
+    size_t nb_streams = spec->sizeof_scenario / sizeof(test_api_stream_desc_t);
+
+    for (size_t i = 0; i < nb_streams; i++) {
+        total_bytes += spec->scenario[i].r_len;
+    }
+    max_completion = 16 * spec->latency + 4 * (uint64_t)((((double)total_bytes) * 8.0) / spec->mbps_down) + 10000000;
+    if (spec->nb_contacts > 0) {
+        dtn_contact_t const* last = &spec->contact_plan[spec->nb_contacts - 1];
+        uint64_t contact_completion = last->end_time + 16 * last->latency;
+
+        if (contact_completion > max_completion) {
+            max_completion = contact_completion;
+        }
+    }
+
+    return max_completion;
+}
+
+int dtn_scenario_case_parse(dtn_scenario_file_t const* file, size_t case_index, dtn_scenario_case_t* scenario_case)
+{
+    int ret = 0;
+    dtn_scenario_index_t const* index = NULL;
+    char const* text = NULL;
+    char const* text_end = NULL;
+    int line_number = 0;
+    int has_max_completion = 0;
+
+    memset(scenario_case, 0, sizeof(dtn_scenario_case_t));
+    dtn_set_basic_test_spec(&scenario_case->spec);
+    scenario_case->spec.log_level = dtn_log_off;
+
+    if (case_index >= file->nb_cases) {
+        ret = -1;
+    }
+    else {
+        index = &file->cases[case_index];
+        line_number = index->line_number;
+        text = file->text + index->offset;
+        text_end = (case_index + 1 < file->nb_cases) ? file->text + file->cases[case_index + 1].offset :
+            file->text + file->text_length;
+        memcpy(scenario_case->budget.test_name, index->name, sizeof(scenario_case->budget.test_name));
+        scenario_case->budget.test_id = DTN_SCENARIO_TEST_ID;
+        /* Skip the case line */
+        text += dtn_scenario_line_length(text, text_end) + 1;
+    }
+
+    while (ret == 0 && text < text_end) {
+        size_t length = dtn_scenario_line_length(text, text_end);
+        char line[DTN_SCENARIO_LINE_MAX];
+        char key[32];
+        int n = 0;
+
+        line_number++;
+        if (length >= sizeof(line)) {
+            ret = -1;
+        }
+        else if (!dtn_scenario_is_blank_line(text, length)) {
+            memcpy(line, text, length);
+            line[length] = 0;
+            if (sscanf(line, "%31s%n", key, &n) != 1) {
+                ret = -1;
+            }
+            else {
+                ret = dtn_scenario_parse_line(scenario_case, key, line + n, &has_max_completion);
+            }
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Case %s, line %d: cannot parse %.*s\n", index->name, line_number,
+                (int)((length < DTN_SCENARIO_LINE_MAX) ? length : DTN_SCENARIO_LINE_MAX), text);
+        }
+        text += length + 1;
+    }
+
+    if (ret == 0) {
+        dtn_test_spec_t* spec = &scenario_case->spec;
+
+        if (scenario_case->nb_streams > 0) {
+            spec->scenario = scenario_case->streams;
+            spec->sizeof_scenario = scenario_case->nb_streams * sizeof(test_api_stream_desc_t);
+        }
+        if (!has_max_completion) {
+            spec->max_completion_time = dtn_scenario_max_completion(spec);
+        }
+    }
+
+    return ret;
+}
+
+typedef struct st_dtn_scenario_ctx_t {
+    dtn_scenario_file_t file;
+    dtn_test_result_t* results;
+} dtn_scenario_ctx_t;
+
+static int dtn_scenario_job(void* v_ctx, size_t i)
+{
+    dtn_scenario_ctx_t* ctx = (dtn_scenario_ctx_t*)v_ctx;
+    dtn_scenario_case_t scenario_case;
+    dtn_test_result_t* result = &ctx->results[i];
+    int ret = dtn_scenario_case_parse(&ctx->file, i, &scenario_case);
+
+    if (ret == 0) {
+        /* The sequence number starts at 1, the fixed budgets do not apply */
+        ret = dtn_test_one_ex(DTN_SCENARIO_TEST_ID, (uint16_t)(i + 1), &scenario_case.spec, result);
+        if (ret == 0 && scenario_case.has_budget) {
+            ret = dtn_budget_check(&scenario_case.budget, result);
+        }
+    }
+    result->ret = ret;
+
+    return ret;
+}
+
+int dtn_scenario_run(char const* scenario_file, char const* csv_file, int nb_threads)
+{
+    int ret = 0;
+    dtn_scenario_ctx_t ctx;
+    FILE* F = NULL;
+
+    memset(&ctx, 0, sizeof(dtn_scenario_ctx_t));
+
+    if ((ret = dtn_scenario_file_load(&ctx.file, scenario_file)) == 0) {
+        if (ctx.file.nb_cases == 0) {
+            fprintf(stderr, "No case in %s\n", scenario_file);
+            ret = -1;
+        }
+        else if ((ctx.results = (dtn_test_result_t*)calloc(ctx.file.nb_cases, sizeof(dtn_test_result_t))) == NULL) {
+            fprintf(stderr, "Cannot allocate %" PRIst " scenario results\n", ctx.file.nb_cases);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && (F = picoquic_file_open(csv_file, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", csv_file);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        int nb_failed = 0;
+
+        fprintf(stdout, "Running %" PRIst " cases of %s.\n", ctx.file.nb_cases, scenario_file);
+        fflush(stdout);
+        (void)dtn_run_parallel(ctx.file.nb_cases, nb_threads, dtn_scenario_job, &ctx);
+        fprintf(F, "case, ");
+        dtn_result_csv_header(F);
+        fprintf(F, "\n");
+        for (size_t i = 0; i < ctx.file.nb_cases; i++) {
+            fprintf(F, "%s, ", ctx.file.cases[i].name);
+            dtn_result_csv_line(F, &ctx.results[i]);
+            fprintf(F, "\n");
+            if (ctx.results[i].ret != 0) {
+                fprintf(stdout, "%s: fail\n", ctx.file.cases[i].name);
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "Scenarios done, %" PRIst " cases, %d failed, results in %s\n", ctx.file.nb_cases,
+            nb_failed, csv_file);
+        if (nb_failed > 0) {
+            ret = -1;
+        }
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    if (ctx.results != NULL) {
+        free(ctx.results);
+    }
+    dtn_scenario_file_release(&ctx.file);
+
+    return ret;
+}
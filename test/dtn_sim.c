@@ -0,0 +1,190 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Simulation helpers for the tests that run their own QUIC contexts.
+ *
+ * The test_api context of picoquictest wires one client connection over
+ * one pair of links. The scaling, multipath and relay tests need more
+ * than that: many clients, several paths, or two hops, so they create
+ * their own QUIC contexts and links and run their own simulation loops.
+ * The loops differ in how they route the packets, but share the steps
+ * below: creating the client and server contexts with the test
+ * certificates, setting the transport parameters, preparing the next
+ * packet of a context, delivering the packets that arrived on a link,
+ * and finding the next wake time.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "delay_tolerant_internal.h"
+
+int dtn_sim_create_quic(dtn_sim_quic_t* sim, uint32_t max_nb_connections, picoquic_stream_data_cb_fn server_callback,
+    picoquic_stream_data_cb_fn client_callback, void* callback_ctx, uint64_t* simulated_time)
+{
+    int ret = 0;
+    char test_server_cert_file[512];
+    char test_server_key_file[512];
+    char test_server_cert_store_file[512];
+
+    sim->qserver = NULL;
+    sim->qclient = NULL;
+
+    ret = picoquic_get_input_path(test_server_cert_file, sizeof(test_server_cert_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_SERVER_CERT);
+    if (ret == 0) {
+        ret = picoquic_get_input_path(test_server_key_file, sizeof(test_server_key_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_SERVER_KEY);
+    }
+    if (ret == 0) {
+        ret = picoquic_get_input_path(test_server_cert_store_file, sizeof(test_server_cert_store_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_CERT_STORE);
+    }
+
+    if (ret == 0) {
+        sim->qserver = picoquic_create(max_nb_connections, test_server_cert_file, test_server_key_file, NULL, PICOQUIC_TEST_ALPN,
+            server_callback, callback_ctx, NULL, NULL, NULL, *simulated_time, simulated_time, NULL, NULL, 0);
+        sim->qclient = picoquic_create(max_nb_connections, NULL, NULL, test_server_cert_store_file, NULL,
+            client_callback, callback_ctx, NULL, NULL, NULL, *simulated_time, simulated_time, NULL, NULL, 0);
+        if (sim->qserver == NULL || sim->qclient == NULL) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+void dtn_sim_delete_quic(dtn_sim_quic_t* sim)
+{
+    if (sim->qclient != NULL) {
+        picoquic_free(sim->qclient);
+        sim->qclient = NULL;
+    }
+    if (sim->qserver != NULL) {
+        picoquic_free(sim->qserver);
+        sim->qserver = NULL;
+    }
+}
+
+/* Same parameters on both sides. A null max path id disables multipath. */
+void dtn_sim_set_transport(dtn_sim_quic_t* sim, picoquic_congestion_algorithm_t const* ccalgo, uint64_t idle_timeout,
+    uint64_t initial_max_path_id)
+{
+    picoquic_tp_t client_parameters;
+    picoquic_tp_t server_parameters;
+
+    picoquic_init_transport_parameters(&client_parameters, 1);
+    client_parameters.enable_time_stamp = 3;
+    client_parameters.idle_timeout = (uint32_t)(idle_timeout / 1000);
+    if (initial_max_path_id > 0) {
+        client_parameters.is_multipath_enabled = 1;
+        client_parameters.initial_max_path_id = initial_max_path_id;
+    }
+    picoquic_init_transport_parameters(&server_parameters, 0);
+    server_parameters.enable_time_stamp = 3;
+    server_parameters.idle_timeout = client_parameters.idle_timeout;
+    server_parameters.is_multipath_enabled = client_parameters.is_multipath_enabled;
+    server_parameters.initial_max_path_id = client_parameters.initial_max_path_id;
+    picoquic_set_default_tp(sim->qclient, &client_parameters);
+    picoquic_set_default_tp(sim->qserver, &server_parameters);
+    picoquic_set_default_congestion_algorithm(sim->qclient, ccalgo);
+    picoquic_set_default_congestion_algorithm(sim->qserver, ccalgo);
+}
+
+/* Latency and rate of a link, e.g. when a contact starts */
+void dtn_sim_link_set(picoquictest_sim_link_t* link, uint64_t latency, double mbps)
+{
+    link->microsec_latency = latency;
+    link->picosec_per_byte = (uint64_t)((1000000.0 * 8) / mbps);
+}
+
+/* Prepare the next packet of a QUIC context. If there is one, it is
+ * returned in p_packet, and the caller submits it to a link or frees it.
+ * The source address is set to default_from if the context left it
+ * empty. */
+int dtn_sim_prepare(picoquic_quic_t* quic, uint64_t simulated_time, struct sockaddr_storage const* default_from,
+    picoquictest_sim_packet_t** p_packet)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+
+    *p_packet = NULL;
+    if (packet == NULL) {
+        ret = -1;
+    }
+    else {
+        int if_index = 0;
+        picoquic_connection_id_t log_cid;
+        picoquic_cnx_t* last_cnx = NULL;
+
+        ret = picoquic_prepare_next_packet(quic, simulated_time, packet->bytes, PICOQUIC_MAX_PACKET_SIZE,
+            &packet->length, &packet->addr_to, &packet->addr_from, &if_index, &log_cid, &last_cnx);
+        if (ret == 0 && packet->length > 0) {
+            if (packet->addr_from.ss_family == 0) {
+                picoquic_store_addr(&packet->addr_from, (struct sockaddr*)default_from);
+            }
+            *p_packet = packet;
+        }
+        else {
+            free(packet);
+        }
+    }
+
+    return ret;
+}
+
+/* Deliver the packets that have arrived on a link. The packet and byte
+ * counts are optional. */
+int dtn_sim_deliver(picoquic_quic_t* quic, picoquictest_sim_link_t* link, uint64_t simulated_time,
+    uint64_t* nb_packets, uint64_t* nb_bytes)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet;
+
+    while (ret == 0 && (packet = picoquictest_sim_link_dequeue(link, simulated_time)) != NULL) {
+        ret = picoquic_incoming_packet(quic, packet->bytes, packet->length,
+            (struct sockaddr*)&packet->addr_from, (struct sockaddr*)&packet->addr_to, 0, 0, simulated_time);
+        if (nb_packets != NULL) {
+            (*nb_packets)++;
+        }
+        if (nb_bytes != NULL) {
+            *nb_bytes += packet->length;
+        }
+        free(packet);
+    }
+
+    return ret;
+}
+
+/* Earliest of next_time and the next wake time of the context */
+uint64_t dtn_sim_next_wake_time(picoquic_quic_t* quic, uint64_t next_time)
+{
+    uint64_t wake_time = picoquic_get_next_wake_time(quic, next_time);
+
+    return (wake_time < next_time) ? wake_time : next_time;
+}
+
+/* True if the context has something to send at the current time */
+int dtn_sim_is_awake(picoquic_quic_t* quic, uint64_t simulated_time)
+{
+    return picoquic_get_next_wake_time(quic, simulated_time) <= simulated_time;
+}
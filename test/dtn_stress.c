@@ -0,0 +1,352 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Stress and fuzz of the DTN configurations.
+ *
+ * The fixed tests only cover a few configurations. The stress mode runs
+ * randomized specifications on all the worker threads for a given number
+ * of minutes: latency between 1 second and 40 minutes, link rates between
+ * 10 kbps and 1 Gbps, random flow control credit, congestion control,
+ * losses and scenarios. The fuzz mode uses wider and more adversarial
+ * ranges, such as flow control credit smaller than a packet, very
+ * asymmetric links or long chains of streams. Both report the number of
+ * runs per minute, the failed runs, and the slowest runs, which point
+ * to performance cliffs such as idle timeouts or congestion control
+ * stalls. Each run is derived from its run number, so a run can be
+ * reproduced from the run number printed in the report, with
+ * "-s 0 -u run" or "-f 0 -u run" for the fuzz runs.
+ *
+ * In the fuzz mode, a credit of a few bytes limits the transfer to a
+ * few bytes per round trip, so such runs are expected to time out. They
+ * are reported as expected stalls, apart from the failures.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_STRESS_MAX_STREAMS 8
+#define DTN_STRESS_NB_SLOWEST 8
+#define DTN_STRESS_TEST_ID 0x55
+#define DTN_FUZZ_TEST_ID 0xf0
+#define DTN_STRESS_SEED 0xdeadbeefcafe5eedull
+#define DTN_FUZZ_STALL_CREDIT 2000
+
+static char const* dtn_stress_cc[] = {
+    "newreno", "cubic", "bbr", "fast", "dtn"
+};
+
+typedef struct st_dtn_stress_run_t {
+    uint64_t run_number;
+    uint64_t seed;
+    dtn_test_spec_t spec;
+    test_api_stream_desc_t scenario[DTN_STRESS_MAX_STREAMS];
+    dtn_test_result_t result;
+} dtn_stress_run_t;
+
+typedef struct st_dtn_stress_ctx_t {
+    picoquic_mutex_t lock;
+    int is_fuzz;
+    uint64_t deadline;
+    uint64_t next_run;
+    uint64_t nb_runs;
+    uint64_t nb_failed;
+    uint64_t nb_stalls;
+    uint64_t total_wall_time;
+    uint64_t total_sim_time;
+    size_t nb_slowest;
+    dtn_stress_run_t slowest[DTN_STRESS_NB_SLOWEST];
+    size_t nb_failed_kept;
+    dtn_stress_run_t failed[DTN_STRESS_NB_SLOWEST];
+} dtn_stress_ctx_t;
+
+/* Log uniform random value between v_min and v_max, computed with
+ * octaves so as to not require the math library.
+ */
+static double dtn_stress_log_random(uint64_t* random_ctx, double v_min, double v_max)
+{
+    int nb_octaves = 0;
+    double v;
+
+    for (double x = v_min; 2 * x <= v_max; x *= 2) {
+        nb_octaves++;
+    }
+    v = v_min;
+    for (uint64_t k = picoquic_test_uniform_random(random_ctx, nb_octaves + 1); k > 0; k--) {
+        v *= 2;
+    }
+    v *= 1.0 + ((double)picoquic_test_uniform_random(random_ctx, 1000000)) / 1000000.0;
+    if (v > v_max) {
+        v = v_max;
+    }
+
+    return v;
+}
+
+static void dtn_stress_set_scenario(dtn_stress_run_t* run, uint64_t* random_ctx, int is_fuzz)
+{
+    size_t nb_streams = 1;
+    size_t max_size = (run->spec.mbps_down < 1.0) ? 100000 : 10000000;
+
+    if (picoquic_test_uniform_random(random_ctx, (is_fuzz) ? 2 : 4) == 0) {
+        nb_streams = 1 + (size_t)picoquic_test_uniform_random(random_ctx, DTN_STRESS_MAX_STREAMS);
+    }
+    for (size_t i = 0; i < nb_streams; i++) {
+        run->scenario[i].stream_id = 4 * (i + 1);
+        /* Chain some streams, start other in parallel */
+        run->scenario[i].previous_stream_id = (i > 0 && picoquic_test_uniform_random(random_ctx, 2) == 0) ? 4 * i : 0;
+        run->scenario[i].q_len = 1 + (size_t)picoquic_test_uniform_random(random_ctx, 2000);
+        run->scenario[i].r_len = (size_t)dtn_stress_log_random(random_ctx, 100, (double)max_size);
+    }
+    run->spec.scenario = run->scenario;
+    run->spec.sizeof_scenario = nb_streams * sizeof(test_api_stream_desc_t);
+}
+
+static void dtn_stress_set_spec(dtn_stress_run_t* run, int is_fuzz)
+{
+    uint64_t random_ctx = run->seed;
+    dtn_test_spec_t* spec = &run->spec;
+    uint64_t transfer_time = 0;
+    picoquic_congestion_algorithm_t const* alg;
+
+    dtn_set_basic_test_spec(spec);
+    spec->log_level = dtn_log_off;
+    spec->latency = (uint64_t)dtn_stress_log_random(&random_ctx, 1000000.0, 2400000000.0);
+    spec->mbps_down = dtn_stress_log_random(&random_ctx, 0.01, 1000.0);
+    if (is_fuzz && picoquic_test_uniform_random(&random_ctx, 2) == 0) {
+        /* Independent rates, up to 1:100000 asymmetry */
+        spec->mbps_up = dtn_stress_log_random(&random_ctx, 0.01, 1000.0);
+    }
+    else {
+        spec->mbps_up = spec->mbps_down;
+    }
+    switch (picoquic_test_uniform_random(&random_ctx, 3)) {
+    case 0:
+        spec->initial_flow_control_credit = 0;
+        break;
+    case 1:
+        spec->initial_flow_control_credit = (uint64_t)dtn_stress_log_random(&random_ctx, 100000.0, 200000000.0);
+        break;
+    default:
+        spec->initial_flow_control_credit = (is_fuzz) ?
+            (uint64_t)dtn_stress_log_random(&random_ctx, 1.0, (double)DTN_FUZZ_STALL_CREDIT) :
+            (uint64_t)dtn_stress_log_random(&random_ctx, 1000000.0, 20000000.0);
+        break;
+    }
+    alg = dtn_get_congestion_algorithm(
+        dtn_stress_cc[picoquic_test_uniform_random(&random_ctx, sizeof(dtn_stress_cc) / sizeof(char const*))]);
+    if (alg != NULL) {
+        spec->ccalgo = alg;
+    }
+    spec->has_loss = picoquic_test_uniform_random(&random_ctx, (is_fuzz) ? 2 : 4) == 0;
+    dtn_stress_set_scenario(run, &random_ctx, is_fuzz);
+
+    for (size_t i = 0; i < spec->sizeof_scenario / sizeof(test_api_stream_desc_t); i++) {
+        transfer_time += (uint64_t)((((double)(run->scenario[i].r_len)) * 8.0) / spec->mbps_down);
+        transfer_time += (uint64_t)((((double)(run->scenario[i].q_len)) * 8.0) / spec->mbps_up);
+    }
+    /* Handshake and one round trip per stream, plus generous margins for the transfer and the losses */
+    spec->max_completion_time = (8 + 2 * DTN_STRESS_MAX_STREAMS) * spec->latency + 8 * transfer_time + 60000000;
+}
+
+static void dtn_stress_print_run(FILE* F, dtn_stress_run_t const* run)
+{
+    fprintf(F, "    run %" PRIu64 ", seed 0x%016" PRIx64 ": latency %.1f s, up %.3f Mbps, down %.3f Mbps, ",
+        run->run_number, run->seed, ((double)run->spec.latency) / 1000000.0, run->spec.mbps_up, run->spec.mbps_down);
+    fprintf(F, "credit %" PRIu64 ", cc %s, loss %d, %" PRIst " streams: ret %d, completion %.1f s, wall %.3f s\n",
+        run->spec.initial_flow_control_credit, run->spec.ccalgo->congestion_algorithm_id, run->spec.has_loss,
+        run->spec.sizeof_scenario / sizeof(test_api_stream_desc_t), run->result.ret,
+        ((double)run->result.completion_time) / 1000000.0, ((double)run->result.wall_time) / 1000000.0);
+}
+
+static void dtn_stress_derive_run(dtn_stress_run_t* run, uint64_t run_number, int is_fuzz)
+{
+    memset(run, 0, sizeof(dtn_stress_run_t));
+    run->run_number = run_number;
+    run->seed = DTN_STRESS_SEED ^ (run_number * 0x9e3779b97f4a7c15ull);
+    dtn_stress_set_spec(run, is_fuzz);
+}
+
+static int dtn_stress_run_one(dtn_stress_run_t* run, int is_fuzz)
+{
+    return dtn_test_one_ex((is_fuzz) ? DTN_FUZZ_TEST_ID : DTN_STRESS_TEST_ID,
+        (uint16_t)run->run_number, &run->spec, &run->result);
+}
+
+/* A fuzz run with a credit of a few bytes cannot complete in time */
+static int dtn_stress_is_expected_stall(dtn_stress_run_t const* run, int is_fuzz)
+{
+    return is_fuzz && run->result.ret != 0 && run->spec.initial_flow_control_credit > 0 &&
+        run->spec.initial_flow_control_credit <= DTN_FUZZ_STALL_CREDIT;
+}
+
+/* Keep the slowest runs, sorted by decreasing wall time. Called with the lock held. */
+static void dtn_stress_keep_slowest(dtn_stress_ctx_t* ctx, dtn_stress_run_t const* run)
+{
+    size_t i = ctx->nb_slowest;
+
+    if (i < DTN_STRESS_NB_SLOWEST) {
+        ctx->nb_slowest++;
+    }
+    else if (ctx->slowest[DTN_STRESS_NB_SLOWEST - 1].result.wall_time < run->result.wall_time) {
+        i = DTN_STRESS_NB_SLOWEST - 1;
+    }
+    else {
+        return;
+    }
+    while (i > 0 && ctx->slowest[i - 1].result.wall_time < run->result.wall_time) {
+        ctx->slowest[i] = ctx->slowest[i - 1];
+        i--;
+    }
+    ctx->slowest[i] = *run;
+    ctx->slowest[i].spec.scenario = ctx->slowest[i].scenario;
+}
+
+static int dtn_stress_job(void* v_ctx, size_t thread_index)
+{
+    dtn_stress_ctx_t* ctx = (dtn_stress_ctx_t*)v_ctx;
+    dtn_stress_run_t* run = (dtn_stress_run_t*)malloc(sizeof(dtn_stress_run_t));
+
+    (void)thread_index;
+
+    while (run != NULL && picoquic_current_time() < ctx->deadline) {
+        uint64_t run_number;
+
+        picoquic_lock_mutex(&ctx->lock);
+        run_number = ctx->next_run++;
+        picoquic_unlock_mutex(&ctx->lock);
+        dtn_stress_derive_run(run, run_number, ctx->is_fuzz);
+        (void)dtn_stress_run_one(run, ctx->is_fuzz);
+
+        picoquic_lock_mutex(&ctx->lock);
+        ctx->nb_runs++;
+        ctx->total_wall_time += run->result.wall_time;
+        ctx->total_sim_time += run->result.completion_time;
+        if (dtn_stress_is_expected_stall(run, ctx->is_fuzz)) {
+            ctx->nb_stalls++;
+        }
+        else if (run->result.ret != 0) {
+            ctx->nb_failed++;
+            if (ctx->nb_failed_kept < DTN_STRESS_NB_SLOWEST) {
+                ctx->failed[ctx->nb_failed_kept] = *run;
+                ctx->failed[ctx->nb_failed_kept].spec.scenario = ctx->failed[ctx->nb_failed_kept].scenario;
+                ctx->nb_failed_kept++;
+            }
+        }
+        dtn_stress_keep_slowest(ctx, run);
+        picoquic_unlock_mutex(&ctx->lock);
+    }
+
+    if (run != NULL) {
+        free(run);
+    }
+
+    return 0;
+}
+
+int dtn_stress(int minutes, int is_fuzz, int nb_threads)
+{
+    int ret = 0;
+    dtn_stress_ctx_t* ctx = (dtn_stress_ctx_t*)calloc(1, sizeof(dtn_stress_ctx_t));
+    uint64_t start_time = picoquic_current_time();
+
+    if (nb_threads <= 0) {
+        nb_threads = dtn_get_nb_cores();
+    }
+
+    if (ctx == NULL) {
+        fprintf(stderr, "Cannot allocate the stress context\n");
+        ret = -1;
+    }
+    else if ((ret = picoquic_create_mutex(&ctx->lock)) != 0) {
+        fprintf(stderr, "Cannot create the stress mutex\n");
+    }
+    else {
+        double elapsed_minutes;
+
+        ctx->is_fuzz = is_fuzz;
+        ctx->deadline = start_time + ((uint64_t)minutes) * 60000000ull;
+        fprintf(stdout, "Running DTN %s for %d minutes on %d threads.\n", (is_fuzz) ? "fuzz" : "stress", minutes, nb_threads);
+        fflush(stdout);
+
+        ret = dtn_run_parallel((size_t)nb_threads, nb_threads, dtn_stress_job, ctx);
+
+        elapsed_minutes = ((double)(picoquic_current_time() - start_time)) / 60000000.0;
+        fprintf(stdout, "Completed %" PRIu64 " runs, %.1f runs per minute, %" PRIu64 " failed.\n",
+            ctx->nb_runs, (elapsed_minutes > 0) ? ((double)ctx->nb_runs) / elapsed_minutes : 0.0, ctx->nb_failed);
+        if (ctx->nb_stalls > 0) {
+            fprintf(stdout, "%" PRIu64 " expected stalls, credit at most %d bytes.\n", ctx->nb_stalls, DTN_FUZZ_STALL_CREDIT);
+        }
+        if (ctx->total_wall_time > 0) {
+            fprintf(stdout, "Simulated %.1f seconds per second of wall time.\n",
+                ((double)ctx->total_sim_time) / ((double)ctx->total_wall_time));
+        }
+        if (ctx->nb_runs > 0) {
+            fprintf(stdout, "Average wall time per run: %.3f s, slowest runs:\n",
+                ((double)ctx->total_wall_time) / (1000000.0 * (double)ctx->nb_runs));
+            for (size_t i = 0; i < ctx->nb_slowest; i++) {
+                dtn_stress_print_run(stdout, &ctx->slowest[i]);
+            }
+        }
+        if (ctx->nb_failed_kept > 0) {
+            fprintf(stdout, "Failed runs:\n");
+            for (size_t i = 0; i < ctx->nb_failed_kept; i++) {
+                dtn_stress_print_run(stdout, &ctx->failed[i]);
+            }
+            ret = -1;
+        }
+        picoquic_delete_mutex(&ctx->lock);
+    }
+
+    if (ctx != NULL) {
+        free(ctx);
+    }
+
+    return ret;
+}
+
+/* Run again the stress or fuzz run with the given number, as printed in the report */
+int dtn_stress_rerun(uint64_t run_number, int is_fuzz)
+{
+    int ret = 0;
+    dtn_stress_run_t* run = (dtn_stress_run_t*)malloc(sizeof(dtn_stress_run_t));
+
+    if (run == NULL) {
+        fprintf(stderr, "Cannot allocate the stress run\n");
+        ret = -1;
+    }
+    else {
+        dtn_stress_derive_run(run, run_number, is_fuzz);
+        ret = dtn_stress_run_one(run, is_fuzz);
+        dtn_stress_print_run(stdout, run);
+        if (dtn_stress_is_expected_stall(run, is_fuzz)) {
+            fprintf(stdout, "Expected stall, credit at most %d bytes.\n", DTN_FUZZ_STALL_CREDIT);
+        }
+        free(run);
+    }
+
+    return ret;
+}
@@ -0,0 +1,461 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2023, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Parameter sweeps of the delay tolerant simulation.
+ *
+ * The fixed DTN tests verify a handful of configurations. The sweep
+ * runs the full grid of latency, link rates, flow control credit and
+ * congestion control algorithms, and writes one CSV line per point.
+ * The grid is described by a compact string of semicolon separated
+ * dimensions, for example:
+ *
+ *     latency=1:2400:x2;up=10;down=0.01:1000:x10;credit=0,100000000;cc=newreno,bbr
+ *
+ * The dimensions are:
+ *  - latency: one way latency, in seconds
+ *  - up, down: data rate of the client to server and server to client links, in Mbps
+ *  - credit: initial flow control credit, in bytes, 0 for the default,
+ *    "auto" for a credit computed from the bandwidth delay product
+ *  - cc: names of congestion control algorithms, including "dtn", or "all"
+ *  - size: size of the response downloaded by the client, in bytes
+ *  - loss: 0 or 1, simulate random losses
+ *  - plr: packet loss rate of a Bernoulli loss model, 0 for none
+ *  - ber: bit error rate, 0 for none, used instead of plr if both are set
+ *  - fec: redundancy ratio of the link FEC, e.g. 0.125 for 4 repair
+ *    packets per block of 32, 0 for none
+ *  - log: 0 for no logs (the default), 1 for summary logs, 2 for full logs
+ *
+ * Each dimension is either a comma separated list of values, or a
+ * range "min:max:xF" that starts at min and is multiplied by F until
+ * it exceeds max. Dimensions that are not specified keep the values
+ * of the basic DTN test.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "picoquic_sp_test.h"
+#include "delay_tolerant_internal.h"
+
+#define DTN_SWEEP_MAX_VALUES 64
+#define DTN_SWEEP_MAX_POINTS 65535
+#define DTN_SWEEP_TEST_ID 0x5e
+#define DTN_SWEEP_CREDIT_AUTO -1.0
+
+typedef enum {
+    dtn_sweep_latency = 0,
+    dtn_sweep_up,
+    dtn_sweep_down,
+    dtn_sweep_credit,
+    dtn_sweep_cc,
+    dtn_sweep_size,
+    dtn_sweep_loss,
+    dtn_sweep_plr,
+    dtn_sweep_ber,
+    dtn_sweep_fec,
+    dtn_sweep_log,
+    dtn_sweep_nb_dimensions
+} dtn_sweep_dimension_enum;
+
+static char const* dtn_sweep_dimension_name[dtn_sweep_nb_dimensions] = {
+    "latency", "up", "down", "credit", "cc", "size", "loss", "plr", "ber", "fec", "log"
+};
+
+static char const* dtn_sweep_all_cc[] = {
+    "newreno", "cubic", "dcubic", "fast", "bbr", "bbr1", "prague", "dtn"
+};
+
+typedef struct st_dtn_sweep_dimension_t {
+    size_t nb_values;
+    double values[DTN_SWEEP_MAX_VALUES];
+    picoquic_congestion_algorithm_t const* ccalgo[DTN_SWEEP_MAX_VALUES];
+} dtn_sweep_dimension_t;
+
+typedef struct st_dtn_sweep_point_t {
+    double latency_sec;
+    double mbps_up;
+    double mbps_down;
+    uint64_t credit;
+    int auto_credit;
+    picoquic_congestion_algorithm_t const* ccalgo;
+    uint64_t size;
+    int has_loss;
+    double plr;
+    double ber;
+    double fec;
+    dtn_log_level_t log_level;
+    dtn_result_row_t result;
+} dtn_sweep_point_t;
+
+typedef struct st_dtn_sweep_ctx_t {
+    size_t nb_points;
+    dtn_sweep_point_t* points;
+} dtn_sweep_ctx_t;
+
+static int dtn_sweep_add_value(dtn_sweep_dimension_t* dim, double v)
+{
+    int ret = 0;
+
+    if (dim->nb_values >= DTN_SWEEP_MAX_VALUES) {
+        fprintf(stderr, "Too many values in sweep dimension, max %d\n", DTN_SWEEP_MAX_VALUES);
+        ret = -1;
+    }
+    else {
+        dim->values[dim->nb_values++] = v;
+    }
+
+    return ret;
+}
+
+static int dtn_sweep_add_cc(dtn_sweep_dimension_t* dim, char const* cc_name, size_t len)
+{
+    int ret = 0;
+    char name[64];
+
+    if (len == 3 && memcmp(cc_name, "all", 3) == 0) {
+        for (size_t i = 0; ret == 0 && i < sizeof(dtn_sweep_all_cc) / sizeof(char const*); i++) {
+            picoquic_congestion_algorithm_t const* alg = dtn_get_congestion_algorithm(dtn_sweep_all_cc[i]);
+            if (alg != NULL && (ret = dtn_sweep_add_value(dim, 0)) == 0) {
+                dim->ccalgo[dim->nb_values - 1] = alg;
+            }
+        }
+    }
+    else if (len == 0 || len >= sizeof(name)) {
+        fprintf(stderr, "Invalid congestion control name in sweep\n");
+        ret = -1;
+    }
+    else {
+        picoquic_congestion_algorithm_t const* alg;
+        memcpy(name, cc_name, len);
+        name[len] = 0;
+        if ((alg = dtn_get_congestion_algorithm(name)) == NULL) {
+            fprintf(stderr, "Unknown congestion control algorithm: %s\n", name);
+            ret = -1;
+        }
+        else if ((ret = dtn_sweep_add_value(dim, 0)) == 0) {
+            dim->ccalgo[dim->nb_values - 1] = alg;
+        }
+    }
+
+    return ret;
+}
+
+/* Parse the values of a dimension, up to the end of the dimension text */
+static int dtn_sweep_parse_values(dtn_sweep_dimension_t* dim, int dim_id, char const* text, char const* text_end)
+{
+    int ret = 0;
+
+    dim->nb_values = 0;
+
+    while (ret == 0 && text < text_end) {
+        char const* item_end = text;
+        while (item_end < text_end && *item_end != ',') {
+            item_end++;
+        }
+        if (dim_id == dtn_sweep_cc) {
+            ret = dtn_sweep_add_cc(dim, text, item_end - text);
+        }
+        else if (dim_id == dtn_sweep_credit && item_end - text == 4 && memcmp(text, "auto", 4) == 0) {
+            ret = dtn_sweep_add_value(dim, DTN_SWEEP_CREDIT_AUTO);
+        }
+        else {
+            char* parsed;
+            double v = strtod(text, &parsed);
+
+            if (parsed == text) {
+                ret = -1;
+            }
+            else if (parsed < item_end && *parsed == ':') {
+                double v_max = strtod(parsed + 1, &parsed);
+                double factor = 0;
+                if (parsed < item_end && parsed[0] == ':' && parsed[1] == 'x') {
+                    factor = strtod(parsed + 2, &parsed);
+                }
+                if (v <= 0 || v_max < v || factor <= 1.0) {
+                    ret = -1;
+                }
+                else {
+                    /* Tolerate rounding errors at the top of the range */
+                    while (ret == 0 && v <= v_max * 1.000001) {
+                        ret = dtn_sweep_add_value(dim, v);
+                        v *= factor;
+                    }
+                }
+            }
+            else {
+                ret = dtn_sweep_add_value(dim, v);
+            }
+            if (ret == 0 && parsed != item_end) {
+                ret = -1;
+            }
+            if (ret != 0) {
+                fprintf(stderr, "Cannot parse sweep value: %.*s\n", (int)(item_end - text), text);
+            }
+        }
+        text = (item_end < text_end) ? item_end + 1 : item_end;
+    }
+
+    if (ret == 0 && dim->nb_values == 0) {
+        fprintf(stderr, "Empty sweep dimension\n");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int dtn_sweep_parse(char const* sweep_spec, dtn_sweep_dimension_t* dims)
+{
+    int ret = 0;
+    char const* text = sweep_spec;
+    dtn_test_spec_t basic_spec;
+
+    /* Set the default values from the basic test */
+    dtn_set_basic_test_spec(&basic_spec);
+    memset(dims, 0, dtn_sweep_nb_dimensions * sizeof(dtn_sweep_dimension_t));
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_latency], ((double)basic_spec.latency) / 1000000.0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_up], basic_spec.mbps_up);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_down], basic_spec.mbps_down);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_credit], 0);
+    dims[dtn_sweep_cc].ccalgo[0] = basic_spec.ccalgo;
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_cc], 0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_size], (double)basic_spec.scenario[0].r_len);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_loss], 0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_plr], 0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_ber], 0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_fec], 0);
+    (void)dtn_sweep_add_value(&dims[dtn_sweep_log], dtn_log_off);
+
+    while (ret == 0 && *text != 0) {
+        char const* dim_end = strchr(text, ';');
+        char const* equal;
+        int dim_id = -1;
+
+        if (dim_end == NULL) {
+            dim_end = text + strlen(text);
+        }
+        equal = memchr(text, '=', dim_end - text);
+        if (equal != NULL) {
+            for (int i = 0; i < dtn_sweep_nb_dimensions; i++) {
+                if (strlen(dtn_sweep_dimension_name[i]) == (size_t)(equal - text) &&
+                    memcmp(text, dtn_sweep_dimension_name[i], equal - text) == 0) {
+                    dim_id = i;
+                    break;
+                }
+            }
+        }
+        if (dim_id < 0) {
+            fprintf(stderr, "Unknown sweep dimension: %.*s\n", (int)(dim_end - text), text);
+            ret = -1;
+        }
+        else {
+            ret = dtn_sweep_parse_values(&dims[dim_id], dim_id, equal + 1, dim_end);
+        }
+        text = (*dim_end == 0) ? dim_end : dim_end + 1;
+    }
+
+    for (int i = 0; ret == 0 && i < dtn_sweep_nb_dimensions; i++) {
+        for (size_t j = 0; j < dims[i].nb_values; j++) {
+            if ((dims[i].values[j] < 0 && !(i == dtn_sweep_credit && dims[i].values[j] == DTN_SWEEP_CREDIT_AUTO)) ||
+                (dims[i].values[j] == 0 && (i == dtn_sweep_latency || i == dtn_sweep_up || i == dtn_sweep_down || i == dtn_sweep_size)) ||
+                (i == dtn_sweep_log && dims[i].values[j] > dtn_log_full) ||
+                ((i == dtn_sweep_plr || i == dtn_sweep_ber) && dims[i].values[j] >= 1.0) ||
+                (i == dtn_sweep_fec && dims[i].values[j] > 1.0)) {
+                fprintf(stderr, "Invalid value %f for sweep dimension %s\n", dims[i].values[j], dtn_sweep_dimension_name[i]);
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int dtn_sweep_job(void* v_ctx, size_t i)
+{
+    dtn_sweep_ctx_t* ctx = (dtn_sweep_ctx_t*)v_ctx;
+    dtn_sweep_point_t* point = &ctx->points[i];
+    dtn_test_spec_t spec;
+    test_api_stream_desc_t scenario[1];
+    dtn_test_result_t result;
+    double transfer_time;
+    int ret;
+
+    dtn_set_basic_test_spec(&spec);
+    spec.latency = (uint64_t)(point->latency_sec * 1000000.0);
+    spec.mbps_up = point->mbps_up;
+    spec.mbps_down = point->mbps_down;
+    spec.initial_flow_control_credit = point->credit;
+    spec.auto_flow_control = point->auto_credit;
+    spec.ccalgo = point->ccalgo;
+    spec.has_loss = point->has_loss;
+    if (point->ber > 0) {
+        spec.loss_model.type = dtn_loss_ber;
+        spec.loss_model.ber = point->ber;
+    }
+    else if (point->plr > 0) {
+        spec.loss_model.type = dtn_loss_bernoulli;
+        spec.loss_model.loss_rate = point->plr;
+    }
+    spec.loss_model.seed = (uint64_t)i + 1;
+    spec.fec.redundancy = point->fec;
+    spec.fec.block_size = DTN_FEC_DEFAULT_BLOCK;
+    spec.log_level = point->log_level;
+    memset(scenario, 0, sizeof(scenario));
+    scenario[0].stream_id = 4;
+    scenario[0].previous_stream_id = 0;
+    scenario[0].q_len = 257;
+    scenario[0].r_len = (size_t)point->size;
+    spec.scenario = scenario;
+    spec.sizeof_scenario = sizeof(scenario);
+    /* Generous upper bound: handshake, request, probing, plus several times the transfer time */
+    transfer_time = (((double)point->size) * 8.0) / point->mbps_down;
+    spec.max_completion_time = 16 * spec.latency + 4 * (uint64_t)transfer_time + 10000000;
+
+    /* Only the fields of the CSV line are kept, the full result is much larger */
+    ret = dtn_test_one_ex(DTN_SWEEP_TEST_ID, (uint16_t)i, &spec, &result);
+    dtn_result_row_set(&point->result, &result);
+
+    return ret;
+}
+
+static void dtn_sweep_set_point(dtn_sweep_dimension_t* dims, size_t const* index, dtn_sweep_point_t* point)
+{
+    point->latency_sec = dims[dtn_sweep_latency].values[index[dtn_sweep_latency]];
+    point->mbps_up = dims[dtn_sweep_up].values[index[dtn_sweep_up]];
+    point->mbps_down = dims[dtn_sweep_down].values[index[dtn_sweep_down]];
+    if (dims[dtn_sweep_credit].values[index[dtn_sweep_credit]] == DTN_SWEEP_CREDIT_AUTO) {
+        point->auto_credit = 1;
+    }
+    else {
+        point->credit = (uint64_t)dims[dtn_sweep_credit].values[index[dtn_sweep_credit]];
+    }
+    point->ccalgo = dims[dtn_sweep_cc].ccalgo[index[dtn_sweep_cc]];
+    point->size = (uint64_t)dims[dtn_sweep_size].values[index[dtn_sweep_size]];
+    point->has_loss = dims[dtn_sweep_loss].values[index[dtn_sweep_loss]] != 0;
+    point->plr = dims[dtn_sweep_plr].values[index[dtn_sweep_plr]];
+    point->ber = dims[dtn_sweep_ber].values[index[dtn_sweep_ber]];
+    point->fec = dims[dtn_sweep_fec].values[index[dtn_sweep_fec]];
+    point->log_level = (dtn_log_level_t)dims[dtn_sweep_log].values[index[dtn_sweep_log]];
+}
+
+/* Enumerate the combinations, the last dimension varying fastest */
+static size_t dtn_sweep_fill_points(dtn_sweep_dimension_t* dims, dtn_sweep_point_t* points)
+{
+    size_t index[dtn_sweep_nb_dimensions];
+    size_t nb_points = 0;
+    int is_done = 0;
+
+    memset(index, 0, sizeof(index));
+
+    while (!is_done) {
+        dtn_sweep_set_point(dims, index, &points[nb_points++]);
+        is_done = 1;
+        for (int d = dtn_sweep_nb_dimensions - 1; d >= 0; d--) {
+            if (++index[d] < dims[d].nb_values) {
+                is_done = 0;
+                break;
+            }
+            index[d] = 0;
+        }
+    }
+
+    return nb_points;
+}
+
+static void dtn_sweep_write_csv(FILE* F, dtn_sweep_ctx_t* ctx)
+{
+    fprintf(F, "latency_s, mbps_up, mbps_down, credit_mode, cc, size, loss, plr, ber, fec, ");
+    dtn_result_csv_header(F);
+    fprintf(F, "\n");
+    for (size_t i = 0; i < ctx->nb_points; i++) {
+        dtn_sweep_point_t* point = &ctx->points[i];
+        fprintf(F, "%.3f, %.3f, %.3f, %s, %s, %" PRIu64 ", %d, %g, %g, %g, ",
+            point->latency_sec, point->mbps_up, point->mbps_down, (point->auto_credit) ? "auto" : "fixed",
+            point->ccalgo->congestion_algorithm_id, point->size, point->has_loss, point->plr, point->ber, point->fec);
+        dtn_result_row_csv_line(F, &point->result);
+        fprintf(F, "\n");
+    }
+}
+
+int dtn_sweep(char const* sweep_spec, char const* csv_file_name, int nb_threads)
+{
+    int ret = 0;
+    dtn_sweep_dimension_t dims[dtn_sweep_nb_dimensions];
+    dtn_sweep_ctx_t ctx;
+    size_t nb_points = 1;
+    FILE* F = NULL;
+
+    memset(&ctx, 0, sizeof(dtn_sweep_ctx_t));
+
+    if ((ret = dtn_sweep_parse(sweep_spec, dims)) == 0) {
+        /* Check the cap before each product, so it cannot wrap around */
+        for (int i = 0; ret == 0 && i < dtn_sweep_nb_dimensions; i++) {
+            if (nb_points > DTN_SWEEP_MAX_POINTS / dims[i].nb_values) {
+                fprintf(stderr, "Sweep has more than %d points\n", DTN_SWEEP_MAX_POINTS);
+                ret = -1;
+            }
+            else {
+                nb_points *= dims[i].nb_values;
+            }
+        }
+        if (ret == 0) {
+            if ((ctx.points = (dtn_sweep_point_t*)calloc(nb_points, sizeof(dtn_sweep_point_t))) == NULL) {
+                fprintf(stderr, "Cannot allocate %" PRIst " sweep points\n", nb_points);
+                ret = -1;
+            }
+            else {
+                ctx.nb_points = dtn_sweep_fill_points(dims, ctx.points);
+            }
+        }
+    }
+
+    if (ret == 0 && (F = picoquic_file_open(csv_file_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", csv_file_name);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        int nb_failed = 0;
+
+        fprintf(stdout, "Running %" PRIst " sweep points.\n", ctx.nb_points);
+        fflush(stdout);
+        ret = dtn_run_parallel(ctx.nb_points, nb_threads, dtn_sweep_job, &ctx);
+        dtn_sweep_write_csv(F, &ctx);
+        for (size_t i = 0; i < ctx.nb_points; i++) {
+            if (ctx.points[i].result.ret != 0) {
+                nb_failed++;
+            }
+        }
+        fprintf(stdout, "Sweep done, %" PRIst " points, %d failed, results in %s\n", ctx.nb_points, nb_failed, csv_file_name);
+    }
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+    if (ctx.points != NULL) {
+        free(ctx.points);
+    }
+
+    return ret;
+}